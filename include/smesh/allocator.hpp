@@ -0,0 +1,103 @@
+#pragma once
+
+#include "instrumentation.hpp"
+
+#include <memory_resource>
+
+
+
+namespace smesh {
+
+
+
+
+
+
+
+
+
+namespace internal {
+
+	inline std::pmr::memory_resource*& thread_memory_resource() {
+		thread_local std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+		return resource;
+	}
+
+}
+
+
+
+//
+// sets the calling thread's memory resource for Arena_Allocator until end of scope
+//
+// the resource must outlive every container that was created inside the scope,
+// e.g. a mesh built in a job that owns a std::pmr::monotonic_buffer_resource
+//
+class Scoped_Memory_Resource {
+public:
+	explicit Scoped_Memory_Resource(std::pmr::memory_resource* resource) :
+			prev( internal::thread_memory_resource() ) {
+		internal::thread_memory_resource() = resource;
+	}
+
+	~Scoped_Memory_Resource() {
+		internal::thread_memory_resource() = prev;
+	}
+
+	Scoped_Memory_Resource(const Scoped_Memory_Resource&) = delete;
+	Scoped_Memory_Resource& operator=(const Scoped_Memory_Resource&) = delete;
+
+private:
+	std::pmr::memory_resource* const prev;
+};
+
+
+
+
+//
+// default-constructible allocator that binds to the memory resource of the thread it was created on
+//
+// use with Smesh_Builder::Allocator:
+//
+//   using Mesh = Smesh_Builder<double>::Allocator< Arena_Allocator<char> >::Smesh;
+//
+//   std::pmr::monotonic_buffer_resource arena;
+//   Scoped_Memory_Resource scope(&arena);
+//   auto mesh = load_ply<Mesh>("bunny.ply"); // no global allocator calls for links and temporaries
+//
+template<class T>
+class Arena_Allocator {
+public:
+	using value_type = T;
+
+	Arena_Allocator() : resource( internal::thread_memory_resource() ) {}
+
+	template<class U>
+	Arena_Allocator(const Arena_Allocator<U>& o) : resource( o.resource ) {}
+
+	T* allocate(std::size_t n) {
+		SMESH_COUNT(ALLOCATIONS, 1);
+		return static_cast<T*>( resource->allocate(n * sizeof(T), alignof(T)) );
+	}
+
+	void deallocate(T* p, std::size_t n) {
+		resource->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	template<class U>
+	bool operator==(const Arena_Allocator<U>& o) const {
+		return resource == o.resource;
+	}
+
+	template<class U>
+	bool operator!=(const Arena_Allocator<U>& o) const {
+		return !(*this == o);
+	}
+
+	std::pmr::memory_resource* resource;
+};
+
+
+
+
+} // namespace smesh
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+
+//
+// result of append: where the copied elements went
+//
+struct Append_Result {
+	// new verts and polys are keys [begin, domain_end) of dst, in order of their source keys
+	int vert_begin = 0;
+	int poly_begin = 0;
+
+	std::vector<int> vert_remap; // source vert key -> dst key, -1 if not copied
+	std::vector<int> poly_remap; // source poly key -> dst key, -1 if not copied
+
+	// (poly, edge) in dst of copied edges without link: open in the source, or linked to a poly that
+	// wasn't copied. only with EDGE_LINKS
+	std::vector<std::pair<int,int>> boundary_edges;
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// copy live `vert_keys` and `poly_keys` of src to the end of dst: bulk adds, then keys, links
+	// and props are remapped in parallel
+	//
+	template<class MESH, class KEYS>
+	Append_Result append_keys(MESH& dst, const MESH& src, const KEYS& vert_keys, const KEYS& poly_keys) {
+		static_assert(!MESH::Has_Indexed_Vert_Props, "append does not support Indexed_Vert_Props");
+		static_assert(!MESH::Has_Journal, "append writes links directly and can't be journaled");
+		DCHECK(&dst != &src) << "append: can't append a mesh to itself";
+
+		using Pos = typename MESH::Pos;
+		constexpr int N = MESH::POLY_SIZE;
+		constexpr int grain = 16384;
+
+		const int num_verts = (int)vert_keys.size();
+		const int num_polys = (int)poly_keys.size();
+
+		Append_Result r;
+
+		if(dst.verts.domain_end() == 0) dst.verts.pos_codec = src.verts.pos_codec;
+
+		r.vert_begin = dst.verts.domain_end();
+		r.vert_remap.assign(src.verts.domain_end(), -1);
+		smesh::parallel_for(0, num_verts, grain, [&](int i) { r.vert_remap[vert_keys[i]] = r.vert_begin + i; });
+
+		r.poly_begin = dst.polys.domain_end();
+		r.poly_remap.assign(src.polys.domain_end(), -1);
+		smesh::parallel_for(0, num_polys, grain, [&](int i) { r.poly_remap[poly_keys[i]] = r.poly_begin + i; });
+
+
+
+		//
+		// verts
+		//
+		{
+			std::vector<Pos, typename MESH::template Allocator<Pos>> positions(num_verts);
+			smesh::parallel_for(0, num_verts, grain, [&](int i) {
+				positions[i] = src.verts.pos_codec.decode( src.verts.raw(vert_keys[i]).pos );
+			});
+			dst.verts.add_range(positions.begin(), positions.end());
+		}
+
+		if constexpr(MESH::Has_Vert_Props) {
+			smesh::parallel_for(0, num_verts, grain, [&](int i) {
+				dst.verts[r.vert_begin + i].props = src.verts[ vert_keys[i] ].props();
+			});
+		}
+
+
+
+		//
+		// polys
+		//
+		{
+			std::vector<int, typename MESH::template Allocator<int>> indices(size_t(num_polys) * N);
+			smesh::parallel_for(0, num_polys, grain, [&](int i) {
+				const auto& verts = src.polys.raw(poly_keys[i]).verts;
+				for(int j=0; j<N; ++j) indices[size_t(i)*N + j] = r.vert_remap[ (int)verts[j].key ];
+			});
+			dst.polys.add_range(indices.data(), num_polys, MESH::Has_Vert_Poly_Links);
+		}
+
+		const int num_chunks = (num_polys + grain - 1) / grain;
+		std::vector<std::vector<std::pair<int,int>>> chunk_boundary_edges(num_chunks);
+
+		smesh::parallel_for_chunks(0, num_polys, grain, [&](int, int b, int e) {
+			for(int i=b; i<e; ++i) {
+				const int p = poly_keys[i];
+				const int np = r.poly_begin + i;
+
+				if constexpr(MESH::Has_Poly_Props) dst.polys[np].props = src.polys[p].props();
+
+				for(int j=0; j<N; ++j) {
+					if constexpr(MESH::Has_Poly_Vert_Props) {
+						dst.polys[np].verts[j].props = src.polys[p].verts[j].props();
+					}
+
+					if constexpr(MESH::Has_Edge_Links) {
+						const auto& pv = src.polys.raw(p).verts[j];
+						auto& npv = dst.polys.raw(np).verts[j];
+						const auto& l = pv.edge_link;
+						const int other = l.poly == -1 ? -1 : r.poly_remap[l.poly];
+
+						if(other == -1) {
+							npv.edge_link.poly = -1;
+							chunk_boundary_edges[b / grain].emplace_back(np, j);
+						}
+						else {
+							npv.edge_link.poly = other;
+							npv.edge_link.vert = l.vert;
+						}
+
+						// from the owner in src (same rule as Smesh::owns_edge). ownership of kept links
+						// doesn't change, as the remap keeps the order of poly keys
+						if constexpr(MESH::Has_Edge_Props) {
+							const bool owner = l.poly == -1 || p < l.poly || (p == l.poly && j < l.vert);
+							npv.edge_props = owner ? pv.edge_props : src.polys.raw(l.poly).verts[l.vert].edge_props;
+						}
+					}
+				}
+			}
+		});
+
+		for(auto& edges : chunk_boundary_edges) {
+			r.boundary_edges.insert(r.boundary_edges.end(), edges.begin(), edges.end());
+		}
+
+		return r;
+	}
+
+}
+
+
+
+
+
+//
+// append a copy of `src` to `dst`: all live verts (isolated too) and polys, with props, edge links
+// and vert-poly links
+//
+// - storage is added in bulk (see add_range), then vert keys, edge links and props are remapped in
+//   parallel. no hashing or link recomputation
+// - if dst is empty, it takes the position codec of src. positions are re-encoded otherwise, so
+//   with QUANTIZED_POS they must be inside the bounds of dst (see set_pos_bounds)
+// - layers and indexed vert props are not copied
+//
+//   auto r = append(dst, src);
+//   for(auto [p, e] : r.boundary_edges) ... // e.g. to weld seams
+//
+template<class MESH>
+Append_Result append(MESH& dst, const MESH& src) {
+	SMESH_SCOPED_TIMER("append");
+
+	std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+	vert_keys.reserve(src.verts.domain_end());
+	for(auto v : src.verts) vert_keys.push_back(v.key);
+
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+	poly_keys.reserve(src.polys.domain_end());
+	for(auto p : src.polys) poly_keys.push_back(p.key);
+
+	return smesh::internal::append_keys(dst, src, vert_keys, poly_keys);
+}
+
+
+
+//
+// append the polys of `src` selected by is_p_selected(poly_key), and the verts they use. links
+// between selected polys are kept, links to other polys are cut (see boundary_edges)
+//
+template<class MESH, class IS_P_SELECTED>
+Append_Result append(MESH& dst, const MESH& src, const IS_P_SELECTED& is_p_selected) {
+	SMESH_SCOPED_TIMER("append");
+
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+	for(auto p : src.polys) {
+		if(is_p_selected(p.key)) poly_keys.push_back(p.key);
+	}
+
+	// value-initialized: zeros
+	std::vector<std::atomic<uint8_t>> used(src.verts.domain_end());
+	smesh::parallel_for(0, (int)poly_keys.size(), 16384, [&](int i) {
+		for(const auto& pv : src.polys.raw(poly_keys[i]).verts) {
+			used[(int)pv.key].store(1, std::memory_order_relaxed);
+		}
+	});
+
+	std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+	for(auto v : src.verts) {
+		if(used[v.key].load(std::memory_order_relaxed)) vert_keys.push_back(v.key);
+	}
+
+	return smesh::internal::append_keys(dst, src, vert_keys, poly_keys);
+}
+
+
+
+//
+// new mesh with the polys selected by is_p_selected(poly_key) and their verts, see append
+//
+//   auto part = extract(mesh, [&](int p) { return components.poly_component[p] == 0; });
+//
+template<class MESH, class IS_P_SELECTED>
+MESH extract(const MESH& mesh, const IS_P_SELECTED& is_p_selected) {
+	MESH r;
+	append(r, mesh, is_p_selected);
+	return r;
+}
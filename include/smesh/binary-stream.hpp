@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+
+
+namespace smesh::internal {
+
+	//
+	// raw binary read/write of trivially copyable arrays (native endianness)
+	//
+	template<class T>
+	void write_pod(std::ostream& s, const T* data, size_t n) {
+		s.write(reinterpret_cast<const char*>(data), sizeof(T) * n);
+	}
+
+	// false if the stream ends first (the stream is then in failed state)
+	template<class T>
+	bool try_read_pod(std::istream& s, T* data, size_t n) {
+		s.read(reinterpret_cast<char*>(data), sizeof(T) * n);
+		return bool(s);
+	}
+
+	template<class T>
+	void read_pod(std::istream& s, T* data, size_t n) {
+		CHECK(try_read_pod(s, data, n)) << "binary stream truncated";
+	}
+
+}
+
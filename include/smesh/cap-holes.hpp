@@ -3,174 +3,266 @@
 
 #include "smesh.hpp"
 #include "mesh-utils.hpp"
+#include "indexed-heap.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
 
 
 
-#include <list>
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <memory>
 
 
 struct Cap_Hole_Result {
 	int num_polys_created = 0;
 };
 
-//
-// for triangle meshes
-//
-template<class EDGE>
-Cap_Hole_Result cap_hole(const EDGE& edge) {
-	Cap_Hole_Result r;
 
-	auto& m = edge.mesh;
 
-	std::list<decltype(edge.handle)> perimeter;
 
-	// iterators to perimeter, ordered by score
-	std::multimap<double, typename decltype(perimeter)::iterator> cands;
 
-	std::unordered_map<std::remove_cv_t<decltype(edge.handle)>, typename decltype(cands)::iterator> where_cands;
+namespace smesh::internal {
 
+	//
+	// get hole perimeter (open half-edges), starting with the one after 'edge'
+	// consecutive edges share vertices: edge[i].verts[1] == edge[i+1].verts[0]
+	//
+	template<class EDGE, class OUT>
+	void get_hole_perimeter(const EDGE& edge, OUT& perimeter) {
+		auto& m = edge.mesh;
 
-	auto get_score = [](auto e0, auto e1){
-		auto t0 = e0.segment.trace();
-		auto t1 = e1.segment.trace();
+		auto he = edge.handle;
+		do {
+			while(he(m).next().has_link) {
+				he = he(m).next().link().handle;
+			}
 
-		auto my_normal = t1.cross( t0 ).eval();
-		my_normal.normalize();
+			he = he(m).next().handle;
 
-		auto normal0 = compute_poly_normal(e0.poly);
-		auto normal1 = compute_poly_normal(e1.poly);
+			perimeter.push_back(he);
+		} while(he != edge.handle);
+	}
 
-		auto score0 = normal0.dot(my_normal) + 1;
-		auto score1 = normal1.dot(my_normal) + 1;
 
-		// shape score: area / perimeter
-		double min_angle = std::min({
-			compute_angle(-t0, t1),
-			compute_angle(t0, t0+t1),
-			compute_angle(-t1, -(t0+t1))
-		});
 
-		return score0 * score1 * min_angle;
-	};
 
+	//
+	// triangulates one hole, using only its perimeter geometry (no mesh access, so holes can be
+	// processed in parallel)
+	//
+	// perimeter is kept as a circular list in flat arrays, candidate polys in an indexed heap.
+	// slots [0,n) are the perimeter edges, slots [n,2n-3) are edges of created polys
+	//
+	template<class POS, class ALLOCATOR>
+	class Hole_Triangulation {
+	public:
+		template<class T>
+		using Vector = std::vector<T, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<T>>;
+
+		// one created poly: (start of a, end of b, start of b), where a,b are consecutive slots
+		// new perimeter edge goes to slot `n + index_of_this_step`
+		struct Step {
+			int a;
+			int b;
+		};
+
+		// input
+		Vector<int> start_key;
+		Vector<int> end_key;
+		Vector<POS> start_pos;
+		Vector<POS> end_pos;
+		Vector<POS> normal; // normal of poly adjacent to the slot edge
+
+		// output
+		int num_perimeter_edges = 0;
+		Vector<Step> steps;
+		int last_a = -1;
+		int last_b = -1;
+
+		void reserve(int n) {
+			int num_slots = std::max(2*n - 2, n);
+			start_key.reserve(num_slots);
+			end_key.reserve(num_slots);
+			start_pos.reserve(num_slots);
+			end_pos.reserve(num_slots);
+			normal.reserve(num_slots);
+		}
 
-	auto add_cand = [&](const auto& it){
+		template<class EDGE>
+		void add_edge(const EDGE& e) {
+			start_key.push_back(e.verts[0].key);
+			end_key.push_back(e.verts[1].key);
+			start_pos.push_back(e.verts[0].pos());
+			end_pos.push_back(e.verts[1].pos());
+			normal.push_back(compute_poly_normal(e.poly));
+		}
 
-		auto next = it;
-		++next;
-		if(next == perimeter.end()) next = perimeter.begin();
+		void run() {
+			const int n = (int)start_key.size();
+			DCHECK_GE(n, 2) << "hole perimeter too short";
 
-		DCHECK_EQ(it->get(m).verts[1].key, next->get(m).verts[0].key) << "edges not adjacent";
+			num_perimeter_edges = n;
 
-		auto cands_it = cands.insert({get_score(it->get(m), next->get(m)), it});
-		where_cands.insert({*it, cands_it});
+			Vector<int> next(std::max(2*n - 2, n));
+			Vector<int> prev(next.size());
+			for(int i=0; i<n; ++i) {
+				next[i] = (i+1) % n;
+				prev[i] = (i+n-1) % n;
+			}
 
-		//LOG(INFO) << "where_cands.insert(" << (*it) << ")";
-	};
+			Indexed_Heap<double, std::less<double>, ALLOCATOR> cands(next.size());
+			for(int i=0; i<n && n >= 3; ++i) {
+				cands.push(i, get_score(i, next[i]));
+			}
 
+			steps.reserve(std::max(n-2, 0));
+
+			int size = n;
+			while(size >= 3) {
+				int a = cands.top();
+				int b = next[a];
+				int p = prev[a];
+				int nb = next[b];
+
+				DCHECK_EQ(end_key[a], start_key[b]) << "edges not adjacent";
+
+				// new edge
+				int k = (int)start_key.size();
+				start_key.push_back(start_key[a]);
+				end_key.push_back(end_key[b]);
+				start_pos.push_back(start_pos[a]);
+				end_pos.push_back(end_pos[b]);
+				{
+					POS v01 = end_pos[b] - start_pos[a];
+					POS v02 = start_pos[b] - start_pos[a];
+					POS nrm = v01.cross(v02);
+					nrm.normalize();
+					normal.push_back(nrm);
+				}
+
+				steps.push_back({a, b});
+
+				cands.erase(a);
+				cands.erase(b);
+				--size;
+
+				if(size == 2) {
+					// p == nb
+					cands.erase(p);
+					last_a = p;
+					last_b = k;
+					break;
+				}
+
+				next[p] = k; prev[k] = p;
+				next[k] = nb; prev[nb] = k;
+
+				cands.update(p, get_score(p, k));
+				cands.push(k, get_score(k, nb));
+			}
 
-	auto del_cand = [&](const auto& e) {
+			if(n == 2) {
+				last_a = 0;
+				last_b = 1;
+			}
+		}
 
-		auto it = where_cands.find(e);
+	private:
+		double get_score(int e0, int e1) const {
+			POS t0 = end_pos[e0] - start_pos[e0];
+			POS t1 = end_pos[e1] - start_pos[e1];
 
-		DCHECK(it != where_cands.end()) << e << " not found in where_cands";
-		DCHECK(it->second != cands.end()) << e << " not found in cands";
+			POS my_normal = t1.cross( t0 );
+			my_normal.normalize();
 
-		cands.erase(it->second);
-		where_cands.erase(it);
-	};
+			auto score0 = normal[e0].dot(my_normal) + 1;
+			auto score1 = normal[e1].dot(my_normal) + 1;
 
+			// shape score: area / perimeter
+			double min_angle = std::min({
+				compute_angle(-t0, t1),
+				compute_angle(t0, (t0+t1).eval()),
+				compute_angle(-t1, (-(t0+t1)).eval())
+			});
 
-	auto he = edge.handle;
-	do {
-		while(he(m).next().has_link) {
-			he = he(m).next().link().handle;
+			return score0 * score1 * min_angle;
 		}
-
-		he = he(m).next().handle;
-
-		perimeter.push_back(he);
-	} while(he != edge.handle);
+	};
 
 
-	for(typename decltype(perimeter)::iterator iter = perimeter.begin(); iter != perimeter.end(); ++iter) {
-		add_cand(iter);
-	}
 
 
-	while(perimeter.size() >= 3) {
-		auto iter = cands.end(); --iter;
-		auto curr = iter->second;
+	//
+	// create polys and links computed by Hole_Triangulation
+	//
+	template<class MESH, class PERIMETER_ITER, class TRIANGULATION>
+	Cap_Hole_Result apply_hole_triangulation(MESH& m, const PERIMETER_ITER& perimeter, const TRIANGULATION& t) {
+		Cap_Hole_Result r;
 
-		//LOG(INFO) << "score: " << it->first;
+		using Handle = typename MESH::H_Poly_Edge;
 
-		// get next edge in perimeter
-		auto next = curr; ++next;
-		if(next == perimeter.end()) next = perimeter.begin();
+		const int n = t.num_perimeter_edges;
 
-		DCHECK_EQ(curr->get(m).verts[1].key, next->get(m).verts[0].key) << "edges not adjacent";
+		typename TRIANGULATION::template Vector<Handle> slots(perimeter, perimeter + n);
+		slots.resize(n + t.steps.size());
 
-		auto i0 = curr->get(m).verts[0].key;
-		auto i1 = next->get(m).verts[1].key;
-		auto i2 = curr->get(m).verts[1].key;
-		// add cand, cand+1 poly
-		auto p = m.polys.add(i0, i1, i2);
+		for(int i=0; i<(int)t.steps.size(); ++i) {
+			const auto& step = t.steps[i];
 
-		++r.num_polys_created;
+			auto p = m.polys.add(t.start_key[step.a], t.end_key[step.b], t.start_key[step.b]);
 
-		//LOG(INFO) << "add " << i0 << " " << i1 << " " << i2;
+			++r.num_polys_created;
+			SMESH_COUNT(POLYS_CREATED, 1);
 
-		// create missing edge-links
-		curr->get(m).link(p.edges[2]);
-		next->get(m).link(p.edges[1]);
+			// create missing edge-links
+			slots[step.a](m).link(p.edges[2]);
+			slots[step.b](m).link(p.edges[1]);
 
-		// create missing vertex-poly links
-		if constexpr(EDGE::Mesh::Has_Vert_Poly_Links) {
-			for(auto pv : p.verts) {
-				pv.vert.poly_links.add(pv);
+			// create missing vertex-poly links
+			if constexpr(MESH::Has_Vert_Poly_Links) {
+				for(auto pv : p.verts) {
+					pv.vert.poly_links.add(pv);
+				}
 			}
+
+			slots[n+i] = p.edges[0].handle;
 		}
 
-		// get prev edge in perimeter
-		auto prev = curr;
-		if(prev == perimeter.begin()) prev = perimeter.end();
-		--prev;
+		// add last edge-link
+		slots[t.last_a](m).link( slots[t.last_b](m) );
 
-		// insert new edge
-		auto new_edge = perimeter.insert(curr, p.edges[0].handle);
+		return r;
+	}
 
-		DCHECK_EQ(p.edges[0].verts[0].key, prev->get(m).verts[1].key) << "new_edge not adjacent";
-		DCHECK_EQ(p.edges[0].verts[1].key, next->get(m).verts[1].key) << "new_edge not adjacent";
+} // namespace smesh::internal
 
-		// erase 3 candidate polys from priority queue
-		del_cand(*prev);
-		del_cand(*next);
-		del_cand(*iter->second);
 
-		// remove 2 old edges
-		perimeter.erase(curr);
-		perimeter.erase(next);
 
-		// add 2 new candidate polys
-		add_cand(prev);
-		add_cand(new_edge);
 
-		DCHECK_EQ(perimeter.size(), cands.size());
-		DCHECK_EQ(where_cands.size(), cands.size());
-	}
 
-	// add last edge-link
-	{
-		auto it = perimeter.begin();
-		auto e0 = *it;
-		++it;
-		auto e1 = *it;
 
-		e0.get(m).link( e1.get(m) );
-	}
+//
+// for triangle meshes
+//
+template<class EDGE>
+Cap_Hole_Result cap_hole(const EDGE& edge) {
+	SMESH_SCOPED_TIMER("cap_hole");
+	using Mesh = typename EDGE::Mesh;
+	using Handle = std::remove_cv_t<decltype(edge.handle)>;
 
-	return r;
+	auto& m = edge.mesh;
+
+	std::vector<Handle, typename Mesh::template Allocator<Handle>> perimeter;
+	smesh::internal::get_hole_perimeter(edge, perimeter);
+
+	smesh::internal::Hole_Triangulation<typename Mesh::Pos, typename Mesh::template Allocator<char>> t;
+	t.reserve(perimeter.size());
+	for(const auto& h : perimeter) t.add_edge(h(m));
+
+	t.run();
+
+	return smesh::internal::apply_hole_triangulation(m, perimeter.begin(), t);
 }
 
 
@@ -182,21 +274,102 @@ struct Cap_Holes_Result {
 	int num_polys_created = 0;
 };
 
-template<class MESH>
-Cap_Holes_Result cap_holes(MESH& mesh) {
+//
+// holes are found first, then triangulated in parallel (see set_num_threads),
+// then polys are added to the mesh in one serial pass
+//
+// holes with a perimeter edge for which can_cap_edge(edge) is false are left open
+//
+template<class MESH, class CAN_CAP_EDGE>
+Cap_Holes_Result cap_holes(MESH& mesh, const CAN_CAP_EDGE& can_cap_edge) {
+	SMESH_SCOPED_TIMER("cap_holes");
 	Cap_Holes_Result r;
 
-	for(auto p : mesh.polys) {
-		for(auto pe : p.edges) {
-			if(!pe.has_link) {
-				auto lr = cap_hole(pe);
-				++r.num_holes_capped;
-				r.num_polys_created += lr.num_polys_created;
+	using Handle = typename MESH::H_Poly_Edge;
+
+	// triangulations grow on worker threads: the mesh allocator can be bound to the calling
+	// thread's resource (Arena_Allocator), which isn't thread-safe
+	using Triangulation = smesh::internal::Hole_Triangulation<typename MESH::Pos, std::allocator<char>>;
+
+	// all perimeters, concatenated
+	std::vector<Handle, typename MESH::template Allocator<Handle>> perimeters;
+	std::vector<int, typename MESH::template Allocator<int>> hole_begins;
+
+	{
+		SMESH_SCOPED_TIMER("cap_holes/find_holes");
+		std::vector<bool, typename MESH::template Allocator<bool>> visited(mesh.polys.domain_end() * MESH::POLY_SIZE);
+
+		for(auto p : mesh.polys) {
+			for(auto pe : p.edges) {
+				if(pe.has_link) continue;
+				if(visited[pe.handle.poly * MESH::POLY_SIZE + pe.handle.edge]) continue;
+
+				hole_begins.push_back((int)perimeters.size());
+				smesh::internal::get_hole_perimeter(pe, perimeters);
+
+				bool can_cap = true;
+				for(int i=hole_begins.back(); i<(int)perimeters.size(); ++i) {
+					visited[perimeters[i].poly * MESH::POLY_SIZE + perimeters[i].edge] = true;
+					if(!can_cap_edge(perimeters[i](mesh))) can_cap = false;
+				}
+
+				if(!can_cap) {
+					perimeters.resize(hole_begins.back());
+					hole_begins.pop_back();
+				}
 			}
 		}
+
+		hole_begins.push_back((int)perimeters.size());
+	}
+
+	const int num_holes = (int)hole_begins.size() - 1;
+
+	std::vector<Triangulation, typename MESH::template Allocator<Triangulation>> triangulations(num_holes);
+
+	// biggest holes first, for better load balancing
+	std::vector<int, typename MESH::template Allocator<int>> order(num_holes);
+	for(int i=0; i<num_holes; ++i) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return hole_begins[a+1] - hole_begins[a] > hole_begins[b+1] - hole_begins[b];
+	});
+
+	// parallelize only if there's enough work
+	const int grain = perimeters.size() < 4096 ? std::max(num_holes, 1) : 1;
+
+	const auto& const_mesh = mesh;
+	smesh::parallel_for(0, num_holes, grain, [&](int i) {
+		SMESH_SCOPED_TIMER("cap_holes/triangulate");
+		int hole = order[i];
+		auto& t = triangulations[hole];
+		t.reserve(hole_begins[hole+1] - hole_begins[hole]);
+		for(int j=hole_begins[hole]; j<hole_begins[hole+1]; ++j) {
+			t.add_edge(perimeters[j](const_mesh));
+		}
+		t.run();
+	});
+
+	int num_new_polys = 0;
+	for(int i=0; i<num_holes; ++i) {
+		num_new_polys += (int)triangulations[i].steps.size();
+	}
+	mesh.polys.reserve(mesh.polys.domain_end() + num_new_polys);
+
+	SMESH_SCOPED_TIMER("cap_holes/apply");
+
+	for(int i=0; i<num_holes; ++i) {
+		auto lr = smesh::internal::apply_hole_triangulation(mesh, perimeters.begin() + hole_begins[i], triangulations[i]);
+
+		++r.num_holes_capped;
+		r.num_polys_created += lr.num_polys_created;
 	}
 
 	return r;
 }
 
 
+
+template<class MESH>
+Cap_Holes_Result cap_holes(MESH& mesh) {
+	return cap_holes(mesh, [](const auto&) { return true; });
+}
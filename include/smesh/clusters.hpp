@@ -0,0 +1,502 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+//
+// spatially coherent patches of polys (meshlets), see partition_into_clusters
+//
+template<class SCALAR>
+struct Clusters {
+	using Scalar = SCALAR;
+	using Pos = Eigen::Matrix<SCALAR,3,1>;
+
+	struct Cluster {
+		int polys_begin = 0; // range of `polys` (and of `indices`, times POLY_SIZE)
+		int polys_end = 0;
+		int verts_begin = 0; // range of `verts`
+		int verts_end = 0;
+
+		// bounding box and bounding sphere
+		Pos min = Pos::Zero();
+		Pos max = Pos::Zero();
+		Pos center = Pos::Zero();
+		Scalar radius = 0;
+
+		// normal cone: dot(poly_normal, cone_axis) >= cone_cutoff for all polys (-1 if the normals
+		// span a half-space). with cone_cutoff > 0, the cluster is back-facing for unit view direction d
+		// if dot(d, cone_axis) >= sqrt(1 - cone_cutoff^2)
+		Pos cone_axis = Pos::Zero();
+		Scalar cone_cutoff = -1;
+
+		// clusters of the same color don't share verts
+		int color = 0;
+
+		int num_polys() const { return polys_end - polys_begin; }
+		int num_verts() const { return verts_end - verts_begin; }
+	};
+
+	std::vector<Cluster> clusters;
+
+	std::vector<int> polys;        // poly keys, grouped by cluster
+	std::vector<int> verts;        // vert keys, grouped by cluster: local vert i of cluster c is verts[c.verts_begin + i]
+	std::vector<uint16_t> indices; // local vert indices of `polys`, POLY_SIZE per poly
+	std::vector<int> poly_cluster; // poly key -> cluster, -1 for erased polys
+
+	int num_colors = 0;
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	// 21 bits of x spread to every 3rd bit
+	inline uint64_t spread_bits_3(uint64_t x) {
+		x &= 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffff;
+		x = (x | x << 16) & 0x1f0000ff0000ff;
+		x = (x | x << 8)  & 0x100f00f00f00f00f;
+		x = (x | x << 4)  & 0x10c30c30c30c30c3;
+		x = (x | x << 2)  & 0x1249249249249249;
+		return x;
+	}
+
+	// z-order curve index of a point of the [min,max] box
+	template<class POS>
+	uint64_t get_morton_code(const POS& p, const POS& min, const POS& max) {
+		uint64_t r = 0;
+		for(int j=0; j<3; ++j) {
+			const auto extent = max[j] - min[j];
+			const double t = extent > 0 ? double((p[j] - min[j]) / extent) : 0.0;
+			r |= spread_bits_3( uint64_t(std::clamp(t, 0.0, 1.0) * 0x1fffff) ) << j;
+		}
+		return r;
+	}
+
+
+
+	//
+	// vert key -> local index, for verts of one cluster (open addressing, cleared per cluster)
+	//
+	class Cluster_Vert_Map {
+	public:
+		explicit Cluster_Vert_Map(int max_verts) {
+			int size = 1;
+			while(size < 2 * max_verts) size *= 2;
+			table.resize(size);
+			clear();
+		}
+
+		void clear() { std::fill(table.begin(), table.end(), std::make_pair(-1, -1)); }
+
+		// local index, or -1
+		int find(int vert) const {
+			for(int i = get_slot(vert);; i = (i+1) & mask()) {
+				if(table[i].first == vert) return table[i].second;
+				if(table[i].first == -1) return -1;
+			}
+		}
+
+		void insert(int vert, int local) {
+			int i = get_slot(vert);
+			while(table[i].first != -1) i = (i+1) & mask();
+			table[i] = {vert, local};
+		}
+
+	private:
+		int mask() const { return (int)table.size() - 1; }
+		int get_slot(int vert) const { return int((uint32_t(vert) * 2654435761u) & uint32_t(mask())); }
+
+		std::vector<std::pair<int,int>> table;
+	};
+
+}
+
+
+
+
+
+//
+// partition polys into clusters (meshlets) of at most `max_verts` verts and `max_polys` polys
+//
+// - clusters are grown over edge links from seeds in z-order: the next poly is the neighbor that
+//   adds the fewest new verts, then the one closest to the cluster center and normal
+// - per cluster: its polys, local vertex remap (`verts` + `indices`, 16-bit), bounding box and
+//   sphere, normal cone, and a color (see parallel_for_clusters)
+// - polys are split in z-order into regions grown in parallel, so the result depends on the number
+//   of threads (see set_num_threads). clusters don't cross regions
+//
+// erased verts and polys are skipped. requires EDGE_LINKS
+//
+//   auto clusters = partition_into_clusters(mesh, 64, 124);
+//   for(const auto& c : clusters.clusters) draw(&clusters.indices[c.polys_begin * 3], c.num_polys(), ...);
+//
+template<class MESH>
+auto partition_into_clusters(const MESH& mesh, int max_verts = 64, int max_polys = 124) {
+	static_assert(MESH::Has_Edge_Links, "partition_into_clusters requires EDGE_LINKS");
+	SMESH_SCOPED_TIMER("partition_into_clusters");
+
+	constexpr int N = MESH::POLY_SIZE;
+	CHECK_GE(max_verts, N);
+	CHECK_LE(max_verts, 1 << 16) << "partition_into_clusters: local indices are 16-bit";
+	CHECK_GE(max_polys, 1);
+
+	using Scalar = typename MESH::Scalar;
+	using Pos = Eigen::Matrix<Scalar,3,1>;
+	using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+	using Poses = std::vector<Pos, typename MESH::template Allocator<Pos>>;
+
+	Clusters<Scalar> r;
+
+	const int domain_end = mesh.polys.domain_end();
+	r.poly_cluster.assign(domain_end, -1);
+
+	Ints keys;
+	keys.reserve(domain_end);
+	for(auto p : mesh.polys) keys.push_back(p.key);
+	const int num_polys = (int)keys.size();
+
+	if(num_polys == 0) return r;
+
+	const auto positions = decode_positions<Scalar>(mesh);
+
+	auto get_vert = [&mesh](int poly, int i) { return (int)mesh.polys.raw(poly).verts[i].key; };
+
+	// poly centroids and unit normals
+	Poses centroids(domain_end);
+	Poses normals(domain_end);
+	smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+		const int p = keys[i];
+		const auto& p0 = positions[get_vert(p, 0)];
+		Pos c = p0;
+		for(int j=1; j<N; ++j) c += positions[get_vert(p, j)];
+		centroids[p] = c / N;
+
+		Pos n = (positions[get_vert(p, 1)] - p0).cross(positions[get_vert(p, 2)] - p0);
+		const auto norm = n.norm();
+		normals[p] = norm > 0 ? Pos(n / norm) : Pos(Pos::Zero());
+	});
+
+
+
+	//
+	// spatial order, regions
+	//
+	{
+		SMESH_SCOPED_TIMER("partition_into_clusters/sort");
+
+		Pos min = Pos::Constant( std::numeric_limits<Scalar>::max() );
+		Pos max = -min;
+		for(auto p : keys) {
+			min = min.cwiseMin(centroids[p]);
+			max = max.cwiseMax(centroids[p]);
+		}
+
+		std::vector<uint64_t, typename MESH::template Allocator<uint64_t>> codes(domain_end);
+		smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+			codes[keys[i]] = smesh::internal::get_morton_code(centroids[keys[i]], min, max);
+		});
+
+		smesh::parallel_sort(keys.begin(), keys.end(), [&codes](int a, int b) {
+			return codes[a] != codes[b] ? codes[a] < codes[b] : a < b;
+		});
+	}
+
+	const int num_regions = smesh::get_num_threads(0, num_polys, std::max(1 << 14, max_polys * 64));
+	auto get_region_begin = [&](int region) { return int(int64_t(num_polys) * region / num_regions); };
+
+	Ints poly_region(domain_end, -1);
+	smesh::parallel_for(0, num_regions, 1, [&](int region) {
+		for(int i=get_region_begin(region); i<get_region_begin(region+1); ++i) poly_region[keys[i]] = region;
+	});
+
+
+
+	//
+	// grow clusters, each region in its own thread. poly_cluster is region-local at first
+	//
+	// region buffers grow and are freed on worker threads, so they use std::allocator (the MESH
+	// allocator may be an Arena_Allocator bound to this thread's resource)
+	//
+	struct Region {
+		std::vector<int> polys;
+		std::vector<int> verts;
+		std::vector<uint16_t> indices;
+		std::vector<int> polys_ends; // per cluster
+		std::vector<int> verts_ends;
+	};
+	std::vector<Region> regions(num_regions);
+
+	{
+		SMESH_SCOPED_TIMER("partition_into_clusters/grow");
+
+		// cluster that has the poly in its frontier, written by the poly's region only
+		Ints frontier_of(domain_end, -1);
+
+		smesh::parallel_for(0, num_regions, 1, [&](int region) {
+			auto& out = regions[region];
+			out.polys.reserve(get_region_begin(region+1) - get_region_begin(region));
+			out.indices.reserve(out.polys.capacity() * N);
+
+			smesh::internal::Cluster_Vert_Map vert_map(max_verts);
+			Ints frontier;
+
+			int next_seed = get_region_begin(region);
+			const int region_end = get_region_begin(region+1);
+
+			for(int cluster = 0;; ++cluster) {
+				while(next_seed < region_end && r.poly_cluster[ keys[next_seed] ] != -1) ++next_seed;
+				if(next_seed == region_end) break;
+
+				const int polys_begin = (int)out.polys.size();
+				const int verts_begin = (int)out.verts.size();
+				vert_map.clear();
+				frontier.clear();
+
+				Pos centroid_sum = Pos::Zero();
+				Pos normal_sum = Pos::Zero();
+
+				int candidate = keys[next_seed];
+				for(;;) {
+					r.poly_cluster[candidate] = cluster;
+					out.polys.push_back(candidate);
+
+					for(int j=0; j<N; ++j) {
+						const int v = get_vert(candidate, j);
+						int local = vert_map.find(v);
+						if(local == -1) {
+							local = (int)out.verts.size() - verts_begin;
+							vert_map.insert(v, local);
+							out.verts.push_back(v);
+						}
+						out.indices.push_back( uint16_t(local) );
+					}
+
+					centroid_sum += centroids[candidate];
+					normal_sum += normals[candidate];
+
+					for(int j=0; j<N; ++j) {
+						const int other = mesh.polys.raw(candidate).verts[j].edge_link.poly;
+						if(other == -1 || poly_region[other] != region) continue;
+						if(r.poly_cluster[other] != -1 || frontier_of[other] == cluster) continue;
+						frontier_of[other] = cluster;
+						frontier.push_back(other);
+					}
+
+					const int num_cluster_polys = (int)out.polys.size() - polys_begin;
+					const int num_cluster_verts = (int)out.verts.size() - verts_begin;
+					if(num_cluster_polys == max_polys) break;
+
+					// best neighbor: fewest new verts, then closest to the center and normal
+					const Pos center = centroid_sum / num_cluster_polys;
+					const Pos axis = normal_sum.normalized();
+
+					candidate = -1;
+					int best_new_verts = N + 1;
+					Scalar best_score = std::numeric_limits<Scalar>::max();
+
+					for(int i=0; i<(int)frontier.size();) {
+						const int f = frontier[i];
+						if(r.poly_cluster[f] != -1) {
+							frontier[i] = frontier.back();
+							frontier.pop_back();
+							continue;
+						}
+						++i;
+
+						int new_verts = 0;
+						for(int j=0; j<N; ++j) new_verts += vert_map.find( get_vert(f, j) ) == -1;
+						if(num_cluster_verts + new_verts > max_verts || new_verts > best_new_verts) continue;
+
+						const Scalar score = (centroids[f] - center).squaredNorm() * (2 - normals[f].dot(axis));
+						if(new_verts < best_new_verts || score < best_score) {
+							candidate = f;
+							best_new_verts = new_verts;
+							best_score = score;
+						}
+					}
+
+					if(candidate == -1) break;
+				}
+
+				out.polys_ends.push_back( (int)out.polys.size() );
+				out.verts_ends.push_back( (int)out.verts.size() );
+			}
+		});
+	}
+
+
+
+	//
+	// concatenate regions
+	//
+	Ints cluster_offsets(num_regions + 1, 0);
+	Ints poly_offsets(num_regions + 1, 0);
+	Ints vert_offsets(num_regions + 1, 0);
+	for(int i=0; i<num_regions; ++i) {
+		cluster_offsets[i+1] = cluster_offsets[i] + (int)regions[i].polys_ends.size();
+		poly_offsets[i+1] = poly_offsets[i] + (int)regions[i].polys.size();
+		vert_offsets[i+1] = vert_offsets[i] + (int)regions[i].verts.size();
+	}
+
+	r.clusters.resize(cluster_offsets.back());
+	r.polys.resize(poly_offsets.back());
+	r.verts.resize(vert_offsets.back());
+	r.indices.resize(size_t(poly_offsets.back()) * N);
+
+	smesh::parallel_for(0, num_regions, 1, [&](int region) {
+		auto& in = regions[region];
+
+		for(int i=0; i<(int)in.polys_ends.size(); ++i) {
+			auto& c = r.clusters[cluster_offsets[region] + i];
+			c.polys_begin = poly_offsets[region] + (i ? in.polys_ends[i-1] : 0);
+			c.polys_end = poly_offsets[region] + in.polys_ends[i];
+			c.verts_begin = vert_offsets[region] + (i ? in.verts_ends[i-1] : 0);
+			c.verts_end = vert_offsets[region] + in.verts_ends[i];
+		}
+
+		for(auto p : in.polys) r.poly_cluster[p] += cluster_offsets[region];
+
+		std::copy(in.polys.begin(), in.polys.end(), r.polys.begin() + poly_offsets[region]);
+		std::copy(in.verts.begin(), in.verts.end(), r.verts.begin() + vert_offsets[region]);
+		std::copy(in.indices.begin(), in.indices.end(), r.indices.begin() + size_t(poly_offsets[region]) * N);
+
+		in = Region();
+	});
+
+	const int num_clusters = (int)r.clusters.size();
+
+
+
+	//
+	// bounds and normal cones
+	//
+	smesh::parallel_for(0, num_clusters, 64, [&](int i) {
+		auto& c = r.clusters[i];
+
+		c.min = Pos::Constant( std::numeric_limits<Scalar>::max() );
+		c.max = -c.min;
+		for(int j=c.verts_begin; j<c.verts_end; ++j) {
+			c.min = c.min.cwiseMin(positions[r.verts[j]]);
+			c.max = c.max.cwiseMax(positions[r.verts[j]]);
+		}
+
+		c.center = (c.min + c.max) / 2;
+		c.radius = 0;
+		for(int j=c.verts_begin; j<c.verts_end; ++j) {
+			c.radius = std::max(c.radius, (positions[r.verts[j]] - c.center).norm());
+		}
+
+		Pos axis = Pos::Zero();
+		for(int j=c.polys_begin; j<c.polys_end; ++j) axis += normals[r.polys[j]];
+
+		c.cone_cutoff = -1;
+		c.cone_axis = Pos::Zero();
+		if(axis.squaredNorm() == 0) return;
+
+		c.cone_axis = axis.normalized();
+		c.cone_cutoff = 1;
+		for(int j=c.polys_begin; j<c.polys_end; ++j) {
+			c.cone_cutoff = std::min(c.cone_cutoff, normals[r.polys[j]].dot(c.cone_axis));
+		}
+		c.cone_cutoff = std::max(c.cone_cutoff, Scalar(-1));
+	});
+
+
+
+	//
+	// colors: greedy, clusters sharing a vert are adjacent
+	//
+	{
+		SMESH_SCOPED_TIMER("partition_into_clusters/colors");
+
+		std::vector<std::pair<int,int>, typename MESH::template Allocator<std::pair<int,int>>> vert_clusters;
+		vert_clusters.reserve(r.verts.size());
+		for(int i=0; i<num_clusters; ++i) {
+			for(int j=r.clusters[i].verts_begin; j<r.clusters[i].verts_end; ++j) vert_clusters.emplace_back(r.verts[j], i);
+		}
+		smesh::parallel_sort(vert_clusters.begin(), vert_clusters.end(), std::less<std::pair<int,int>>());
+
+		// adjacency, both directions
+		std::vector<std::pair<int,int>, typename MESH::template Allocator<std::pair<int,int>>> edges;
+		for(int b=0, e=0; b<(int)vert_clusters.size(); b=e) {
+			while(e < (int)vert_clusters.size() && vert_clusters[e].first == vert_clusters[b].first) ++e;
+			for(int i=b; i<e; ++i) {
+				for(int j=i+1; j<e; ++j) {
+					edges.emplace_back(vert_clusters[i].second, vert_clusters[j].second);
+					edges.emplace_back(vert_clusters[j].second, vert_clusters[i].second);
+				}
+			}
+		}
+		vert_clusters = decltype(vert_clusters)();
+
+		smesh::parallel_sort(edges.begin(), edges.end(), std::less<std::pair<int,int>>());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		std::vector<uint8_t> used;
+		for(int i=0, e=0; i<num_clusters; ++i) {
+			const int b = e;
+			while(e < (int)edges.size() && edges[e].first == i) ++e;
+
+			used.assign(e - b + 1, 0);
+			for(int j=b; j<e; ++j) {
+				const int other = edges[j].second;
+				if(other < i && r.clusters[other].color <= e - b) used[ r.clusters[other].color ] = 1;
+			}
+
+			auto& c = r.clusters[i];
+			c.color = int(std::find(used.begin(), used.end(), 0) - used.begin());
+			r.num_colors = std::max(r.num_colors, c.color + 1);
+		}
+	}
+
+	return r;
+}
+
+
+
+
+
+//
+// call fun(cluster_idx) for all clusters, in parallel. clusters run one color at a time, so
+// clusters processed at once share no verts: fun can modify its verts and polys (positions, props,
+// layers) without locks. topology changes are not safe (edge links cross clusters)
+//
+// fun may only read verts of its own cluster: a neighbor's verts (e.g. across the cluster border,
+// found through edge links) can be written concurrently by another cluster of the same color
+//
+template<class SCALAR, class FUN>
+void parallel_for_clusters(const Clusters<SCALAR>& clusters, const FUN& fun) {
+	const int num_clusters = (int)clusters.clusters.size();
+
+	// clusters ordered by color
+	std::vector<int> begins(clusters.num_colors + 1, 0);
+	for(const auto& c : clusters.clusters) ++begins[c.color + 1];
+	std::partial_sum(begins.begin(), begins.end(), begins.begin());
+
+	std::vector<int> order(num_clusters);
+	{
+		auto ends = begins;
+		for(int i=0; i<num_clusters; ++i) order[ ends[clusters.clusters[i].color]++ ] = i;
+	}
+
+	for(int color=0; color<clusters.num_colors; ++color) {
+		smesh::parallel_for(begins[color], begins[color+1], 4, [&](int i) { fun(order[i]); });
+	}
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "indexed-vert-props.hpp"
+#include "instrumentation.hpp"
+
+#include <vector>
+
 
 
 
@@ -22,15 +27,28 @@ void merge_verts(VERT& a, VERT& b, const typename VERT::Mesh::Scalar& alpha) {
 
 	// LOG(INFO) << "merge_verts(" << a.idx << ", " << b.idx << ", alpha:" << alpha << ")";
 
+	SMESH_COUNT(EDGES_COLLAPSED, 1);
+
+	if constexpr(VERT::Mesh::Has_Journal) a.mesh.journal.touch_vert(a.key);
+
 	a.pos = a.pos() * (1-alpha)  +  b.pos() * alpha;
 
 	if constexpr(VERT::Mesh::Has_Vert_Props) {
 		a.props = a.props * (1-alpha)  +  b.props * alpha;
 	}
 
+	if constexpr(VERT::Mesh::Has_Indexed_Vert_Props && VERT::Mesh::Has_Vert_Poly_Links) {
+		using Handle = typename VERT::Mesh::H_Poly_Vert;
+		std::vector<Handle, typename VERT::Mesh::template Allocator<Handle>> a_corners, b_corners;
+		for(auto pv : a.poly_links) a_corners.push_back(pv.handle);
+		for(auto pv : b.poly_links) b_corners.push_back(pv.handle);
+		smesh::internal::blend_indexed_vert_props(a.mesh, a.key, a_corners, b_corners, alpha);
+	}
+
 	// update polygons containing 'b': replace 'b'->'a'
 	if constexpr(VERT::Mesh::Has_Vert_Poly_Links) {
 		for(auto pv : b.poly_links) {
+			if constexpr(VERT::Mesh::Has_Journal) a.mesh.journal.touch_poly_vert(pv.handle);
 			pv.key = a.key;
 		}
 
@@ -68,6 +86,128 @@ void merge_verts(VERT& a, VERT& b, const typename VERT::Mesh::Scalar& alpha) {
 	}
 
 	b.erase();
+	SMESH_COUNT(VERTS_ERASED, 1);
+}
+
+
+
+
+
+
+
+//
+// collapse edge: merge 'e.verts[1]' into 'e.verts[0]'
+//
+// without VERT_POLY_LINKS, polygons around 'e.verts[1]' are found using its one-ring (see A_Ring).
+// in this case the collapse is refused (returns false) if it would make the mesh non-manifold
+// (link condition), because one-rings of non-manifold vertices are incomplete. the ring only walks
+// the fan of `e`, so both verts must be manifold: polys of a pinched 'e.verts[1]' outside that fan
+// would be left pointing at the erased vert (fast_collapse_edges skips such edges)
+//
+template<class EDGE>
+bool collapse_edge(const EDGE& e, const typename EDGE::Mesh::Scalar& alpha) {
+	using Mesh = typename EDGE::Mesh;
+
+	auto a = e.verts[0];
+	auto b = e.verts[1];
+
+	if constexpr(Mesh::Has_Vert_Poly_Links) {
+		merge_verts(a, b, alpha);
+	}
+	else {
+		static_assert(Mesh::Has_Edge_Links, "collapse_edge requires EDGE_LINKS or VERT_POLY_LINKS");
+
+		using Keys = std::vector<int, typename Mesh::template Allocator<int>>;
+
+		auto get_neighbors = [](const auto& pv, Keys& neighbors) {
+			auto ring = pv.ring();
+			int last = -1;
+			for(auto rpv : ring) {
+				neighbors.push_back(rpv.next().key);
+				last = rpv.prev().key;
+			}
+			if(ring.is_boundary()) neighbors.push_back(last);
+			return ring.is_boundary();
+		};
+
+		Keys a_neighbors;
+		Keys b_neighbors;
+		bool a_boundary = get_neighbors(e.prev_vert(), a_neighbors);
+		bool b_boundary = get_neighbors(e.next_vert(), b_neighbors);
+
+		// boundary verts connected through the interior
+		if(e.has_link && a_boundary && b_boundary) return false;
+
+		int num_common = 0;
+		for(auto an : a_neighbors) {
+			for(auto bn : b_neighbors) {
+				if(an == bn) ++num_common;
+			}
+		}
+
+		if(num_common != (e.has_link ? 2 : 1)) return false;
+
+		SMESH_COUNT(EDGES_COLLAPSED, 1);
+
+		auto& m = e.mesh;
+
+		if constexpr(Mesh::Has_Journal) m.journal.touch_vert(a.key);
+
+		a.pos = a.pos() * (1-alpha)  +  b.pos() * alpha;
+
+		if constexpr(Mesh::Has_Vert_Props) {
+			a.props = a.props * (1-alpha)  +  b.props * alpha;
+		}
+
+		std::vector<typename Mesh::H_Poly_Vert, typename Mesh::template Allocator<typename Mesh::H_Poly_Vert>> ring;
+		for(auto pv : e.next_vert().ring()) {
+			ring.push_back(pv.handle);
+		}
+
+		if constexpr(Mesh::Has_Indexed_Vert_Props) {
+			decltype(ring) a_ring;
+			for(auto pv : e.prev_vert().ring()) a_ring.push_back(pv.handle);
+			smesh::internal::blend_indexed_vert_props(m, a.key, a_ring, ring, alpha);
+		}
+
+		for(const auto& h : ring) {
+			if constexpr(Mesh::Has_Journal) m.journal.touch_poly_vert(h);
+			h(m).key = a.key;
+		}
+
+		// same as in merge_verts
+		for(const auto& h : ring) {
+			auto pv = h(m);
+
+			if(pv.key == pv.next().key) {
+				if(pv.prev_edge().has_link && pv.prev_edge().prev_edge().has_link) {
+					auto e0 = pv.prev_edge().link();
+					auto e1 = pv.prev_edge().prev_edge().link();
+					e0.unlink();
+					e1.unlink();
+					if(e0.poly != e1.poly) e0.link(e1);
+				}
+
+				pv.poly.erase();
+			}
+			else if(pv.key == pv.prev().key) {
+				if(pv.next_edge().has_link && pv.next_edge().next_edge().has_link) {
+					auto e0 = pv.next_edge().link();
+					auto e1 = pv.next_edge().next_edge().link();
+					e0.unlink();
+					e1.unlink();
+					if(e0.poly != e1.poly) e0.link(e1);
+				}
+
+				pv.poly.erase();
+			}
+		}
+
+		b.erase();
+		SMESH_COUNT(VERTS_ERASED, 1);
+	}
+
+	return true;
 }
 
 
@@ -96,6 +236,7 @@ struct Clean_Flat_Surfaces_On_Edges_Result {
 
 template<class MESH>
 auto clean_flat_surfaces_on_edges(MESH& mesh) {
+	SMESH_SCOPED_TIMER("clean_flat_surfaces_on_edges");
 
 	Clean_Flat_Surfaces_On_Edges_Result r;
 
@@ -104,6 +245,7 @@ auto clean_flat_surfaces_on_edges(MESH& mesh) {
 	while(change) {
 
 		++r.num_passes;
+		SMESH_COUNT(PASSES, 1);
 		change = false;
 
 		for(auto p : mesh.polys) {
@@ -166,28 +308,76 @@ struct Fast_Collapse_Edges_Result {
 //
 // it's good to call clean_flat_surfaces_on_edges after this
 //
-template<class MESH, class GET_V_WEIGHT>
-auto fast_collapse_edges(MESH& mesh, const typename MESH::Scalar& max_edge_length, const GET_V_WEIGHT& get_v_weight) {
+// edges for which can_collapse(edge) is false are kept (e.g. to pin boundary verts)
+//
+// without VERT_POLY_LINKS, edges at pinched verts (more than one fan of polys, e.g. bowties) are
+// kept too, see collapse_edge
+//
+template<class MESH, class GET_V_WEIGHT, class CAN_COLLAPSE>
+auto fast_collapse_edges(MESH& mesh, const typename MESH::Scalar& max_edge_length, const GET_V_WEIGHT& get_v_weight,
+		const CAN_COLLAPSE& can_collapse) {
+	SMESH_SCOPED_TIMER("fast_collapse_edges");
 	Fast_Collapse_Edges_Result r;
 
+	using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+
+	// without VERT_POLY_LINKS: corners per vert, to skip pinched verts (one-ring smaller than the
+	// number of corners, see collapse_edge), and corners of polys a collapse erases
+	Ints num_corners;
+	Ints erased_corners;
+	if constexpr(!MESH::Has_Vert_Poly_Links) {
+		num_corners.assign(mesh.verts.domain_end(), 0);
+		for(auto p : mesh.polys) {
+			for(auto pv : p.verts) ++num_corners[pv.key];
+		}
+	}
+
 	bool change = true;
 
 	while(change) {
 		change = false;
 		++r.num_passes;
+		SMESH_COUNT(PASSES, 1);
 
 		for(auto p : mesh.polys) {
 			for(auto e : p.edges) {
-				if(e.segment.trace().squaredNorm() <= max_edge_length * max_edge_length) {
+				// check each edge once
+				if(!e.owns_edge) continue;
+
+				if(e.segment.trace().squaredNorm() <= max_edge_length * max_edge_length && can_collapse(e)) {
+
+					const int a = e.verts[0].key;
+					const int b = e.verts[1].key;
+
+					if constexpr(!MESH::Has_Vert_Poly_Links) {
+						int ring_a = 0;
+						int ring_b = 0;
+						for(auto rpv : e.prev_vert().ring()) { (void)rpv; ++ring_a; }
+						for(auto rpv : e.next_vert().ring()) { (void)rpv; ++ring_b; }
+						if(ring_a != num_corners[a] || ring_b != num_corners[b]) continue;
+
+						// polys that become degenerate (same rule as collapse_edge)
+						erased_corners.clear();
+						for(auto rpv : e.next_vert().ring()) {
+							if(rpv.next().key != a && rpv.prev().key != a) continue;
+							for(auto pv : rpv.poly.verts) erased_corners.push_back(pv.key);
+						}
+					}
 
-					auto weight_sum = get_v_weight(e.verts[0].key) + get_v_weight(e.verts[1].key);
+					auto weight_sum = get_v_weight(a) + get_v_weight(b);
 
-					merge_verts(e.verts[0], e.verts[1], (typename MESH::Scalar)get_v_weight(e.verts[1].key) / weight_sum);
+					if(!collapse_edge(e, (typename MESH::Scalar)get_v_weight(b) / weight_sum)) continue;
 					++r.num_edges_collapsed;
 
+					if constexpr(!MESH::Has_Vert_Poly_Links) {
+						for(auto k : erased_corners) --num_corners[k];
+						num_corners[a] += num_corners[b];
+						num_corners[b] = 0;
+					}
+
 					// if weights can be modified
 					if constexpr(std::is_lvalue_reference_v<decltype(get_v_weight(0))>) {
-						get_v_weight(e.verts[0].key) += get_v_weight(e.verts[1].key);
+						get_v_weight(a) += get_v_weight(b);
 					}
 
 					//if(r.num_edges_collapsed >= Dupa::get()) {
@@ -205,9 +395,15 @@ auto fast_collapse_edges(MESH& mesh, const typename MESH::Scalar& max_edge_lengt
 }
 
 
+template<class MESH, class GET_V_WEIGHT>
+auto fast_collapse_edges(MESH& mesh, const typename MESH::Scalar& max_edge_length, const GET_V_WEIGHT& get_v_weight) {
+	return fast_collapse_edges(mesh, max_edge_length, get_v_weight, [](const auto&) { return true; });
+}
+
+
 template<class MESH>
 auto fast_collapse_edges(MESH& mesh, const typename MESH::Scalar& max_edge_length) {
-	std::vector<int32_t> weights(mesh.verts.domain_end(), 1);
+	std::vector<int32_t, typename MESH::template Allocator<int32_t>> weights(mesh.verts.domain_end(), 1);
 	return fast_collapse_edges(mesh, max_edge_length, [&weights](auto i) -> auto& { return weights[i]; });
 }
 
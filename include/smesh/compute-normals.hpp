@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mesh-utils.hpp"
+#include "instrumentation.hpp"
 
 #include <vector>
 
@@ -14,8 +15,9 @@
 template< class MESH, class GET_V_NORMAL >
 void fast_compute_vert_normals( MESH& mesh,
 		const GET_V_NORMAL& get_v_normal ) {
+	SMESH_SCOPED_TIMER("fast_compute_vert_normals");
 
-	std::vector<int> nums(mesh.verts.domain_end());
+	std::vector<int, typename MESH::template Allocator<int>> nums(mesh.verts.domain_end());
 
 	for(auto v : mesh.verts) {
 		get_v_normal(v.key) = {0,0,0};
@@ -71,8 +73,10 @@ void fast_compute_vert_normals( MESH& mesh ) {
 template< class MESH, class GET_V_NORMAL >
 void compute_vert_normals( MESH& mesh,
 		const GET_V_NORMAL& get_v_normal ) {
+	SMESH_SCOPED_TIMER("compute_vert_normals");
 
-	std::vector<typename MESH::Scalar> weights(mesh.verts.domain_end());
+	using Scalar = typename MESH::Scalar;
+	std::vector<Scalar, typename MESH::template Allocator<Scalar>> weights(mesh.verts.domain_end());
 
 	for(auto v : mesh.verts) {
 		get_v_normal(v.key) = {0,0,0};
@@ -102,3 +106,38 @@ template<class MESH>
 void compute_vert_normals( MESH& mesh ) {
 	compute_vert_normals( mesh, [&mesh](int iv) -> auto& { return mesh.verts[iv].props().normal; } );
 }
+
+
+
+
+
+
+
+
+
+
+//
+// compute normal of a single vertex, using its one-ring (see A_Ring) - works without VERT_POLY_LINKS
+// same weighting as compute_vert_normals
+//
+template< class POLY_VERT >
+auto compute_vert_normal( const POLY_VERT& pv ) {
+
+	using Scalar = typename POLY_VERT::Mesh::Scalar;
+
+	Eigen::Matrix<Scalar,3,1> normal = {0,0,0};
+	Scalar weight = 0;
+
+	for(auto rpv : pv.ring()) {
+		auto angle = compute_poly_vert_angle(rpv);
+		normal += compute_poly_normal(rpv.poly) * angle;
+		weight += angle;
+	}
+
+	if(weight > 0) {
+		normal /= weight;
+		normal.normalize();
+	}
+
+	return normal;
+}
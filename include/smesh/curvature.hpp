@@ -0,0 +1,195 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+
+
+//
+// discrete differential quantities of a vertex, see compute_vert_curvatures
+//
+template<class SCALAR>
+struct Vert_Curvature {
+	using Vector = Eigen::Matrix<SCALAR,3,1>;
+
+	SCALAR area = 0;         // mixed Voronoi area
+	SCALAR angle_defect = 0; // 2 pi - sum of corner angles (pi - sum on open edges)
+
+	SCALAR gaussian = 0;     // angle_defect / area
+	SCALAR mean = 0;         // cotangent Laplacian; positive where convex (polys facing out)
+
+	// principal curvatures (k1 >= k2) and their directions (unit, tangent, dir1 x dir2 = normal)
+	SCALAR k1 = 0;
+	SCALAR k2 = 0;
+	Vector dir1 = Vector::Zero();
+	Vector dir2 = Vector::Zero();
+};
+
+
+
+
+
+//
+// curvatures of all verts, in one parallel pass over the corners of each vertex
+//
+// - gaussian curvature from angle defect, and mean curvature from the cotangent Laplacian, both
+//   over mixed Voronoi areas (Meyer et al. 2003)
+// - principal directions from the edge-based curvature tensor (Cohen-Steiner & Morvan 2003): sum of
+//   dihedral angle * edge length * e e^T over the edges of the vertex
+//
+// requires EDGE_LINKS (dihedral angles and open edges). isolated verts get zeros, erased verts are
+// not written. computed in parallel, see set_num_threads
+//
+//   std::vector<Vert_Curvature<double>> curvatures(mesh.verts.domain_end());
+//   compute_vert_curvatures(mesh, [&](int v) -> auto& { return curvatures[v]; });
+//
+template<class MESH, class GET_V_CURVATURE>
+void compute_vert_curvatures(const MESH& mesh, const GET_V_CURVATURE& get_v_curvature) {
+	static_assert(MESH::Has_Edge_Links, "compute_vert_curvatures requires EDGE_LINKS");
+	static_assert(MESH::POLY_SIZE == 3, "compute_vert_curvatures requires triangles");
+	SMESH_SCOPED_TIMER("compute_vert_curvatures");
+
+	using Scalar = typename MESH::Scalar;
+	using Vector = Eigen::Matrix<Scalar,3,1>;
+	using Matrix = Eigen::Matrix<Scalar,3,3>;
+	using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+	constexpr int N = MESH::POLY_SIZE;
+
+	const int num_verts = mesh.verts.domain_end();
+	const auto positions = decode_positions<Scalar>(mesh);
+
+	Ints vert_keys;
+	vert_keys.reserve(num_verts);
+	for(auto v : mesh.verts) vert_keys.push_back(v.key);
+
+	auto get_vert = [&mesh](int poly, int i) { return (int)mesh.polys.raw(poly).verts[i].key; };
+	auto get_link = [&mesh](int poly, int i) -> const auto& { return mesh.polys.raw(poly).verts[i].edge_link; };
+
+	auto get_normal = [&](int poly) {
+		const Vector& a = positions[get_vert(poly, 0)];
+		return Vector( (positions[get_vert(poly, 1)] - a).cross(positions[get_vert(poly, 2)] - a) );
+	};
+
+	// corners of each vert (counting sort)
+	Ints corner_begins(num_verts + 1, 0);
+	for(auto p : mesh.polys) {
+		for(int i=0; i<N; ++i) ++corner_begins[get_vert(p.key, i) + 1];
+	}
+	std::partial_sum(corner_begins.begin(), corner_begins.end(), corner_begins.begin());
+
+	Ints corners(corner_begins.back());
+	{
+		auto ends = corner_begins;
+		for(auto p : mesh.polys) {
+			for(int i=0; i<N; ++i) corners[ ends[get_vert(p.key, i)]++ ] = p.key * N + i;
+		}
+	}
+
+	// dihedral angle * edge length * e e^T / 4 for half-edge i of the poly (each edge of a vert is
+	// seen from both of its polys)
+	auto get_edge_tensor = [&](int poly, int i, const Vector& normal) {
+		const auto& l = get_link(poly, i);
+		if(l.poly == -1) return Matrix(Matrix::Zero());
+
+		const Vector e = positions[get_vert(poly, (i+1) % N)] - positions[get_vert(poly, i)];
+		const Scalar length = e.norm();
+		const Vector other = get_normal(l.poly).normalized();
+		if(length == 0) return Matrix(Matrix::Zero());
+
+		// positive where convex
+		const Scalar dihedral = std::atan2(normal.cross(other).dot(e) / length, normal.dot(other));
+		return Matrix(dihedral * e * e.transpose() / (4 * length));
+	};
+
+	smesh::parallel_for(0, (int)vert_keys.size(), 4096, [&](int vi) {
+		const int v = vert_keys[vi];
+		Vert_Curvature<Scalar> r;
+
+		Scalar angle_sum = 0;
+		bool open = false;
+		Vector normal = Vector::Zero();
+		Vector laplacian = Vector::Zero();
+		Matrix tensor = Matrix::Zero();
+
+		for(int c=corner_begins[v]; c<corner_begins[v+1]; ++c) {
+			const int p = corners[c] / N;
+			const int i = corners[c] % N;
+			const int prev = (i+N-1) % N;
+
+			const Vector& xi = positions[v];
+			const Vector eij = positions[get_vert(p, (i+1) % N)] - xi;
+			const Vector eik = positions[get_vert(p, prev)] - xi;
+			const Vector ejk = eik - eij;
+
+			const Vector n = eij.cross(eik);
+			const Scalar double_area = n.norm();
+			if(double_area == 0) continue;
+
+			const Vector unit_normal = n / double_area;
+
+			const Scalar dot_i = eij.dot(eik);
+			const Scalar dot_j = -eij.dot(ejk);
+			const Scalar dot_k = eik.dot(ejk);
+			const Scalar cot_j = dot_j / double_area;
+			const Scalar cot_k = dot_k / double_area;
+
+			const Scalar angle = std::atan2(double_area, dot_i);
+			angle_sum += angle;
+			normal += unit_normal * angle;
+			laplacian += cot_k * eij + cot_j * eik;
+
+			// mixed area: Voronoi, unless the triangle is obtuse
+			if(dot_i < 0) r.area += double_area / 4;
+			else if(dot_j < 0 || dot_k < 0) r.area += double_area / 8;
+			else r.area += (eij.squaredNorm() * cot_k + eik.squaredNorm() * cot_j) / 8;
+
+			open = open || get_link(p, i).poly == -1 || get_link(p, prev).poly == -1;
+
+			tensor += get_edge_tensor(p, i, unit_normal) + get_edge_tensor(p, prev, unit_normal);
+		}
+
+		if(r.area > 0) {
+			r.angle_defect = (open ? Scalar(M_PI) : Scalar(2 * M_PI)) - angle_sum;
+			r.gaussian = r.angle_defect / r.area;
+
+			if(normal.squaredNorm() > 0) normal.normalize();
+			r.mean = -laplacian.dot(normal) / (4 * r.area);
+
+			const Scalar d = std::sqrt( std::max(Scalar(0), r.mean * r.mean - r.gaussian) );
+			r.k1 = r.mean + d;
+			r.k2 = r.mean - d;
+
+			// tensor eigenvectors: the normal, then the min and max curvature directions
+			Eigen::SelfAdjointEigenSolver<Matrix> solver(tensor / r.area);
+			int normal_idx = 0;
+			for(int j=1; j<3; ++j) {
+				if(std::abs(solver.eigenvectors().col(j).dot(normal)) >
+					std::abs(solver.eigenvectors().col(normal_idx).dot(normal))) normal_idx = j;
+			}
+
+			// eigenvalues are ascending: the larger tangent one is along the min curvature direction
+			Vector t = solver.eigenvectors().col(normal_idx == 2 ? 1 : 2);
+			t -= t.dot(normal) * normal;
+			if(t.squaredNorm() > 0) {
+				r.dir2 = t.normalized();
+				r.dir1 = r.dir2.cross(normal);
+			}
+		}
+
+		get_v_curvature(v) = r;
+	});
+}
+
+
+
+template<class MESH>
+void compute_vert_curvatures(MESH& mesh) {
+	compute_vert_curvatures( mesh, [&mesh](int iv) -> auto& { return mesh.verts[iv].props().curvature; } );
+}
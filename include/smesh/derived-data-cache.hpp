@@ -0,0 +1,395 @@
+#pragma once
+
+#include "fingerprint.hpp"
+#include "edge-links.hpp"
+#include "vert-poly-links.hpp"
+#include "compute-normals.hpp"
+#include "binary-stream.hpp"
+#include "instrumentation.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+
+//
+// derived data that can be cached
+//
+enum class Derived_Data {
+	NONE = 0,
+	EDGE_LINKS      = 0x0001, // fast_compute_edge_links
+	VERT_POLY_LINKS = 0x0002, // compute_vert_poly_links
+	VERT_NORMALS    = 0x0004  // compute_vert_normals
+};
+
+ENABLE_BITWISE_OPERATORS(Derived_Data);
+
+
+
+struct Compute_Derived_Data_Result {
+	uint64_t fingerprint = 0;
+	bool from_cache = false;
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	constexpr char derived_data_magic[4] = {'S','M','D','C'};
+	constexpr uint32_t derived_data_version = 1;
+
+	struct Derived_Data_Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t scalar_size;
+		uint32_t contents; // Derived_Data
+		uint64_t fingerprint;
+		int32_t verts_domain_end;
+		int32_t polys_domain_end;
+	};
+
+	inline std::filesystem::path get_derived_data_path(const std::filesystem::path& dir, uint64_t fingerprint) {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.smesh-cache", (unsigned long long)fingerprint);
+		return dir / name;
+	}
+
+
+
+	// sections are written in Derived_Data bit order, each prefixed with its size in bytes
+	template<class MESH, class GET_V_NORMAL>
+	void save_derived_data(const std::filesystem::path& path, const MESH& mesh, uint64_t fingerprint,
+			Derived_Data contents, const GET_V_NORMAL& get_v_normal) {
+		SMESH_SCOPED_TIMER("save_derived_data");
+
+		std::filesystem::create_directories(path.parent_path());
+
+		// write to a temporary file first, so readers never see partial files. the name is unique,
+		// so concurrent writers of the same mesh (threads or processes) don't share it
+		std::random_device random;
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", (unsigned)random(), (unsigned)random());
+
+		auto tmp_path = path;
+		tmp_path += suffix;
+
+		std::error_code error;
+
+		{
+			std::ofstream s(tmp_path, std::ios::binary);
+			if(!s) {
+				LOG(WARNING) << "can't write derived data cache " << tmp_path;
+				return;
+			}
+
+			Derived_Data_Header header = {
+				{derived_data_magic[0], derived_data_magic[1], derived_data_magic[2], derived_data_magic[3]},
+				derived_data_version,
+				(uint32_t)sizeof(typename MESH::Scalar),
+				(uint32_t)contents,
+				fingerprint,
+				mesh.verts.domain_end(),
+				mesh.polys.domain_end()
+			};
+			write_pod(s, &header, 1);
+
+			std::vector<int32_t> buffer;
+			auto write_section = [&]() {
+				uint64_t size = buffer.size() * sizeof(int32_t);
+				write_pod(s, &size, 1);
+				write_pod(s, buffer.data(), buffer.size());
+				buffer.clear();
+			};
+
+			if constexpr(MESH::Has_Edge_Links) {
+				if(bool(contents & Derived_Data::EDGE_LINKS)) {
+					for(auto p : mesh.polys) {
+						for(auto pe : p.edges) {
+							buffer.push_back(pe.has_link ? pe.link().handle.poly : -1);
+							buffer.push_back(pe.has_link ? pe.link().handle.edge : -1);
+						}
+					}
+					write_section();
+				}
+			}
+
+			if constexpr(MESH::Has_Vert_Poly_Links) {
+				if(bool(contents & Derived_Data::VERT_POLY_LINKS)) {
+					for(auto v : mesh.verts) {
+						buffer.push_back(v.poly_links.size());
+						for(auto pv : v.poly_links) {
+							buffer.push_back(pv.handle.poly);
+							buffer.push_back(pv.handle.vert);
+						}
+					}
+					write_section();
+				}
+			}
+
+			if(bool(contents & Derived_Data::VERT_NORMALS)) {
+				uint64_t size = 0;
+				for(auto v : mesh.verts) { (void)v; size += 3 * sizeof(typename MESH::Scalar); }
+				write_pod(s, &size, 1);
+				for(auto v : mesh.verts) {
+					const auto& normal = get_v_normal(v.key);
+					for(int i=0; i<3; ++i) {
+						typename MESH::Scalar x = normal[i];
+						write_pod(s, &x, 1);
+					}
+				}
+			}
+
+			if(!s) {
+				LOG(WARNING) << "can't write derived data cache " << tmp_path;
+				s.close();
+				std::filesystem::remove(tmp_path, error);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmp_path, path, error);
+		if(error) {
+			LOG(WARNING) << "can't write derived data cache " << path << ": " << error.message();
+			std::filesystem::remove(tmp_path, error);
+		}
+	}
+
+
+
+	// returns false if there's no valid cache file with all `contents`. sections are read and
+	// checked against the mesh before anything is applied, so the mesh is untouched on failure
+	// (e.g. truncated or corrupt file): links must point to live polys, edge links both ways
+	// between edges with the same verts, vert-poly links to corners of their vert
+	template<class MESH, class GET_V_NORMAL>
+	bool load_derived_data(const std::filesystem::path& path, MESH& mesh, uint64_t fingerprint,
+			Derived_Data contents, const GET_V_NORMAL& get_v_normal) {
+		SMESH_SCOPED_TIMER("load_derived_data");
+
+		constexpr int N = MESH::POLY_SIZE;
+		using Scalar = typename MESH::Scalar;
+
+		std::ifstream s(path, std::ios::binary);
+		if(!s) return false;
+
+		Derived_Data_Header header;
+		if(!try_read_pod(s, &header, 1)) return false;
+
+		if(!std::equal(header.magic, header.magic + 4, derived_data_magic) ||
+				header.version != derived_data_version ||
+				header.scalar_size != sizeof(Scalar) ||
+				header.fingerprint != fingerprint ||
+				header.verts_domain_end != mesh.verts.domain_end() ||
+				header.polys_domain_end != mesh.polys.domain_end() ||
+				(Derived_Data(header.contents) & contents) != contents) {
+			return false;
+		}
+
+		int num_verts = 0;
+		for(auto v : mesh.verts) { (void)v; ++num_verts; }
+
+		// index of each live poly in the order of records, -1 for erased polys
+		std::vector<int> poly_index(mesh.polys.domain_end(), -1);
+		int num_polys = 0;
+		for(auto p : mesh.polys) poly_index[p.key] = num_polys++;
+
+		// read section if requested, skip otherwise. sections have fixed sizes for this mesh
+		// (vert-poly links: a count per vert, and each corner once)
+		bool valid = true;
+		auto read_section = [&](Derived_Data section, auto& out, int64_t expected_size) {
+			if(!valid || !bool(Derived_Data(header.contents) & section)) return false;
+
+			uint64_t size;
+			if(!try_read_pod(s, &size, 1)) return valid = false;
+
+			if(!bool(contents & section)) {
+				s.seekg(size, std::ios::cur);
+				valid = bool(s);
+				return false;
+			}
+
+			if(size != uint64_t(expected_size) * sizeof(out[0])) return valid = false;
+
+			out.resize(expected_size);
+			if(!try_read_pod(s, out.data(), out.size())) return valid = false;
+			return true;
+		};
+
+		std::vector<int32_t> edge_links;
+		const bool has_edge_links = read_section(Derived_Data::EDGE_LINKS, edge_links, int64_t(num_polys) * N * 2);
+		if(has_edge_links && valid) {
+			auto get_vert = [&mesh](int poly, int i) { return mesh.polys.raw(poly).verts[i % N].key; };
+
+			// links go to live polys, both ways, between edges with the same (reversed) verts
+			for(auto p : mesh.polys) {
+				for(int j=0; j<N && valid; ++j) {
+					const int64_t i = (int64_t(poly_index[p.key]) * N + j) * 2;
+					const int link_poly = edge_links[i];
+					const int link_edge = edge_links[i+1];
+					if(link_poly == -1 && link_edge == -1) continue;
+
+					if(link_poly < 0 || link_poly >= header.polys_domain_end || link_edge < 0 || link_edge >= N ||
+							link_poly == p.key || poly_index[link_poly] == -1) {
+						valid = false;
+						break;
+					}
+
+					const int64_t back = (int64_t(poly_index[link_poly]) * N + link_edge) * 2;
+					if(edge_links[back] != p.key || edge_links[back+1] != j ||
+							get_vert(p.key, j) != get_vert(link_poly, link_edge + 1) ||
+							get_vert(p.key, j + 1) != get_vert(link_poly, link_edge)) {
+						valid = false;
+					}
+				}
+			}
+		}
+
+		std::vector<int32_t> poly_links;
+		const bool has_poly_links = read_section(Derived_Data::VERT_POLY_LINKS, poly_links,
+			num_verts + int64_t(num_polys) * N * 2);
+		if(has_poly_links) {
+			int64_t i = 0;
+			for(int k=0; k<num_verts && valid; ++k) {
+				const int n = poly_links[i++];
+				if(n < 0 || i + 2 * int64_t(n) > (int64_t)poly_links.size()) {
+					valid = false;
+					break;
+				}
+				for(int j=0; j<n; ++j, i+=2) {
+					if(poly_links[i] < 0 || poly_links[i] >= header.polys_domain_end ||
+							poly_links[i+1] < 0 || poly_links[i+1] >= N) valid = false;
+				}
+			}
+			if(i != (int64_t)poly_links.size()) valid = false;
+
+			// corners of live polys, that use the vert
+			i = 0;
+			for(auto v : mesh.verts) {
+				if(!valid) break;
+				const int n = poly_links[i++];
+				for(int j=0; j<n; ++j, i+=2) {
+					if(poly_index[ poly_links[i] ] == -1 || mesh.polys.raw(poly_links[i]).verts[ poly_links[i+1] ].key != v.key) {
+						valid = false;
+					}
+				}
+			}
+		}
+
+		std::vector<Scalar> normals;
+		const bool has_normals = read_section(Derived_Data::VERT_NORMALS, normals, int64_t(num_verts) * 3);
+
+		if(!valid) {
+			LOG(WARNING) << "invalid derived data cache " << path << ", recomputing";
+			return false;
+		}
+
+
+
+		if constexpr(MESH::Has_Edge_Links) {
+			if(has_edge_links) {
+				int i = 0;
+				for(auto p : mesh.polys) {
+					for(auto pe : p.edges) {
+						const int link_poly = edge_links[i++];
+						const int link_edge = edge_links[i++];
+						if(link_poly == -1) continue;
+
+						typename MESH::H_Poly_Edge other{link_poly, (int8_t)link_edge};
+						if(pe.handle < other) pe.link( other(mesh) );
+					}
+				}
+			}
+		}
+
+		if constexpr(MESH::Has_Vert_Poly_Links) {
+			if(has_poly_links) {
+				int i = 0;
+				for(auto v : mesh.verts) {
+					const int n = poly_links[i++];
+					auto& set = mesh.verts.raw(v.key).poly_links;
+					set.reserve(n);
+					for(int j=0; j<n; ++j, i+=2) {
+						set.insert({poly_links[i], (int8_t)poly_links[i+1]});
+					}
+				}
+			}
+		}
+
+		if(has_normals) {
+			int i = 0;
+			for(auto v : mesh.verts) {
+				get_v_normal(v.key) = {normals[i], normals[i+1], normals[i+2]};
+				i += 3;
+			}
+		}
+
+		return true;
+	}
+
+}
+
+
+
+
+
+//
+// computes derived data `what` for a freshly loaded mesh (no links yet), or loads it from
+// `cache_dir` if this mesh (see compute_fingerprint) was processed before
+//
+//   compute_derived_data(mesh, "cache", Derived_Data::EDGE_LINKS | Derived_Data::VERT_POLY_LINKS);
+//
+template<class MESH, class GET_V_NORMAL>
+Compute_Derived_Data_Result compute_derived_data(MESH& mesh, const std::filesystem::path& cache_dir,
+		Derived_Data what, const GET_V_NORMAL& get_v_normal) {
+	SMESH_SCOPED_TIMER("compute_derived_data");
+
+	if constexpr(!MESH::Has_Edge_Links) what = what & ~Derived_Data::EDGE_LINKS;
+	if constexpr(!MESH::Has_Vert_Poly_Links) what = what & ~Derived_Data::VERT_POLY_LINKS;
+
+	Compute_Derived_Data_Result r;
+	r.fingerprint = compute_fingerprint(mesh);
+
+	auto path = smesh::internal::get_derived_data_path(cache_dir, r.fingerprint);
+
+	if(smesh::internal::load_derived_data(path, mesh, r.fingerprint, what, get_v_normal)) {
+		r.from_cache = true;
+		return r;
+	}
+
+	if constexpr(MESH::Has_Edge_Links) {
+		if(bool(what & Derived_Data::EDGE_LINKS)) fast_compute_edge_links(mesh);
+	}
+
+	if constexpr(MESH::Has_Vert_Poly_Links) {
+		if(bool(what & Derived_Data::VERT_POLY_LINKS)) compute_vert_poly_links(mesh);
+	}
+
+	if(bool(what & Derived_Data::VERT_NORMALS)) compute_vert_normals(mesh, get_v_normal);
+
+	smesh::internal::save_derived_data(path, mesh, r.fingerprint, what, get_v_normal);
+
+	return r;
+}
+
+
+
+//
+// without VERT_NORMALS
+//
+template<class MESH>
+Compute_Derived_Data_Result compute_derived_data(MESH& mesh, const std::filesystem::path& cache_dir, Derived_Data what) {
+	DCHECK(!bool(what & Derived_Data::VERT_NORMALS)) << "compute_derived_data: pass get_v_normal to cache normals";
+	what = what & ~Derived_Data::VERT_NORMALS;
+
+	return compute_derived_data(mesh, cache_dir, what, [](int) -> typename MESH::Pos& {
+		static typename MESH::Pos unused;
+		return unused;
+	});
+}
+
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "instrumentation.hpp"
+
 
 
 
@@ -18,6 +20,7 @@
 //
 template< class MESH >
 bool has_valid_edge_links( const MESH& mesh ) {
+	SMESH_SCOPED_TIMER("has_valid_edge_links");
 
 	for( auto p : mesh.polys ) {
 		for( auto pe : p.edges ) {
@@ -39,6 +42,7 @@ bool has_valid_edge_links( const MESH& mesh ) {
 //
 template< class MESH >
 bool has_all_edge_links( const MESH& mesh ) {
+	SMESH_SCOPED_TIMER("has_all_edge_links");
 
 	for( auto p : mesh.polys ) {
 		for( auto pe : p.edges ) {
@@ -93,11 +97,15 @@ struct Fast_Compute_Edge_Links_Result {
 
 template<class MESH>
 auto fast_compute_edge_links(MESH& mesh) {
+	SMESH_SCOPED_TIMER("fast_compute_edge_links");
 
 	Fast_Compute_Edge_Links_Result result;
 
 	using namespace std;
-	unordered_multimap< pair<int,int>, typename MESH::H_Poly_Edge > open_edges;
+	using Key = pair<int,int>;
+	using Value = typename MESH::H_Poly_Edge;
+	unordered_multimap< Key, Value, hash<Key>, equal_to<Key>,
+		typename MESH::template Allocator<pair<const Key, Value>> > open_edges;
 
 	for(auto p : mesh.polys) {
 		for(auto pe : p.edges) {
@@ -107,6 +115,7 @@ auto fast_compute_edge_links(MESH& mesh) {
 			std::swap(rev_edge_key.first, rev_edge_key.second);
 
 			auto it = open_edges.find(rev_edge_key);
+			SMESH_COUNT(HASH_PROBES, 1);
 
 			if(it == open_edges.end()) {
 				open_edges.insert({edge_key, pe.handle});
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+
+namespace smesh::internal {
+
+	//
+	// xxHash64-style hasher over 64-bit words: 4 independent lanes, merged and avalanched in get()
+	//
+	class Hasher {
+	public:
+		explicit Hasher(uint64_t seed = 0) : lanes{seed + P1 + P2, seed + P2, seed, seed - P1} {}
+
+		void add(uint64_t x) {
+			auto& lane = lanes[num_words & 3];
+			lane = round(lane, x);
+			++num_words;
+		}
+
+		template<class T>
+		void add_pod(const T& x) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const char* bytes = reinterpret_cast<const char*>(&x);
+			size_t i = 0;
+			for(; i + 8 <= sizeof(T); i += 8) {
+				uint64_t w;
+				std::memcpy(&w, bytes + i, 8);
+				add(w);
+			}
+			if(i < sizeof(T)) {
+				uint64_t w = 0;
+				std::memcpy(&w, bytes + i, sizeof(T) - i);
+				add(w);
+			}
+		}
+
+		uint64_t get() const {
+			uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+			for(auto lane : lanes) {
+				h ^= round(0, lane);
+				h = h * P1 + P4;
+			}
+			h += num_words * 8;
+
+			h ^= h >> 33;
+			h *= P2;
+			h ^= h >> 29;
+			h *= P3;
+			h ^= h >> 32;
+			return h;
+		}
+
+	private:
+		static constexpr uint64_t P1 = 11400714785074694791ULL;
+		static constexpr uint64_t P2 = 14029467366897019727ULL;
+		static constexpr uint64_t P3 =  1609587929392839161ULL;
+		static constexpr uint64_t P4 =  9650029242287828579ULL;
+
+		static uint64_t rotl(uint64_t x, int r) {
+			return (x << r) | (x >> (64 - r));
+		}
+
+		static uint64_t round(uint64_t acc, uint64_t x) {
+			acc += x * P2;
+			acc = rotl(acc, 31);
+			return acc * P1;
+		}
+
+		uint64_t lanes[4];
+		uint64_t num_words = 0;
+	};
+
+
+
+	//
+	// hash of fixed-size chunks in parallel, then hash of chunk hashes in order
+	// (result does not depend on the number of threads)
+	//
+	template<class ALLOCATOR, class FUN>
+	uint64_t hash_chunked(int n, const FUN& hash_item) {
+		constexpr int chunk_size = 16384;
+		const int num_chunks = (n + chunk_size - 1) / chunk_size;
+
+		std::vector<uint64_t, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<uint64_t>> chunk_hashes(num_chunks);
+
+		smesh::parallel_for(0, num_chunks, 1, [&](int chunk) {
+			Hasher hasher(chunk);
+			const int end = std::min(n, (chunk+1) * chunk_size);
+			for(int i = chunk * chunk_size; i < end; ++i) hash_item(hasher, i);
+			chunk_hashes[chunk] = hasher.get();
+		});
+
+		Hasher hasher(n);
+		for(auto h : chunk_hashes) hasher.add(h);
+		return hasher.get();
+	}
+
+}
+
+
+
+
+
+//
+// content hash of mesh positions and poly indices (including keys, so derived data that refers
+// to keys can be keyed by it). computed in parallel, see set_num_threads
+//
+template<class MESH>
+uint64_t compute_fingerprint(const MESH& mesh) {
+	SMESH_SCOPED_TIMER("compute_fingerprint");
+
+	using Allocator = typename MESH::template Allocator<char>;
+
+	// live keys, so chunks can be processed independently
+	std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+	vert_keys.reserve(mesh.verts.domain_end());
+	poly_keys.reserve(mesh.polys.domain_end());
+	for(auto v : mesh.verts) vert_keys.push_back(v.key);
+	for(auto p : mesh.polys) poly_keys.push_back(p.key);
+
+	auto verts_hash = smesh::internal::hash_chunked<Allocator>((int)vert_keys.size(), [&](auto& hasher, int i) {
+		const int key = vert_keys[i];
+		const auto& pos = mesh.verts.pos_codec.decode( mesh.verts.raw(key).pos );
+		hasher.add(key);
+		for(int j=0; j<3; ++j) hasher.add_pod(pos[j]);
+	});
+
+	auto polys_hash = smesh::internal::hash_chunked<Allocator>((int)poly_keys.size(), [&](auto& hasher, int i) {
+		const int key = poly_keys[i];
+		hasher.add(key);
+		for(const auto& pv : mesh.polys.raw(key).verts) hasher.add(pv.key);
+	});
+
+	smesh::internal::Hasher hasher;
+	hasher.add(sizeof(typename MESH::Scalar));
+	hasher.add(MESH::POLY_SIZE);
+	hasher.add(verts_hash);
+	hasher.add(polys_hash);
+	return hasher.get();
+}
+
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+
+
+namespace smesh::internal {
+
+	//
+	// random access over soup positions `positions[order[i]]`, converted to MESH::Pos, so
+	// verts.add_range reads the soup directly
+	//
+	template<class MESH, class POS>
+	class Soup_Pos_Iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = typename MESH::Pos;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = value_type;
+
+		Soup_Pos_Iterator(const POS* p, const int* o) : positions(p), order(o) {}
+
+		value_type operator[](difference_type i) const {
+			using Scalar = typename MESH::Scalar;
+			const auto& p = positions[ order[i] ];
+			return value_type( Scalar(p[0]), Scalar(p[1]), Scalar(p[2]) );
+		}
+
+		value_type operator*() const { return (*this)[0]; }
+
+		Soup_Pos_Iterator& operator++() { ++order; return *this; }
+		Soup_Pos_Iterator operator+(difference_type n) const { return {positions, order + n}; }
+		difference_type operator-(const Soup_Pos_Iterator& o) const { return order - o.order; }
+
+		bool operator==(const Soup_Pos_Iterator& o) const { return order == o.order; }
+		bool operator!=(const Soup_Pos_Iterator& o) const { return order != o.order; }
+
+	private:
+		const POS* positions;
+		const int* order;
+	};
+
+
+
+	//
+	// link half-edges of a fresh mesh (no links, no erased polys), without a hash map:
+	// half-edges are bucketed by their first vertex (counting sort)
+	//
+	// the first a->b half-edge is linked with the first b->a one, so non-manifold edges are left open
+	//
+	template<class MESH>
+	void link_edges_by_vert(MESH& mesh) {
+		SMESH_SCOPED_TIMER("link_edges_by_vert");
+
+		const int num_verts = mesh.verts.domain_end();
+		const int num_polys = mesh.polys.domain_end();
+		constexpr int N = MESH::POLY_SIZE;
+
+		auto get_vert = [&mesh](int half_edge, int offset) {
+			return (int)mesh.polys.raw(half_edge / N).verts[(half_edge + offset) % N].key;
+		};
+
+		// half-edges (poly_key * N + edge_idx) starting at vert v: half_edges[ begins[v] .. begins[v+1] )
+		std::vector<int, typename MESH::template Allocator<int>> begins(num_verts + 1, 0);
+		for(auto p : mesh.polys) {
+			for(const auto& pv : mesh.polys.raw(p.key).verts) ++begins[pv.key + 1];
+		}
+		std::partial_sum(begins.begin(), begins.end(), begins.begin());
+
+		std::vector<int, typename MESH::template Allocator<int>> half_edges(begins.back());
+		{
+			auto ends = begins;
+			for(auto p : mesh.polys) {
+				for(int i=0; i<N; ++i) half_edges[ ends[get_vert(p.key*N + i, 0)]++ ] = p.key*N + i;
+			}
+		}
+
+		// first half-edge a->b, or -1
+		auto find = [&](int a, int b) {
+			for(int i=begins[a]; i<begins[a+1]; ++i) {
+				if(get_vert(half_edges[i], 1) == b) return half_edges[i];
+			}
+			return -1;
+		};
+
+		// each pair is linked by the thread that sees its lower half-edge
+		smesh::parallel_for(0, num_polys, 16384, [&](int poly) {
+			for(int i=0; i<N; ++i) {
+				const int h = poly*N + i;
+				const int a = get_vert(h, 0);
+				const int b = get_vert(h, 1);
+
+				const int other = find(b, a);
+				if(other == -1 || other < h || find(a, b) != h) continue;
+
+				typename MESH::H_Poly_Edge{h / N, int8_t(h % N)}(mesh).link(
+					typename MESH::H_Poly_Edge{other / N, int8_t(other % N)}(mesh) );
+			}
+		});
+	}
+
+}
+
+
+
+
+
+//
+// convert triangle soup (every triangle has its own 3 positions, e.g. STL) to indexed mesh
+//
+// - positions are deduplicated exactly (equal coordinates) with a parallel sort,
+//   vertex keys follow lexicographic order of positions
+// - triangles degenerated by deduplication are dropped
+// - computes edge links (EDGE_LINKS) and vert-poly links (VERT_POLY_LINKS)
+//
+// extra memory besides the mesh, at peak the larger of:
+// - 8 bytes per soup vertex (sort order and indices), plus up to 2 for the merge buffers of
+//   the parallel sort (std::inplace_merge, while indices are not allocated yet)
+// - with EDGE_LINKS, 4 bytes per poly corner (half-edges) and 8 per mesh vertex (bucket bounds)
+//
+//   auto mesh = from_soup<Smesh<float>>(soup.data(), (int)soup.size());
+//
+template<class MESH, class POS>
+MESH from_soup(const POS* positions, int num_positions) {
+	SMESH_SCOPED_TIMER("from_soup");
+	CHECK_EQ(0, num_positions % MESH::POLY_SIZE) << "from_soup: number of positions must be divisible by POLY_SIZE";
+
+	using Allocator = typename MESH::template Allocator<int>;
+	using Scalar = typename MESH::Scalar;
+
+	auto less = [positions](int a, int b) {
+		const auto& pa = positions[a];
+		const auto& pb = positions[b];
+		for(int i=0; i<3; ++i) {
+			if(Scalar(pa[i]) != Scalar(pb[i])) return Scalar(pa[i]) < Scalar(pb[i]);
+		}
+		return false;
+	};
+
+	// soup vertices sorted by position
+	std::vector<int, Allocator> order(num_positions);
+	std::iota(order.begin(), order.end(), 0);
+	smesh::parallel_sort(order.begin(), order.end(), less);
+
+	// soup vertex -> mesh vertex; `order` becomes mesh vertex -> its first soup vertex
+	std::vector<int, Allocator> indices(num_positions);
+	int num_verts = 0;
+	for(int i=0; i<num_positions; ++i) {
+		if(i == 0 || less(order[num_verts-1], order[i])) order[num_verts++] = order[i];
+		indices[ order[i] ] = num_verts - 1;
+	}
+
+	MESH mesh;
+
+	const smesh::internal::Soup_Pos_Iterator<MESH, POS> unique(positions, order.data());
+	mesh.verts.add_range(unique, unique + num_verts);
+	order = decltype(order)();
+
+	// drop degenerate triangles
+	constexpr int N = MESH::POLY_SIZE;
+	int num_polys = 0;
+	for(int i=0; i<num_positions/N; ++i) {
+		const int* t = &indices[i*N];
+		if(t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) continue;
+		std::copy(t, t+N, &indices[num_polys*N]);
+		++num_polys;
+	}
+
+	mesh.polys.add_range(indices.data(), num_polys, MESH::Has_Vert_Poly_Links);
+	indices = decltype(indices)();
+
+	if constexpr(MESH::Has_Edge_Links) smesh::internal::link_edges_by_vert(mesh);
+
+	return mesh;
+}
+
+
+
+template<class MESH, class CONTAINER>
+MESH from_soup(const CONTAINER& positions) {
+	return from_soup<MESH>(positions.data(), (int)positions.size());
+}
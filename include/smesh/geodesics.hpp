@@ -0,0 +1,501 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <Eigen/Sparse>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+enum class Geodesic_Method {
+	DIJKSTRA,      // shortest paths along edges: fast, overestimates (paths can't cross polys)
+	FAST_MARCHING, // wavefront over polys: first-order accurate, same cost as Dijkstra
+	HEAT           // heat method (Crane et al. 2013): two sparse solves, factored once per batch
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// monotone priority queue for non-negative keys: pushed keys must not be smaller than the last
+	// popped one (as in Dijkstra). elements move to lower buckets at most 64 times
+	//
+	template<class VALUE>
+	class Radix_Heap {
+	public:
+		bool empty() const { return size == 0; }
+
+		// keys below the last popped key are raised to it
+		void push(double key, const VALUE& value) {
+			const uint64_t bits = std::max(to_bits(key), last);
+			buckets[get_bucket(bits)].push_back({bits, value});
+			++size;
+		}
+
+		std::pair<double, VALUE> pop() {
+			DCHECK(!empty());
+
+			if(buckets[0].empty()) {
+				int i = 1;
+				while(buckets[i].empty()) ++i;
+
+				last = buckets[i][0].key;
+				for(const auto& e : buckets[i]) last = std::min(last, e.key);
+
+				// all go to lower buckets
+				scratch.swap(buckets[i]);
+				for(const auto& e : scratch) buckets[get_bucket(e.key)].push_back(e);
+				scratch.clear();
+			}
+
+			const auto e = buckets[0].back();
+			buckets[0].pop_back();
+			--size;
+			return {from_bits(e.key), e.value};
+		}
+
+	private:
+		struct Entry {
+			uint64_t key;
+			VALUE value;
+		};
+
+		// non-negative doubles are ordered like their bit patterns
+		static uint64_t to_bits(double key) {
+			DCHECK_GE(key, 0);
+			key += 0.0; // no -0
+			uint64_t r;
+			std::memcpy(&r, &key, sizeof(r));
+			return r;
+		}
+
+		static double from_bits(uint64_t bits) {
+			double r;
+			std::memcpy(&r, &bits, sizeof(r));
+			return r;
+		}
+
+		// 0 if equal to `last`, else 1 + index of the highest bit that differs
+		int get_bucket(uint64_t bits) const {
+			uint64_t x = bits ^ last;
+			int r = 0;
+			for(int shift=32; shift>0; shift/=2) {
+				if(x >> shift) {
+					x >>= shift;
+					r += shift;
+				}
+			}
+			return r + int(x);
+		}
+
+		std::vector<Entry> buckets[65];
+		std::vector<Entry> scratch;
+		uint64_t last = 0;
+		int64_t size = 0;
+	};
+
+
+
+	//
+	// compact copy of the mesh for distance queries: positions, triangles and corners of each vert
+	// (flattened vert-poly links), by compact vert index. shared by all queries of a batch
+	//
+	struct Geodesic_Mesh {
+		using Vec = Eigen::Vector3d;
+
+		std::vector<int> vert_keys;  // compact index -> vert key
+		std::vector<int> vert_index; // vert key -> compact index, -1 for erased verts
+		std::vector<Vec> positions;
+		std::vector<int> tris;       // 3 compact indices per poly
+		std::vector<int> corner_begins;
+		std::vector<int> corners;    // poly * 3 + i
+
+		int num_verts() const { return (int)vert_keys.size(); }
+		int num_tris() const { return (int)tris.size() / 3; }
+
+		template<class MESH>
+		explicit Geodesic_Mesh(const MESH& mesh) {
+			static_assert(MESH::POLY_SIZE == 3, "geodesics require triangles");
+
+			vert_index.assign(mesh.verts.domain_end(), -1);
+			vert_keys.reserve(mesh.verts.domain_end());
+			for(auto v : mesh.verts) {
+				vert_index[v.key] = (int)vert_keys.size();
+				vert_keys.push_back(v.key);
+			}
+
+			const auto decoded = decode_positions<double>(mesh);
+			positions.resize(vert_keys.size());
+			smesh::parallel_for(0, num_verts(), 16384, [&](int i) { positions[i] = decoded[vert_keys[i]]; });
+
+			tris.reserve(size_t(mesh.polys.domain_end()) * 3);
+			for(auto p : mesh.polys) {
+				for(int i=0; i<3; ++i) tris.push_back( vert_index[ (int)mesh.polys.raw(p.key).verts[i].key ] );
+			}
+
+			// corners of each vert (counting sort)
+			corner_begins.assign(num_verts() + 1, 0);
+			for(int v : tris) ++corner_begins[v + 1];
+			std::partial_sum(corner_begins.begin(), corner_begins.end(), corner_begins.begin());
+
+			corners.resize(tris.size());
+			auto ends = corner_begins;
+			for(int c=0; c<(int)tris.size(); ++c) corners[ ends[tris[c]]++ ] = c;
+		}
+
+		double get_length(int a, int b) const { return (positions[a] - positions[b]).norm(); }
+	};
+
+
+
+	//
+	// multi-source Dijkstra over edges, up to `max_distance`
+	//
+	inline void geodesic_dijkstra(const Geodesic_Mesh& g, const std::vector<int>& sources, double max_distance,
+			std::vector<double>& dists) {
+
+		dists.assign(g.num_verts(), std::numeric_limits<double>::infinity());
+
+		Radix_Heap<int> heap;
+		for(int s : sources) {
+			dists[s] = 0;
+			heap.push(0, s);
+		}
+
+		while(!heap.empty()) {
+			const auto [d, v] = heap.pop();
+			if(d > dists[v]) continue; // stale
+			if(d > max_distance) break;
+
+			for(int c=g.corner_begins[v]; c<g.corner_begins[v+1]; ++c) {
+				const int tri = g.corners[c] / 3;
+				const int i = g.corners[c] % 3;
+
+				for(int k=1; k<3; ++k) {
+					const int n = g.tris[tri*3 + (i+k) % 3];
+					const double nd = d + g.get_length(v, n);
+					if(nd < dists[n]) {
+						dists[n] = nd;
+						heap.push(nd, n);
+					}
+				}
+			}
+		}
+
+		for(auto& d : dists) if(d > max_distance) d = std::numeric_limits<double>::infinity();
+	}
+
+
+
+	//
+	// distance at `x` from a planar front through `a` and `b` (distances `da`, `db`), or infinity if
+	// the front doesn't reach `x` from inside the triangle
+	//
+	// the distance is linear over the triangle with unit gradient g = X w, where X = [a-x, b-x] and
+	// X^T g = (da - d, db - d). |g| = 1 is a quadratic in d
+	//
+	inline double get_fast_marching_update(const Eigen::Vector3d& x, const Eigen::Vector3d& a, const Eigen::Vector3d& b,
+			double da, double db) {
+
+		const Eigen::Vector3d ea = a - x;
+		const Eigen::Vector3d eb = b - x;
+
+		Eigen::Matrix2d gram;
+		gram << ea.dot(ea), ea.dot(eb), ea.dot(eb), eb.dot(eb);
+
+		const double det = gram.determinant();
+		if(!(det > 0)) return std::numeric_limits<double>::infinity();
+
+		const Eigen::Matrix2d q = gram.inverse();
+		const Eigen::Vector2d t(da, db);
+		const Eigen::Vector2d ones(1, 1);
+
+		const double q1 = ones.dot(q * ones);
+		const double qt = ones.dot(q * t);
+		const double tqt = t.dot(q * t);
+
+		const double discriminant = qt * qt - q1 * (tqt - 1);
+		if(discriminant < 0) return std::numeric_limits<double>::infinity();
+
+		const double d = (qt + std::sqrt(discriminant)) / q1;
+
+		// upwind: -g points into the triangle
+		const Eigen::Vector2d w = q * (t - ones * d);
+		if(w[0] > 0 || w[1] > 0) return std::numeric_limits<double>::infinity();
+
+		return d;
+	}
+
+
+
+	//
+	// multi-source fast marching over triangles (Kimmel & Sethian 1998, without unfolding of obtuse
+	// triangles: edge updates are used where the triangle update doesn't apply)
+	//
+	inline void geodesic_fast_marching(const Geodesic_Mesh& g, const std::vector<int>& sources, double max_distance,
+			std::vector<double>& dists) {
+
+		dists.assign(g.num_verts(), std::numeric_limits<double>::infinity());
+		std::vector<uint8_t> accepted(g.num_verts(), 0);
+
+		Radix_Heap<int> heap;
+		for(int s : sources) {
+			dists[s] = 0;
+			heap.push(0, s);
+		}
+
+		while(!heap.empty()) {
+			const int v = heap.pop().second;
+			if(accepted[v]) continue;
+			accepted[v] = 1;
+
+			const double d = dists[v];
+			if(d > max_distance) break;
+
+			for(int c=g.corner_begins[v]; c<g.corner_begins[v+1]; ++c) {
+				const int tri = g.corners[c] / 3;
+				const int i = g.corners[c] % 3;
+				const int b = g.tris[tri*3 + (i+1) % 3];
+				const int e = g.tris[tri*3 + (i+2) % 3];
+
+				for(auto [x, y] : {std::pair(b, e), std::pair(e, b)}) {
+					if(accepted[x]) continue;
+
+					double nd = d + g.get_length(v, x);
+					if(accepted[y]) {
+						nd = std::min(nd, get_fast_marching_update(g.positions[x], g.positions[v], g.positions[y], d, dists[y]));
+					}
+
+					if(nd < dists[x]) {
+						dists[x] = nd;
+						heap.push(nd, x);
+					}
+				}
+			}
+		}
+
+		for(int v=0; v<g.num_verts(); ++v) {
+			if(!accepted[v] || dists[v] > max_distance) dists[v] = std::numeric_limits<double>::infinity();
+		}
+	}
+
+
+
+	//
+	// heat method: factors (M - t Lc) and Lc once, then each query is two back-substitutions
+	//
+	// Lc is the cotangent Laplacian ((Lc u)_i = 1/2 sum (cot a + cot b) (u_j - u_i)), M the lumped mass
+	// and t the squared mean edge length. Neumann boundary conditions on open edges
+	//
+	class Geodesic_Heat_Solver {
+	public:
+		using Sparse = Eigen::SparseMatrix<double>;
+
+		explicit Geodesic_Heat_Solver(const Geodesic_Mesh& mesh) : g(mesh) {
+			SMESH_SCOPED_TIMER("Geodesic_Heat_Solver");
+
+			const int n = g.num_verts();
+
+			std::vector<Eigen::Triplet<double>> laplacian;
+			std::vector<double> mass(n, 0);
+			laplacian.reserve(size_t(g.num_tris()) * 12);
+
+			double length_sum = 0;
+			int64_t num_lengths = 0;
+
+			cotangents.resize(g.tris.size());
+			for(int tri=0; tri<g.num_tris(); ++tri) {
+				const double double_area = get_double_area(tri);
+				for(int k=0; k<3; ++k) {
+					const int i = g.tris[tri*3 + (k+1) % 3];
+					const int j = g.tris[tri*3 + (k+2) % 3];
+					length_sum += g.get_length(i, j);
+					++num_lengths;
+
+					// angle at corner k, opposite to edge (i,j)
+					const Eigen::Vector3d& pk = g.positions[ g.tris[tri*3 + k] ];
+					const double cot = double_area > 0 ? (g.positions[i] - pk).dot(g.positions[j] - pk) / double_area : 0;
+					cotangents[tri*3 + k] = cot;
+
+					const double w = cot / 2;
+					laplacian.emplace_back(i, j, w);
+					laplacian.emplace_back(j, i, w);
+					laplacian.emplace_back(i, i, -w);
+					laplacian.emplace_back(j, j, -w);
+
+					mass[ g.tris[tri*3 + k] ] += double_area / 6;
+				}
+			}
+
+			const double h = num_lengths ? length_sum / num_lengths : 1;
+			const double t = h * h;
+
+			Sparse lc(n, n);
+			lc.setFromTriplets(laplacian.begin(), laplacian.end());
+			laplacian = decltype(laplacian)();
+
+			Sparse m(n, n);
+			{
+				std::vector<Eigen::Triplet<double>> diagonal;
+				diagonal.reserve(n);
+				for(int i=0; i<n; ++i) diagonal.emplace_back(i, i, mass[i]);
+				m.setFromTriplets(diagonal.begin(), diagonal.end());
+			}
+
+			heat.compute(Sparse(m - t * lc));
+			CHECK(heat.info() == Eigen::Success) << "Geodesic_Heat_Solver: heat factorization failed";
+
+			// -Lc is only semi-definite (constants): regularize a little, constants are removed per query
+			const double total_mass = std::accumulate(mass.begin(), mass.end(), 0.0);
+			const double epsilon = total_mass > 0 ? 1e-12 * std::abs(lc.diagonal().sum()) / total_mass : 0;
+			poisson.compute(Sparse(epsilon * m - lc));
+			CHECK(poisson.info() == Eigen::Success) << "Geodesic_Heat_Solver: Poisson factorization failed";
+		}
+
+		// thread-safe
+		void solve(const std::vector<int>& sources, double max_distance, std::vector<double>& dists) const {
+			const int n = g.num_verts();
+
+			Eigen::VectorXd delta = Eigen::VectorXd::Zero(n);
+			for(int s : sources) delta[s] = 1;
+			const Eigen::VectorXd u = heat.solve(delta);
+
+			// divergence of the normalized gradient field, X = -grad u / |grad u|
+			Eigen::VectorXd divergence = Eigen::VectorXd::Zero(n);
+			for(int tri=0; tri<g.num_tris(); ++tri) {
+				const int* v = &g.tris[tri*3];
+				const Eigen::Vector3d normal = get_normal(tri);
+				const double double_area = normal.norm();
+				if(double_area == 0) continue;
+
+				Eigen::Vector3d grad = Eigen::Vector3d::Zero();
+				for(int k=0; k<3; ++k) {
+					const Eigen::Vector3d e = g.positions[v[(k+2) % 3]] - g.positions[v[(k+1) % 3]];
+					grad += u[v[k]] * (normal / double_area).cross(e);
+				}
+				if(grad.squaredNorm() == 0) continue;
+				const Eigen::Vector3d x = -grad.normalized();
+
+				for(int k=0; k<3; ++k) {
+					const Eigen::Vector3d& pi = g.positions[v[k]];
+					const Eigen::Vector3d eij = g.positions[v[(k+1) % 3]] - pi;
+					const Eigen::Vector3d eik = g.positions[v[(k+2) % 3]] - pi;
+					divergence[v[k]] += (cotangents[tri*3 + (k+2) % 3] * eij.dot(x) + cotangents[tri*3 + (k+1) % 3] * eik.dot(x)) / 2;
+				}
+			}
+
+			const Eigen::VectorXd phi = poisson.solve(-divergence);
+
+			double offset = std::numeric_limits<double>::infinity();
+			for(int s : sources) offset = std::min(offset, phi[s]);
+
+			dists.resize(n);
+			for(int i=0; i<n; ++i) {
+				dists[i] = std::max(0.0, phi[i] - offset);
+				if(dists[i] > max_distance) dists[i] = std::numeric_limits<double>::infinity();
+			}
+			for(int s : sources) dists[s] = 0;
+		}
+
+	private:
+		Eigen::Vector3d get_normal(int tri) const {
+			const Eigen::Vector3d& a = g.positions[ g.tris[tri*3] ];
+			return (g.positions[ g.tris[tri*3 + 1] ] - a).cross(g.positions[ g.tris[tri*3 + 2] ] - a);
+		}
+
+		double get_double_area(int tri) const { return get_normal(tri).norm(); }
+
+		const Geodesic_Mesh& g;
+		std::vector<double> cotangents; // per corner
+		Eigen::SimplicialLDLT<Sparse> heat;
+		Eigen::SimplicialLDLT<Sparse> poisson;
+	};
+
+}
+
+
+
+
+
+//
+// geodesic distances from each of the `source_sets` (vert keys): one distance field per set,
+// distance to the nearest source of the set
+//
+// - queries are computed in parallel (one per thread, see set_num_threads), sharing one compact copy
+//   of the mesh, and for HEAT one factorization
+// - DIJKSTRA and FAST_MARCHING stop at `max_distance`, HEAT computes the whole field
+// - distances are by vert key, infinity for verts farther than `max_distance`, unreachable (except
+//   for HEAT, which expects sources in each connected component) or erased
+//
+//   auto fields = compute_geodesic_distances_batch(mesh, std::vector<std::vector<int>>{{0}, {5, 7}});
+//
+template<class MESH, class SOURCE_SETS>
+auto compute_geodesic_distances_batch(const MESH& mesh, const SOURCE_SETS& source_sets,
+		Geodesic_Method method = Geodesic_Method::FAST_MARCHING,
+		typename MESH::Scalar max_distance = std::numeric_limits<typename MESH::Scalar>::infinity()) {
+
+	static_assert(MESH::POLY_SIZE == 3, "compute_geodesic_distances requires triangles");
+	SMESH_SCOPED_TIMER("compute_geodesic_distances");
+
+	using Scalar = typename MESH::Scalar;
+
+	const smesh::internal::Geodesic_Mesh g(mesh);
+
+	std::unique_ptr<smesh::internal::Geodesic_Heat_Solver> heat;
+	if(method == Geodesic_Method::HEAT) heat = std::make_unique<smesh::internal::Geodesic_Heat_Solver>(g);
+
+	const int num_queries = (int)source_sets.size();
+	std::vector<std::vector<Scalar>> r(num_queries);
+
+	smesh::parallel_for(0, num_queries, 1, [&](int query) {
+		std::vector<int> sources;
+		for(int key : source_sets[query]) {
+			CHECK(key >= 0 && key < (int)g.vert_index.size() && g.vert_index[key] != -1)
+				<< "compute_geodesic_distances: bad source vert " << key;
+			sources.push_back(g.vert_index[key]);
+		}
+
+		std::vector<double> dists;
+		if(method == Geodesic_Method::DIJKSTRA) smesh::internal::geodesic_dijkstra(g, sources, max_distance, dists);
+		else if(method == Geodesic_Method::FAST_MARCHING) smesh::internal::geodesic_fast_marching(g, sources, max_distance, dists);
+		else heat->solve(sources, max_distance, dists);
+
+		r[query].assign(mesh.verts.domain_end(), std::numeric_limits<Scalar>::infinity());
+		for(int i=0; i<g.num_verts(); ++i) r[query][ g.vert_keys[i] ] = Scalar(dists[i]);
+	});
+
+	return r;
+}
+
+
+
+//
+// geodesic distances from the nearest of `sources` (vert keys), see compute_geodesic_distances_batch
+//
+//   auto dists = compute_geodesic_distances(mesh, std::vector<int>{0}, Geodesic_Method::HEAT);
+//
+template<class MESH, class SOURCES>
+auto compute_geodesic_distances(const MESH& mesh, const SOURCES& sources,
+		Geodesic_Method method = Geodesic_Method::FAST_MARCHING,
+		typename MESH::Scalar max_distance = std::numeric_limits<typename MESH::Scalar>::infinity()) {
+
+	const std::vector<std::vector<int>> source_sets = { std::vector<int>(std::begin(sources), std::end(sources)) };
+	return std::move( compute_geodesic_distances_batch(mesh, source_sets, method, max_distance)[0] );
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <glog/logging.h>
+
+#include <vector>
+#include <functional>
+#include <memory>
+
+
+
+namespace smesh {
+
+
+
+
+
+
+
+
+
+//
+// binary heap of ids in [0, capacity), with keys that can be changed or removed by id
+//
+// - like std::priority_queue, the default COMPARE gives a max-heap
+// - O(log n) push, pop, update and erase; O(1) top and contains
+//
+template<class KEY, class COMPARE = std::less<KEY>, class ALLOCATOR = std::allocator<char>>
+class Indexed_Heap {
+public:
+	using Key = KEY;
+
+	explicit Indexed_Heap(int capacity = 0) {
+		reserve(capacity);
+	}
+
+	void reserve(int capacity) {
+		if(capacity > (int)where.size()) {
+			where.resize(capacity, -1);
+			keys.resize(capacity);
+		}
+		heap.reserve(capacity);
+	}
+
+	int size() const { return (int)heap.size(); }
+	bool empty() const { return heap.empty(); }
+
+	bool contains(int id) const {
+		return id < (int)where.size() && where[id] != -1;
+	}
+
+	int top() const {
+		DCHECK(!empty()) << "Indexed_Heap::top(): heap is empty";
+		return heap[0];
+	}
+
+	const Key& top_key() const {
+		return keys[top()];
+	}
+
+	const Key& key(int id) const {
+		DCHECK(contains(id)) << "Indexed_Heap::key(): id " << id << " not in heap";
+		return keys[id];
+	}
+
+	void push(int id, const Key& k) {
+		DCHECK(!contains(id)) << "Indexed_Heap::push(): id " << id << " already in heap";
+		if(id >= (int)where.size()) reserve(std::max(id+1, 2*(int)where.size()));
+
+		keys[id] = k;
+		where[id] = (int)heap.size();
+		heap.push_back(id);
+		sift_up(where[id]);
+	}
+
+	void pop() {
+		erase(top());
+	}
+
+	void erase(int id) {
+		DCHECK(contains(id)) << "Indexed_Heap::erase(): id " << id << " not in heap";
+
+		int i = where[id];
+		where[id] = -1;
+
+		int last = heap.back();
+		heap.pop_back();
+		if(last == id) return;
+
+		heap[i] = last;
+		where[last] = i;
+		sift_up(i);
+		sift_down(where[last]);
+	}
+
+	void update(int id, const Key& k) {
+		DCHECK(contains(id)) << "Indexed_Heap::update(): id " << id << " not in heap";
+
+		keys[id] = k;
+		sift_up(where[id]);
+		sift_down(where[id]);
+	}
+
+	void clear() {
+		for(auto id : heap) where[id] = -1;
+		heap.clear();
+	}
+
+private:
+	bool before(int a, int b) const {
+		return compare(keys[b], keys[a]);
+	}
+
+	void sift_up(int i) {
+		int id = heap[i];
+		while(i > 0) {
+			int parent = (i-1) / 2;
+			if(!before(id, heap[parent])) break;
+			heap[i] = heap[parent];
+			where[heap[i]] = i;
+			i = parent;
+		}
+		heap[i] = id;
+		where[id] = i;
+	}
+
+	void sift_down(int i) {
+		int id = heap[i];
+		const int n = (int)heap.size();
+		for(;;) {
+			int child = 2*i + 1;
+			if(child >= n) break;
+			if(child+1 < n && before(heap[child+1], heap[child])) ++child;
+			if(!before(heap[child], id)) break;
+			heap[i] = heap[child];
+			where[heap[i]] = i;
+			i = child;
+		}
+		heap[i] = id;
+		where[id] = i;
+	}
+
+private:
+	template<class T>
+	using Vector = std::vector<T, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<T>>;
+
+	Vector<int> heap;  // ids
+	Vector<int> where; // id -> position in heap, or -1
+	Vector<Key> keys;  // id -> key
+	COMPARE compare;
+};
+
+
+
+
+} // namespace smesh
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "instrumentation.hpp"
+
+#include <utility>
+#include <vector>
+
+
+
+namespace smesh::internal {
+
+	//
+	// call before merging vert 'b' into 'a' (see merge_verts)
+	//
+	// entries of 'a' and 'b' that meet in a poly containing both verts (i.e. on the same side of
+	// the collapsed edge) are blended into a new entry, and poly-verts of both verts are pointed
+	// to it. entries of 'b' without a pair (other side of a seam that doesn't cross the edge) are
+	// kept as they are
+	//
+	template<class MESH, class CORNERS>
+	void blend_indexed_vert_props(MESH& mesh, int a_key, const CORNERS& a_corners, const CORNERS& b_corners,
+			const typename MESH::Scalar& alpha) {
+
+		// old entry -> new entry (usually 1 or 2 pairs)
+		std::vector<std::pair<int,int>, typename MESH::template Allocator<std::pair<int,int>>> remap;
+		auto find = [&remap](int key) {
+			for(const auto& r : remap) if(r.first == key) return r.second;
+			return -1;
+		};
+
+		for(const auto& h : b_corners) {
+			const auto& poly = mesh.polys.raw(h.poly);
+			const int jb = poly.verts[h.vert].indexed_props_key;
+			if(jb == -1 || find(jb) != -1) continue;
+
+			for(int i=1; i<MESH::POLY_SIZE; ++i) {
+				const auto& pv = poly.verts[(h.vert + i) % MESH::POLY_SIZE];
+				if(pv.key != a_key) continue;
+
+				const int ia = pv.indexed_props_key;
+				if(ia == -1 || find(ia) != -1) break;
+
+				auto& table = mesh.indexed_vert_props;
+				typename MESH::Indexed_Vert_Props blended = table[ia] * (1-alpha)  +  table[jb] * alpha;
+				const int n = (int)table.size();
+				table.push_back(std::move(blended));
+
+				remap.push_back({ia, n});
+				if(jb != ia) remap.push_back({jb, n});
+				break;
+			}
+		}
+
+		if(remap.empty()) return;
+
+		for(const auto* corners : {&a_corners, &b_corners}) {
+			for(const auto& h : *corners) {
+				auto& key = mesh.polys.raw(h.poly).verts[h.vert].indexed_props_key;
+				const int n = find(key);
+				if(n == -1) continue;
+
+				if constexpr(MESH::Has_Journal) mesh.journal.touch_poly_vert_indexed_props(h);
+				key = n;
+			}
+		}
+	}
+
+}
+
+
+
+
+
+struct Compact_Indexed_Vert_Props_Result {
+	int num_entries_removed = 0;
+};
+
+//
+// remove mesh.indexed_vert_props entries not referenced by any poly-vert, and renumber the rest
+//
+// journal history refers to old entries, so it must be empty (see Journal::clear)
+//
+template<class MESH>
+Compact_Indexed_Vert_Props_Result compact_indexed_vert_props(MESH& mesh) {
+	static_assert(MESH::Has_Indexed_Vert_Props, "compact_indexed_vert_props requires Indexed_Vert_Props");
+	SMESH_SCOPED_TIMER("compact_indexed_vert_props");
+
+	if constexpr(MESH::Has_Journal) {
+		DCHECK(!mesh.journal.can_undo() && !mesh.journal.can_redo())
+			<< "compact_indexed_vert_props: clear journal first";
+	}
+
+	auto& table = mesh.indexed_vert_props;
+
+	std::vector<int, typename MESH::template Allocator<int>> remap(table.size(), -1);
+	for(auto p : mesh.polys) {
+		for(const auto& pv : mesh.polys.raw(p.key).verts) {
+			if(pv.indexed_props_key != -1) remap[pv.indexed_props_key] = 0;
+		}
+	}
+
+	int n = 0;
+	for(int i=0; i<(int)table.size(); ++i) {
+		if(remap[i] == -1) continue;
+		remap[i] = n;
+		if(n != i) table[n] = std::move(table[i]);
+		++n;
+	}
+
+	Compact_Indexed_Vert_Props_Result r;
+	r.num_entries_removed = (int)table.size() - n;
+	table.erase(table.begin() + n, table.end());
+
+	for(auto p : mesh.polys) {
+		for(auto& pv : mesh.polys.raw(p.key).verts) {
+			if(pv.indexed_props_key != -1) pv.indexed_props_key = remap[pv.indexed_props_key];
+		}
+	}
+
+	return r;
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+
+//
+// hot-path instrumentation: scoped timers and counters
+//
+// compiled in only if SMESH_INSTRUMENTATION is defined (cmake: -D SMESH_WITH_INSTRUMENTATION=ON),
+// otherwise SMESH_SCOPED_TIMER and SMESH_COUNT expand to nothing.
+// each thread collects into its own buffers; collect_stats() merges them
+//
+#ifdef SMESH_INSTRUMENTATION
+	#define SMESH_INSTRUMENTATION_CONCAT_(a,b) a##b
+	#define SMESH_INSTRUMENTATION_CONCAT(a,b) SMESH_INSTRUMENTATION_CONCAT_(a,b)
+
+	#define SMESH_SCOPED_TIMER(name) \
+		::smesh::Scoped_Timer SMESH_INSTRUMENTATION_CONCAT(smesh_scoped_timer_, __LINE__)(name)
+
+	#define SMESH_COUNT(counter, n) \
+		::smesh::internal::count(::smesh::Counter::counter, n)
+#else
+	#define SMESH_SCOPED_TIMER(name) ((void)0)
+	#define SMESH_COUNT(counter, n) ((void)0)
+#endif
+
+
+
+namespace smesh {
+
+
+
+
+
+
+
+
+
+enum class Counter {
+	EDGES_COLLAPSED = 0,
+	PASSES,
+	HASH_PROBES,
+	ALLOCATIONS,
+	EDGE_LINKS_CREATED,
+	EDGE_LINKS_REMOVED,
+	VERT_POLY_LINKS_CREATED,
+	VERT_POLY_LINKS_REMOVED,
+	POLYS_CREATED,
+	POLYS_ERASED,
+	VERTS_ERASED,
+
+	NUM_COUNTERS
+};
+
+inline const char* get_counter_name(Counter c) {
+	static const char* names[] = {
+		"edges_collapsed",
+		"passes",
+		"hash_probes",
+		"allocations",
+		"edge_links_created",
+		"edge_links_removed",
+		"vert_poly_links_created",
+		"vert_poly_links_removed",
+		"polys_created",
+		"polys_erased",
+		"verts_erased"
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == (int)Counter::NUM_COUNTERS);
+	return names[(int)c];
+}
+
+
+
+
+struct Timer_Stats {
+	int64_t count = 0;
+	int64_t total_ns = 0;
+};
+
+// one finished scoped timer, for chrome://tracing
+struct Trace_Event {
+	const char* name;
+	int thread;
+	int64_t begin_ns; // since process start
+	int64_t duration_ns;
+};
+
+struct Stats {
+	std::array<uint64_t, (int)Counter::NUM_COUNTERS> counters = {};
+	std::map<std::string, Timer_Stats> timers;
+	std::vector<Trace_Event> events;
+
+	uint64_t operator[](Counter c) const { return counters[(int)c]; }
+};
+
+
+
+
+
+
+
+
+
+namespace internal {
+
+	inline auto instrumentation_epoch() {
+		static const auto epoch = std::chrono::steady_clock::now();
+		return epoch;
+	}
+
+	// written only by the thread owning the slot (see Thread_Stats_Slot); read by collect_stats()
+	struct Thread_Stats {
+		int thread = 0;
+		std::array<std::atomic<uint64_t>, (int)Counter::NUM_COUNTERS> counters = {};
+
+		std::mutex mutex; // for timers and events
+		std::map<const char*, Timer_Stats> timers;
+		std::vector<Trace_Event> events;
+	};
+
+	struct Stats_Registry {
+		std::mutex mutex;
+		std::vector<std::shared_ptr<Thread_Stats>> threads;
+		std::vector<int> free_slots; // of exited threads
+	};
+
+	inline Stats_Registry& get_stats_registry() {
+		static Stats_Registry registry;
+		return registry;
+	}
+
+	// a thread's entry in the registry. on thread exit the entry is handed to the next new thread,
+	// which keeps adding to it, so the registry grows with the number of threads alive at once
+	// (parallel_for starts new threads on every call), and trace `tid`s are reused
+	class Thread_Stats_Slot {
+	public:
+		Thread_Stats_Slot() {
+			auto& registry = get_stats_registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			if(registry.free_slots.empty()) {
+				stats = std::make_shared<Thread_Stats>();
+				stats->thread = (int)registry.threads.size();
+				registry.threads.push_back(stats);
+			}
+			else {
+				stats = registry.threads[ registry.free_slots.back() ];
+				registry.free_slots.pop_back();
+			}
+		}
+
+		~Thread_Stats_Slot() {
+			auto& registry = get_stats_registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.free_slots.push_back(stats->thread);
+		}
+
+		Thread_Stats_Slot(const Thread_Stats_Slot&) = delete;
+		Thread_Stats_Slot& operator=(const Thread_Stats_Slot&) = delete;
+
+		Thread_Stats& get() { return *stats; }
+
+	private:
+		std::shared_ptr<Thread_Stats> stats;
+	};
+
+	inline Thread_Stats& get_thread_stats() {
+		thread_local Thread_Stats_Slot slot;
+		return slot.get();
+	}
+
+	inline void count(Counter c, uint64_t n) {
+		auto& counter = get_thread_stats().counters[(int)c];
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+}
+
+
+
+
+//
+// measures time from construction to destruction
+// `name` has to be a string literal (or otherwise outlive collect_stats)
+//
+class Scoped_Timer {
+public:
+	explicit Scoped_Timer(const char* n) : name(n), begin(std::chrono::steady_clock::now()) {}
+
+	~Scoped_Timer() {
+		using namespace std::chrono;
+		auto end = steady_clock::now();
+		auto duration = duration_cast<nanoseconds>(end - begin).count();
+		auto since_epoch = duration_cast<nanoseconds>(begin - internal::instrumentation_epoch()).count();
+
+		auto& stats = internal::get_thread_stats();
+		std::lock_guard<std::mutex> lock(stats.mutex);
+
+		auto& timer = stats.timers[name];
+		++timer.count;
+		timer.total_ns += duration;
+
+		stats.events.push_back({name, stats.thread, since_epoch, duration});
+	}
+
+	Scoped_Timer(const Scoped_Timer&) = delete;
+	Scoped_Timer& operator=(const Scoped_Timer&) = delete;
+
+private:
+	const char* const name;
+	const std::chrono::steady_clock::time_point begin;
+};
+
+
+
+
+//
+// merge statistics of all threads
+//
+inline Stats collect_stats() {
+	Stats r;
+
+	auto& registry = internal::get_stats_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	for(auto& thread : registry.threads) {
+		for(int i=0; i<(int)Counter::NUM_COUNTERS; ++i) {
+			r.counters[i] += thread->counters[i].load(std::memory_order_relaxed);
+		}
+
+		std::lock_guard<std::mutex> thread_lock(thread->mutex);
+
+		for(auto& [name, timer] : thread->timers) {
+			auto& t = r.timers[name];
+			t.count += timer.count;
+			t.total_ns += timer.total_ns;
+		}
+
+		r.events.insert(r.events.end(), thread->events.begin(), thread->events.end());
+	}
+
+	return r;
+}
+
+
+
+inline void reset_stats() {
+	auto& registry = internal::get_stats_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	for(auto& thread : registry.threads) {
+		for(auto& counter : thread->counters) counter.store(0, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> thread_lock(thread->mutex);
+		thread->timers.clear();
+		thread->events.clear();
+	}
+}
+
+
+
+
+//
+// {"counters": {"name": value, ...}, "timers": {"name": {"count": n, "total_ms": t}, ...}}
+//
+inline void write_stats_json(std::ostream& s, const Stats& stats) {
+	s << "{\"counters\": {";
+	for(int i=0; i<(int)Counter::NUM_COUNTERS; ++i) {
+		if(i) s << ", ";
+		s << "\"" << get_counter_name(Counter(i)) << "\": " << stats.counters[i];
+	}
+	s << "}, \"timers\": {";
+	bool first = true;
+	for(auto& [name, timer] : stats.timers) {
+		if(!first) s << ", ";
+		first = false;
+		s << "\"" << name << "\": {\"count\": " << timer.count << ", \"total_ms\": " << timer.total_ns * 1e-6 << "}";
+	}
+	s << "}}";
+}
+
+
+
+//
+// chrome://tracing (or Perfetto) JSON: one complete event per scoped timer
+//
+inline void write_chrome_trace(std::ostream& s, const Stats& stats) {
+	s << "{\"traceEvents\": [";
+	bool first = true;
+	for(auto& e : stats.events) {
+		if(!first) s << ",";
+		first = false;
+		s << "\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << e.thread <<
+			", \"ts\": " << e.begin_ns * 1e-3 << ", \"dur\": " << e.duration_ns * 1e-3 << "}";
+	}
+	s << "\n]}";
+}
+
+
+
+
+} // namespace smesh
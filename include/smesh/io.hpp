@@ -4,10 +4,14 @@
 
 
 
+#include "instrumentation.hpp"
+
 #include <tinyply.h>
 
 #include <fstream>
 #include <chrono>
+#include <cstring>
+#include <unordered_map>
 
 namespace smesh {
 
@@ -25,11 +29,19 @@ namespace smesh {
 
 
 
+
+
+
+
 //
-// todo: save texcoords, normals and all other props that mesh contains
+// saves live verts (compacted) and polys, with per-poly-vert texcoords if the mesh has them
+// (as `texcoords` of Indexed_Vert_Props or Poly_Vert_Props)
+//
+// todo: save normals and all other props that mesh contains
 //
 template<class MESH, class FILE_NAME>
 inline void save_ply(const MESH& mesh, FILE_NAME&& filename, bool binary = true) {
+	SMESH_SCOPED_TIMER("save_ply");
 
 	// Tinyply does not perform any file i/o internally
 	std::filebuf fb;
@@ -38,38 +50,57 @@ inline void save_ply(const MESH& mesh, FILE_NAME&& filename, bool binary = true)
 
 	::tinyply::PlyFile myFile;
 
+	std::vector<int32_t> remap(mesh.verts.domain_end(), -1);
+
 	std::vector<float> verts;
-	verts.reserve(mesh.verts.size_including_deleted() * 3);
-	for(auto& v : mesh.verts) {
-		verts.push_back(v.pos[0]);
-		verts.push_back(v.pos[1]);
-		verts.push_back(v.pos[2]);
+	verts.reserve(mesh.verts.domain_end() * 3);
+	for(auto v : mesh.verts) {
+		remap[v.key] = (int)verts.size() / 3;
+		typename MESH::Pos pos = v.pos();
+		verts.push_back(pos[0]);
+		verts.push_back(pos[1]);
+		verts.push_back(pos[2]);
 	}
 
+	constexpr bool has_indexed_texcoords = MESH::Has_Indexed_Vert_Props &&
+		has_member_texcoords<typename MESH::Indexed_Vert_Props>::value;
+
+	constexpr bool has_texcoords = has_indexed_texcoords ||
+		has_member_texcoords<typename MESH::Poly_Vert_Props>::value;
 
 	std::vector<int32_t> vertexIndicies;
-	vertexIndicies.reserve(mesh.polys.size_including_deleted() * 3);
-	for(auto& p : mesh.polys) {
-		vertexIndicies.push_back(p.verts[0].vert.idx);
-		vertexIndicies.push_back(p.verts[1].vert.idx);
-		vertexIndicies.push_back(p.verts[2].vert.idx);
+	std::vector<float> faceTexcoords;
+	vertexIndicies.reserve(mesh.polys.domain_end() * 3);
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			vertexIndicies.push_back(remap[pv.key]);
+
+			if constexpr(has_indexed_texcoords) {
+				if(pv.indexed_props_key() == -1) {
+					faceTexcoords.push_back(0);
+					faceTexcoords.push_back(0);
+				}
+				else {
+					faceTexcoords.push_back(pv.indexed_props().texcoords[0]);
+					faceTexcoords.push_back(pv.indexed_props().texcoords[1]);
+				}
+			}
+			else if constexpr(has_texcoords) {
+				faceTexcoords.push_back(pv.props().texcoords[0]);
+				faceTexcoords.push_back(pv.props().texcoords[1]);
+			}
+		}
 	}
 
-	//std::vector<float> faceTexcoords;
-	//for(auto& p : mesh.polys) {
-	//	for(int i=0; i<3; ++i) {
-	//		for(int j=0; j<2; ++j) {
-	//			faceTexcoords.push_back(p.texcoords[i][j]);
-	//		}
-	//	}
-	//}
-
 	//myFile.comments.push_back("TextureFile " + texture_path);
 
 	myFile.add_properties_to_element("vertex", { "x", "y", "z" }, verts);
 
 	myFile.add_properties_to_element("face", { "vertex_indices" }, vertexIndicies, 3, ::tinyply::PlyProperty::Type::UINT8);
-	//myFile.add_properties_to_element("face", { "texcoord" }, faceTexcoords, 6, tinyply::PlyProperty::Type::UINT8);
+
+	if constexpr(has_texcoords) {
+		myFile.add_properties_to_element("face", { "texcoord" }, faceTexcoords, 6, ::tinyply::PlyProperty::Type::UINT8);
+	}
 
 	myFile.write(outputStream, binary);
 
@@ -78,13 +109,11 @@ inline void save_ply(const MESH& mesh, FILE_NAME&& filename, bool binary = true)
 
 
 
-GENERATE_HAS_MEMBER(normal);
-GENERATE_HAS_MEMBER(color);
-GENERATE_HAS_MEMBER(texcoords);
 
 
 template<class MESH, class FILE_NAME>
 MESH load_ply(FILE_NAME&& file_name) {
+	SMESH_SCOPED_TIMER("load_ply");
 	
 	using namespace ::tinyply;
 	using namespace std;
@@ -158,28 +187,62 @@ MESH load_ply(FILE_NAME&& file_name) {
 	//
 	
 	MESH mesh;
+
+	// quantization grid over loaded positions
+	if constexpr(MESH::Has_Quantized_Pos) if(verts_count) {
+		typename MESH::Pos min(verts[0], verts[1], verts[2]);
+		typename MESH::Pos max = min;
+		for(int i=0; i<(int)verts_count; ++i) {
+			typename MESH::Pos pos(verts[i*3 + 0], verts[i*3 + 1], verts[i*3 + 2]);
+			min = min.cwiseMin(pos);
+			max = max.cwiseMax(pos);
+		}
+		mesh.verts.pos_codec.set_bounds(min, max);
+	}
 	
-	mesh.verts.reserve(verts_count);
+	const int first_vert = mesh.verts.add_range(verts.data(), verts_count);
 	for(int i=0; i<(int)verts_count; ++i){
-		mesh.verts.add(verts[i*3 + 0], verts[i*3 + 1], verts[i*3 + 2]);
-
 		if constexpr(has_member_normal<typename MESH::Vert_Props>::value) if(v_normals_count) {
-			mesh.verts.back().props.normal = { v_normals[i*3 + 0], v_normals[i*3 + 1], v_normals[i*3 + 2] };
+			mesh.verts[first_vert + i].props.normal = { v_normals[i*3 + 0], v_normals[i*3 + 1], v_normals[i*3 + 2] };
 		}
 
 		if constexpr(has_member_color<typename MESH::Vert_Props>::value) if(v_colors_count) {
-			mesh.verts.back().props.color = { v_colors[i*4 + 0], v_colors[i*4 + 1], v_colors[i*4 + 2], v_colors[i*4 + 3] };
+			mesh.verts[first_vert + i].props.color = { v_colors[i*4 + 0], v_colors[i*4 + 1], v_colors[i*4 + 2], v_colors[i*4 + 3] };
 		}
 	}
 	
-	mesh.polys.reserve(polys_count);
+	// indexed texcoords: one entry per distinct (vertex, texcoord) pair
+	using Texcoord_Key = std::pair<uint32_t, uint64_t>;
+	auto hash_texcoord_key = [](const Texcoord_Key& k) { return std::hash<uint64_t>()(k.second * 0x9e3779b97f4a7c15ULL + k.first); };
+	std::unordered_map<Texcoord_Key, int, decltype(hash_texcoord_key)> texcoord_entries(0, hash_texcoord_key);
+
+	const int first_poly = mesh.polys.add_range(polys.data(), polys_count);
 	for(int i=0; i<(int)polys_count; ++i){
-		mesh.polys.add(polys[i*3 + 0], polys[i*3 + 1], polys[i*3 + 2]);
+
+		if constexpr(MESH::Has_Indexed_Vert_Props) if(p_texcoords_count) {
+			if constexpr(has_member_texcoords<typename MESH::Indexed_Vert_Props>::value) {
+				auto& table = mesh.indexed_vert_props;
+				for(int j=0; j<3; ++j) {
+					const float u = p_texcoords[i*6 + j*2 + 0];
+					const float v = p_texcoords[i*6 + j*2 + 1];
+					uint32_t u_bits, v_bits;
+					std::memcpy(&u_bits, &u, 4);
+					std::memcpy(&v_bits, &v, 4);
+
+					auto [it, inserted] = texcoord_entries.try_emplace({polys[i*3 + j], uint64_t(u_bits) << 32 | v_bits}, (int)table.size());
+					if(inserted) {
+						table.emplace_back();
+						table.back().texcoords = {u, v};
+					}
+					mesh.polys[first_poly + i].verts[j].indexed_props_key() = it->second;
+				}
+			}
+		}
 
 		if constexpr(has_member_texcoords<typename MESH::Poly_Vert_Props>::value) if(p_texcoords_count) {
-			mesh.polys.back().verts[0].props.texcoords = { p_texcoords[i*6 + 0], p_texcoords[i*6 + 1] };
-			mesh.polys.back().verts[1].props.texcoords = { p_texcoords[i*6 + 2], p_texcoords[i*6 + 3] };
-			mesh.polys.back().verts[2].props.texcoords = { p_texcoords[i*6 + 4], p_texcoords[i*6 + 5] };
+			mesh.polys[first_poly + i].verts[0].props.texcoords = { p_texcoords[i*6 + 0], p_texcoords[i*6 + 1] };
+			mesh.polys[first_poly + i].verts[1].props.texcoords = { p_texcoords[i*6 + 2], p_texcoords[i*6 + 3] };
+			mesh.polys[first_poly + i].verts[2].props.texcoords = { p_texcoords[i*6 + 4], p_texcoords[i*6 + 5] };
 		}
 	}
 	
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <glog/logging.h>
+
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+
+//
+// runtime attribute layers: named, typed, dense arrays indexed by vert/poly key (or by
+// poly_key * POLY_SIZE + vert_idx for poly-vert layers), owned by the mesh storages
+//
+//   auto& weights = mesh.verts.layers.add<int>("weights", 1);
+//   weights[v.key] += 1;
+//   mesh.verts.layers.remove("weights"); // buffer is kept for reuse
+//
+
+namespace smesh::internal {
+
+	class Layer_Base {
+	public:
+		virtual ~Layer_Base() {}
+
+		virtual std::type_index get_type() const = 0;
+		virtual std::unique_ptr<Layer_Base> clone() const = 0;
+
+		virtual void resize(int size) = 0;
+		virtual void reset(int size) = 0;
+		virtual void remap(const int* old_to_new, int old_size, int new_size) = 0;
+	};
+
+
+
+	template<class T, class ALLOCATOR>
+	class Layer : public Layer_Base {
+	public:
+		static_assert(!std::is_same_v<T, bool>, "Layer<bool> would be a packed std::vector<bool>, use uint8_t");
+
+		using Value = T;
+
+		T& operator[](int i) {
+			DCHECK_GE(i, 0) << "Layer: index out of range";
+			DCHECK_LT(i, (int)data.size()) << "Layer: index out of range";
+			return data[i];
+		}
+
+		const T& operator[](int i) const {
+			DCHECK_GE(i, 0) << "Layer: index out of range";
+			DCHECK_LT(i, (int)data.size()) << "Layer: index out of range";
+			return data[i];
+		}
+
+		int size() const { return (int)data.size(); }
+
+		T* begin() { return data.data(); }
+		T* end() { return data.data() + data.size(); }
+		const T* begin() const { return data.data(); }
+		const T* end() const { return data.data() + data.size(); }
+
+		// value of new elements (set by Layers::add)
+		T default_value = T();
+
+		std::type_index get_type() const override { return typeid(T); }
+		std::unique_ptr<Layer_Base> clone() const override { return std::make_unique<Layer>(*this); }
+
+		void resize(int n) override { data.resize(n, default_value); }
+
+		// keeps capacity
+		void reset(int n) override {
+			data.clear();
+			data.resize(n, default_value);
+		}
+
+		// element i moves to old_to_new[i] (or is dropped if -1)
+		void remap(const int* old_to_new, int old_size, int new_size) override {
+			std::vector<T, ALLOCATOR> new_data(new_size, default_value, data.get_allocator());
+			for(int i=0; i<old_size && i<(int)data.size(); ++i) {
+				if(old_to_new[i] != -1) new_data[ old_to_new[i] ] = std::move(data[i]);
+			}
+			data.swap(new_data);
+		}
+
+	private:
+		std::vector<T, ALLOCATOR> data;
+	};
+
+
+
+	template<class LAYERS, class T>
+	class Scoped_Layer;
+
+
+
+	//
+	// layers of one storage (verts, polys or poly-verts)
+	//
+	template<class ALLOCATOR>
+	class Layers {
+	public:
+		template<class T>
+		using Layer = internal::Layer<T, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<T>>;
+
+		explicit Layers(int num_elements_per_key) : elements_per_key(num_elements_per_key) {}
+
+		Layers(const Layers& o) : elements_per_key(o.elements_per_key), domain_end(o.domain_end) {
+			for(const auto& [name, layer] : o.layers) layers.emplace(name, layer->clone());
+		}
+
+		Layers(Layers&&) = default;
+
+		Layers& operator=(const Layers& o) {
+			if(this != &o) *this = Layers(o);
+			return *this;
+		}
+
+		Layers& operator=(Layers&&) = default;
+
+
+
+		// attach a layer, sized to the storage domain, filled with `default_value`
+		// (reuses a removed layer's buffer of the same type if there's one)
+		template<class T>
+		Layer<T>& add(const std::string& name, const T& default_value = T()) {
+			DCHECK(!has(name)) << "Layers::add: layer '" << name << "' already exists";
+
+			std::unique_ptr<Layer_Base> layer;
+
+			auto& pooled = pool[typeid(T)];
+			if(pooled.empty()) {
+				layer = std::make_unique<Layer<T>>();
+			}
+			else {
+				layer = std::move(pooled.back());
+				pooled.pop_back();
+			}
+
+			auto& r = static_cast<Layer<T>&>(*layer);
+			r.default_value = default_value;
+			r.reset(domain_end * elements_per_key);
+
+			layers.emplace(name, std::move(layer));
+			return r;
+		}
+
+		// same as `add`, but the layer is removed at the end of scope
+		template<class T>
+		Scoped_Layer<Layers, T> add_scoped(const std::string& name, const T& default_value = T()) {
+			return Scoped_Layer<Layers, T>(*this, name, default_value);
+		}
+
+		bool has(const std::string& name) const {
+			return layers.find(name) != layers.end();
+		}
+
+		// nullptr if there's no such layer
+		template<class T>
+		Layer<T>* find(const std::string& name) {
+			auto it = layers.find(name);
+			if(it == layers.end()) return nullptr;
+			DCHECK(it->second->get_type() == typeid(T)) << "Layers::find: layer '" << name << "' has different type";
+			return static_cast<Layer<T>*>(it->second.get());
+		}
+
+		template<class T>
+		const Layer<T>* find(const std::string& name) const {
+			return const_cast<Layers&>(*this).template find<T>(name);
+		}
+
+		template<class T>
+		Layer<T>& get(const std::string& name) {
+			auto r = find<T>(name);
+			CHECK(r) << "Layers::get: no layer '" << name << "'";
+			return *r;
+		}
+
+		template<class T>
+		const Layer<T>& get(const std::string& name) const {
+			return const_cast<Layers&>(*this).template get<T>(name);
+		}
+
+		// detach layer, keeping its buffer for reuse by `add`
+		void remove(const std::string& name) {
+			auto it = layers.find(name);
+			DCHECK(it != layers.end()) << "Layers::remove: no layer '" << name << "'";
+			if(it == layers.end()) return;
+
+			pool[it->second->get_type()].push_back(std::move(it->second));
+			layers.erase(it);
+		}
+
+		// free buffers of removed layers
+		void clear_pool() {
+			pool.clear();
+		}
+
+		int get_num_layers() const { return (int)layers.size(); }
+
+
+
+	public:
+		// called by the storage
+
+		void on_add(int new_domain_end) {
+			domain_end = new_domain_end;
+			for(auto& [name, layer] : layers) layer->resize(domain_end * elements_per_key);
+		}
+
+		// element with key i moves to key old_to_new[i] (or is dropped if -1)
+		void remap(const int* old_to_new, int old_domain_end, int new_domain_end) {
+			const int n = elements_per_key;
+
+			std::vector<int, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<int>> expanded;
+			if(n > 1) {
+				expanded.resize(old_domain_end * n);
+				for(int i=0; i<old_domain_end; ++i) {
+					for(int j=0; j<n; ++j) expanded[i*n + j] = old_to_new[i] == -1 ? -1 : old_to_new[i]*n + j;
+				}
+				old_to_new = expanded.data();
+			}
+
+			domain_end = new_domain_end;
+			for(auto& [name, layer] : layers) layer->remap(old_to_new, old_domain_end * n, new_domain_end * n);
+		}
+
+	private:
+		int elements_per_key;
+		int domain_end = 0;
+
+		std::unordered_map<std::string, std::unique_ptr<Layer_Base>> layers;
+		std::unordered_map<std::type_index, std::vector<std::unique_ptr<Layer_Base>>> pool;
+	};
+
+
+
+	//
+	// removes the layer when going out of scope, e.g. for scratch data of an algorithm
+	//
+	template<class LAYERS, class T>
+	class Scoped_Layer {
+	public:
+		template<class... ARGS>
+		Scoped_Layer(LAYERS& l, const std::string& n, ARGS&&... args) :
+			layers(l), name(n), layer(l.template add<T>(n, std::forward<ARGS>(args)...)) {}
+
+		~Scoped_Layer() { layers.remove(name); }
+
+		Scoped_Layer(const Scoped_Layer&) = delete;
+		Scoped_Layer& operator=(const Scoped_Layer&) = delete;
+
+		auto& operator[](int i) { return layer[i]; }
+		const auto& operator[](int i) const { return layer[i]; }
+
+		auto& get() { return layer; }
+
+	private:
+		LAYERS& layers;
+		const std::string name;
+		typename LAYERS::template Layer<T>& layer;
+	};
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "collapse-edges.hpp"
+#include "mesh-utils.hpp"
+#include "vert-poly-links.hpp"
+#include "instrumentation.hpp"
+
+#include <deque>
+#include <vector>
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// decimate a compact copy of 'mesh' progressively: for each of ascending 'max_edge_lengths',
+	// continue fast_collapse_edges from the previous level and call fun(const MESH& level, int level_idx)
+	//
+	template<class MESH, class TARGETS, class FUN>
+	void for_each_lod(MESH& work, const TARGETS& max_edge_lengths, const FUN& fun) {
+		auto weights = work.verts.layers.add_scoped("lod_weights", int32_t(1));
+
+		typename MESH::Scalar prev = 0;
+		int i = 0;
+		for(const auto& max_edge_length : max_edge_lengths) {
+			CHECK_GE(max_edge_length, prev) << "LOD targets must be ascending";
+			prev = max_edge_length;
+
+			fast_collapse_edges(work, max_edge_length, [&weights](auto v) -> auto& { return weights[v]; });
+			clean_flat_surfaces_on_edges(work);
+
+			fun(std::as_const(work), i++);
+		}
+	}
+
+}
+
+
+
+
+
+
+//
+// LOD chain from a single decimation run
+//
+// levels are produced by continuing fast_collapse_edges (with accumulated vertex weights) from
+// the previous level, so the total cost is about one decimation to the coarsest level
+//
+// 'max_edge_lengths' must be ascending. the input mesh needs edge links (and vert-poly links if
+// enabled) computed, like for fast_collapse_edges
+//
+// returns compact meshes, one per target (std::deque, so meshes are never moved)
+//
+template<class MESH, class TARGETS>
+std::deque<MESH> build_lod_chain(const MESH& mesh, const TARGETS& max_edge_lengths) {
+	SMESH_SCOPED_TIMER("build_lod_chain");
+
+	std::deque<MESH> r;
+
+	MESH work;
+	smesh::internal::copy_compact(mesh, work);
+
+	smesh::internal::for_each_lod(work, max_edge_lengths, [&r](const MESH& level, int) {
+		r.emplace_back();
+		smesh::internal::copy_compact(level, r.back());
+	});
+
+	return r;
+}
+
+
+
+
+
+template<class MESH>
+struct Lod_Index_Buffers {
+	// shared vertex buffer: all verts of the input mesh (compacted), not moved by collapses
+	std::vector<typename MESH::Pos> positions;
+
+	// one index buffer per LOD, 3 indices per poly
+	std::vector<std::vector<int32_t>> indices;
+};
+
+//
+// same as build_lod_chain, but levels are emitted as index buffers into one shared vertex buffer
+//
+// collapses merge vertices into surviving ones (see merge_verts), so every level references only
+// input verts - but vertex positions are not blended
+//
+template<class MESH, class TARGETS>
+Lod_Index_Buffers<MESH> build_lod_index_buffers(const MESH& mesh, const TARGETS& max_edge_lengths) {
+	SMESH_SCOPED_TIMER("build_lod_index_buffers");
+
+	Lod_Index_Buffers<MESH> r;
+
+	MESH work;
+	smesh::internal::copy_compact(mesh, work);
+
+	r.positions.resize(work.verts.domain_end());
+	for(auto v : work.verts) {
+		r.positions[v.key] = v.pos();
+	}
+
+	smesh::internal::for_each_lod(work, max_edge_lengths, [&r](const MESH& level, int) {
+		r.indices.emplace_back();
+		auto& indices = r.indices.back();
+
+		for(auto p : level.polys) {
+			for(auto pv : p.verts) {
+				indices.push_back(pv.key);
+			}
+		}
+	});
+
+	return r;
+}
+
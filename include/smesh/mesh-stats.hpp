@@ -0,0 +1,323 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+//
+// integral properties of a mesh or of a group of its polys, see compute_mesh_stats
+//
+template<class SCALAR>
+struct Mesh_Stats {
+	using Pos = Eigen::Matrix<SCALAR,3,1>;
+
+	int num_polys = 0;
+
+	// bounding box of the verts of the polys
+	Pos min = Pos::Zero();
+	Pos max = Pos::Zero();
+
+	SCALAR area = 0;
+
+	// signed volume enclosed by the polys, positive if they face out. only meaningful for closed meshes
+	SCALAR volume = 0;
+
+	// center of mass of the enclosed volume (surface_centroid if volume is 0), and of the surface
+	Pos centroid = Pos::Zero();
+	Pos surface_centroid = Pos::Zero();
+};
+
+
+
+//
+// connected components of polys over edge links, numbered in order of their first poly
+//
+struct Poly_Components {
+	std::vector<int> poly_component; // poly key -> component, -1 for erased polys
+	int num_components = 0;
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// Neumaier summation: error doesn't grow with the number of terms
+	//
+	template<class T>
+	struct Compensated_Sum {
+		T sum = 0;
+		T compensation = 0;
+
+		void add(T x) {
+			const T t = sum + x;
+			if(std::abs(sum) >= std::abs(x)) compensation += (sum - t) + x;
+			else compensation += (x - t) + sum;
+			sum = t;
+		}
+
+		void add(const Compensated_Sum& o) {
+			add(o.sum);
+			add(o.compensation);
+		}
+
+		T get() const { return sum + compensation; }
+	};
+
+
+
+	template<class SCALAR>
+	struct Mesh_Stats_Accumulator {
+		using Pos = Eigen::Matrix<SCALAR,3,1>;
+
+		int num_polys = 0;
+		Pos min = Pos::Constant( std::numeric_limits<SCALAR>::max() );
+		Pos max = Pos::Constant( std::numeric_limits<SCALAR>::lowest() );
+
+		Compensated_Sum<SCALAR> area;
+		Compensated_Sum<SCALAR> volume;
+		Compensated_Sum<SCALAR> area_moment[3];
+		Compensated_Sum<SCALAR> volume_moment[3];
+
+		// triangle relative to the origin of the sweep
+		void add_poly(const Pos& a, const Pos& b, const Pos& c) {
+			++num_polys;
+			min = min.cwiseMin(a).cwiseMin(b).cwiseMin(c);
+			max = max.cwiseMax(a).cwiseMax(b).cwiseMax(c);
+
+			const Pos sum = a + b + c;
+
+			const SCALAR poly_area = (b - a).cross(c - a).norm() / 2;
+			area.add(poly_area);
+
+			// tetrahedron (origin, a, b, c)
+			const SCALAR tet_volume = a.dot( b.cross(c) ) / 6;
+			volume.add(tet_volume);
+
+			for(int j=0; j<3; ++j) {
+				area_moment[j].add(poly_area * sum[j] / 3);
+				volume_moment[j].add(tet_volume * sum[j] / 4);
+			}
+		}
+
+		void add(const Mesh_Stats_Accumulator& o) {
+			num_polys += o.num_polys;
+			min = min.cwiseMin(o.min);
+			max = max.cwiseMax(o.max);
+			area.add(o.area);
+			volume.add(o.volume);
+			for(int j=0; j<3; ++j) {
+				area_moment[j].add(o.area_moment[j]);
+				volume_moment[j].add(o.volume_moment[j]);
+			}
+		}
+
+		Mesh_Stats<SCALAR> get(const Pos& origin) const {
+			Mesh_Stats<SCALAR> r;
+			r.num_polys = num_polys;
+			if(num_polys == 0) return r;
+
+			r.min = min + origin;
+			r.max = max + origin;
+			r.area = area.get();
+			r.volume = volume.get();
+
+			r.surface_centroid = origin;
+			if(r.area > 0) {
+				for(int j=0; j<3; ++j) r.surface_centroid[j] += area_moment[j].get() / r.area;
+			}
+
+			r.centroid = r.surface_centroid;
+			if(r.volume != 0) {
+				for(int j=0; j<3; ++j) r.centroid[j] = origin[j] + volume_moment[j].get() / r.volume;
+			}
+
+			return r;
+		}
+	};
+
+
+
+	//
+	// stats of `polys` grouped by `labels` (polys of a label are contiguous). polys are summed in
+	// chunks of fixed size, then chunks in order, so the result doesn't depend on the number of threads
+	//
+	template<class MESH, class POLYS, class LABELS>
+	auto accumulate_mesh_stats(const MESH& mesh, const POLYS& polys, const LABELS& labels, int num_labels) {
+		using Scalar = typename MESH::Scalar;
+		using Pos = Eigen::Matrix<Scalar,3,1>;
+		using Accumulator = Mesh_Stats_Accumulator<Scalar>;
+		constexpr int N = MESH::POLY_SIZE;
+
+		const auto positions = decode_positions<Scalar>(mesh);
+
+		// positions relative to a vertex of the mesh, for precision far from (0,0,0)
+		Pos origin = Pos::Zero();
+		if(!polys.empty()) origin = positions[ mesh.polys.raw(polys[0]).verts[0].key ];
+
+		constexpr int grain = 16384;
+		const int num_polys = (int)polys.size();
+		const int num_chunks = (num_polys + grain - 1) / grain;
+
+		std::vector<std::vector<std::pair<int, Accumulator>>> partials(num_chunks);
+
+		smesh::parallel_for(0, num_chunks, 1, [&](int chunk) {
+			const int b = chunk * grain;
+			const int e = std::min(b + grain, num_polys);
+
+			int label = -1;
+			Accumulator acc;
+
+			for(int i=b; i<e; ++i) {
+				if(labels[i] != label) {
+					if(label != -1) partials[chunk].emplace_back(label, acc);
+					label = labels[i];
+					acc = Accumulator();
+				}
+
+				const auto& verts = mesh.polys.raw(polys[i]).verts;
+				Pos p[N];
+				for(int j=0; j<N; ++j) p[j] = positions[verts[j].key] - origin;
+				acc.add_poly(p[0], p[1], p[2]);
+			}
+
+			if(label != -1) partials[chunk].emplace_back(label, acc);
+		});
+
+		std::vector<Accumulator> accs(num_labels);
+		for(const auto& chunk : partials) {
+			for(const auto& [label, acc] : chunk) accs[label].add(acc);
+		}
+
+		std::vector<Mesh_Stats<Scalar>> r(num_labels);
+		for(int i=0; i<num_labels; ++i) r[i] = accs[i].get(origin);
+		return r;
+	}
+
+}
+
+
+
+
+
+//
+// bounding box, surface area, enclosed volume and centroids in one parallel sweep over the polys
+//
+// sums are compensated (Neumaier), over positions relative to a mesh vertex, so float meshes far
+// from the origin are accurate too. the result doesn't depend on the number of threads
+//
+template<class MESH>
+auto compute_mesh_stats(const MESH& mesh) {
+	static_assert(MESH::POLY_SIZE == 3, "compute_mesh_stats requires triangles");
+	SMESH_SCOPED_TIMER("compute_mesh_stats");
+
+	std::vector<int, typename MESH::template Allocator<int>> polys;
+	polys.reserve(mesh.polys.domain_end());
+	for(auto p : mesh.polys) polys.push_back(p.key);
+
+	struct Zero_Labels {
+		int operator[](int) const { return 0; }
+	};
+
+	return smesh::internal::accumulate_mesh_stats(mesh, polys, Zero_Labels(), 1)[0];
+}
+
+
+
+//
+// same, for each label of polys: get_p_label(poly_key) is in [0, num_labels), or -1 to skip the poly
+//
+//   auto components = compute_poly_components(mesh);
+//   auto stats = compute_mesh_stats(mesh, [&](int p) { return components.poly_component[p]; },
+//       components.num_components);
+//
+template<class MESH, class GET_P_LABEL>
+auto compute_mesh_stats(const MESH& mesh, const GET_P_LABEL& get_p_label, int num_labels) {
+	static_assert(MESH::POLY_SIZE == 3, "compute_mesh_stats requires triangles");
+	SMESH_SCOPED_TIMER("compute_mesh_stats");
+
+	using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+
+	// polys grouped by label (counting sort)
+	Ints begins(num_labels + 1, 0);
+	for(auto p : mesh.polys) {
+		const int label = get_p_label(p.key);
+		if(label == -1) continue;
+		DCHECK(label >= 0 && label < num_labels) << "compute_mesh_stats: label out of range";
+		++begins[label + 1];
+	}
+	std::partial_sum(begins.begin(), begins.end(), begins.begin());
+
+	Ints polys(begins.back());
+	Ints labels(begins.back());
+	{
+		auto ends = begins;
+		for(auto p : mesh.polys) {
+			const int label = get_p_label(p.key);
+			if(label == -1) continue;
+			labels[ends[label]] = label;
+			polys[ends[label]++] = p.key;
+		}
+	}
+
+	return smesh::internal::accumulate_mesh_stats(mesh, polys, labels, num_labels);
+}
+
+
+
+
+
+//
+// connected components of polys, over edge links (union-find). requires EDGE_LINKS
+//
+template<class MESH>
+Poly_Components compute_poly_components(const MESH& mesh) {
+	static_assert(MESH::Has_Edge_Links, "compute_poly_components requires EDGE_LINKS");
+	SMESH_SCOPED_TIMER("compute_poly_components");
+
+	Poly_Components r;
+	r.poly_component.assign(mesh.polys.domain_end(), -1);
+
+	std::vector<int, typename MESH::template Allocator<int>> parents(mesh.polys.domain_end());
+	std::iota(parents.begin(), parents.end(), 0);
+
+	auto find = [&parents](int x) {
+		while(parents[x] != x) {
+			parents[x] = parents[ parents[x] ];
+			x = parents[x];
+		}
+		return x;
+	};
+
+	for(auto p : mesh.polys) {
+		for(const auto& pv : mesh.polys.raw(p.key).verts) {
+			if(pv.edge_link.poly == -1) continue;
+			const int a = find(p.key);
+			const int b = find(pv.edge_link.poly);
+			if(a != b) parents[std::max(a, b)] = std::min(a, b);
+		}
+	}
+
+	// roots are the smallest keys of their components
+	for(auto p : mesh.polys) {
+		const int root = find(p.key);
+		if(root == p.key) r.poly_component[p.key] = r.num_components++;
+		else r.poly_component[p.key] = r.poly_component[root];
+	}
+
+	return r;
+}
@@ -1,5 +1,16 @@
 #pragma once
 
+#include "vert-poly-links.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
 
 
 
@@ -41,41 +52,191 @@ auto compute_poly_normal(POLY p) {
 
 
 
+namespace smesh::internal {
+
+	//
+	// copy live verts and polys of 'src' into empty 'dst', with position codec, props and links
+	//
+	// 'vert_remap' and 'poly_remap' receive src key -> dst key (-1 for erased)
+	//
+	template<class MESH, class REMAP>
+	void copy_compact(const MESH& src, MESH& dst, REMAP& vert_remap, REMAP& poly_remap) {
+		DCHECK(dst.verts.empty() && dst.polys.empty()) << "copy_compact expects empty destination mesh";
+
+		// same grid (QUANTIZED_POS), so positions are copied exactly
+		dst.verts.pos_codec = src.verts.pos_codec;
+
+		vert_remap.assign(src.verts.domain_end(), -1);
+		poly_remap.assign(src.polys.domain_end(), -1);
+
+		dst.verts.reserve(src.verts.domain_end());
+		for(auto v : src.verts) {
+			auto nv = dst.verts.add( v.pos() );
+			if constexpr(MESH::Has_Vert_Props) nv.props = v.props();
+			vert_remap[v.key] = nv.key;
+		}
+
+		dst.polys.reserve(src.polys.domain_end());
+		for(auto p : src.polys) {
+			auto np = dst.polys.add( vert_remap[p.verts[0].key], vert_remap[p.verts[1].key], vert_remap[p.verts[2].key] );
+			if constexpr(MESH::Has_Poly_Props) np.props = p.props();
+			if constexpr(MESH::Has_Poly_Vert_Props) {
+				for(int i=0; i<MESH::POLY_SIZE; ++i) np.verts[i].props = p.verts[i].props();
+			}
+			if constexpr(MESH::Has_Indexed_Vert_Props) {
+				for(int i=0; i<MESH::POLY_SIZE; ++i) np.verts[i].indexed_props_key() = p.verts[i].indexed_props_key();
+			}
+			poly_remap[p.key] = np.key;
+		}
+
+		if constexpr(MESH::Has_Indexed_Vert_Props) {
+			dst.indexed_vert_props = src.indexed_vert_props;
+		}
+
+		if constexpr(MESH::Has_Edge_Links) {
+			for(auto p : src.polys) {
+				for(auto pe : p.edges) {
+					if(!pe.owns_edge) continue;
+
+					auto npe = dst.polys[ poly_remap[p.key] ].edges[ pe.handle.edge ];
+					if constexpr(MESH::Has_Edge_Props) npe.props = pe.props();
+
+					if(!pe.has_link) continue;
+
+					auto l = pe.link().handle;
+					npe.link( dst.polys[ poly_remap[l.poly] ].edges[ l.edge ] );
+				}
+			}
+		}
+
+		if constexpr(MESH::Has_Vert_Poly_Links) {
+			compute_vert_poly_links(dst);
+		}
+	}
+
+	template<class MESH>
+	void copy_compact(const MESH& src, MESH& dst) {
+		std::vector<int, typename MESH::template Allocator<int>> vert_remap;
+		std::vector<int, typename MESH::template Allocator<int>> poly_remap;
+		copy_compact(src, dst, vert_remap, poly_remap);
+	}
+
+}
+
+
+
+
+
 //
-// no test coverage
+// isolated verts: live verts not used by any poly. returns 1 for them, by vert key (0 for others
+// and erased verts)
 //
-template< class MESH >
-std::vector<bool> compute_isolated_vertices( const MESH& mesh, bool use_vert_poly_links = false ) {
+// - with vert-poly links: poly_links.empty() of each vert, in parallel
+// - without: polys mark their verts in an atomic bitset, in parallel
+//
+template<class MESH>
+std::vector<uint8_t> compute_isolated_vertices(const MESH& mesh, bool use_vert_poly_links = MESH::Has_Vert_Poly_Links) {
+	SMESH_SCOPED_TIMER("compute_isolated_vertices");
+
+	const int num_verts = mesh.verts.domain_end();
+	std::vector<uint8_t> isolated(num_verts, 0);
+
+	std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+	vert_keys.reserve(num_verts);
+	for(auto v : mesh.verts) vert_keys.push_back(v.key);
 
 	if(use_vert_poly_links) {
-		throw "not implemented";
+		CHECK(MESH::Has_Vert_Poly_Links) << "compute_isolated_vertices: mesh has no VERT_POLY_LINKS";
+		if constexpr(MESH::Has_Vert_Poly_Links) {
+			smesh::parallel_for(0, (int)vert_keys.size(), 16384, [&](int i) {
+				isolated[vert_keys[i]] = mesh.verts[vert_keys[i]].poly_links.empty();
+			});
+		}
+		return isolated;
 	}
-	else {
-		std::vector<bool> isolated(mesh.verts.size_including_removed(), true);
 
-		for( auto p : mesh.polys ) {
-			for( auto pv : p.verts ) {
-				isolated[pv.idx] = false;
-			}
+	// value-initialized: zeros
+	std::vector<std::atomic<uint64_t>> used((num_verts + 63) / 64);
+
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+	poly_keys.reserve(mesh.polys.domain_end());
+	for(auto p : mesh.polys) poly_keys.push_back(p.key);
+
+	smesh::parallel_for(0, (int)poly_keys.size(), 16384, [&](int i) {
+		for(const auto& pv : mesh.polys.raw(poly_keys[i]).verts) {
+			const int v = (int)pv.key;
+			const uint64_t bit = uint64_t(1) << (v % 64);
+			auto& word = used[v / 64];
+			if(!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
 		}
+	});
 
-		return isolated;
-	}
+	smesh::parallel_for(0, (int)vert_keys.size(), 16384, [&](int i) {
+		const int v = vert_keys[i];
+		isolated[v] = !(used[v / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (v % 64)));
+	});
+
+	return isolated;
 }
 
 
+
+template<class MESH>
+bool has_isolated_vertices(const MESH& mesh, bool use_vert_poly_links = MESH::Has_Vert_Poly_Links) {
+	const auto isolated = compute_isolated_vertices(mesh, use_vert_poly_links);
+	return std::find(isolated.begin(), isolated.end(), 1) != isolated.end();
+}
+
+
+
 //
-// no test coverage
+// erase isolated verts, e.g. left over after decimation. returns the number of erased verts
 //
-template< class MESH >
-bool has_isolated_vertices( const MESH& mesh, bool use_vert_poly_links = false ) {
-	auto isolated = compute_isolated_vertices(mesh, use_vert_poly_links);
+// with `compact`, the mesh is then replaced by a compact copy (see copy_compact): vert and poly
+// keys change. props, links, layers and the position codec are kept. the journal is cleared, as
+// its history refers to the old keys
+//
+template<class MESH>
+int remove_isolated_vertices(MESH& mesh, bool compact = false) {
+	SMESH_SCOPED_TIMER("remove_isolated_vertices");
+
+	if constexpr(MESH::Has_Journal) {
+		DCHECK(!compact || !mesh.journal.is_recording()) << "remove_isolated_vertices: can't compact in a journal transaction";
+	}
+
+	const auto isolated = compute_isolated_vertices(mesh);
+
+	int num_removed = 0;
+	for(int v=0; v<(int)isolated.size(); ++v) {
+		if(!isolated[v]) continue;
+		mesh.verts[v].erase();
+		++num_removed;
+	}
+
+	if(compact) {
+		MESH compacted;
+		std::vector<int, typename MESH::template Allocator<int>> vert_remap;
+		std::vector<int, typename MESH::template Allocator<int>> poly_remap;
+		smesh::internal::copy_compact(mesh, compacted, vert_remap, poly_remap);
+
+		// layers follow their elements to the new keys
+		const int old_num_verts = mesh.verts.domain_end();
+		const int old_num_polys = mesh.polys.domain_end();
+
+		compacted.verts.layers = std::move(mesh.verts.layers);
+		compacted.verts.layers.remap(vert_remap.data(), old_num_verts, compacted.verts.domain_end());
+
+		compacted.polys.layers = std::move(mesh.polys.layers);
+		compacted.polys.layers.remap(poly_remap.data(), old_num_polys, compacted.polys.domain_end());
+
+		compacted.polys.corner_layers = std::move(mesh.polys.corner_layers);
+		compacted.polys.corner_layers.remap(poly_remap.data(), old_num_polys, compacted.polys.domain_end());
 
-	for(const auto& b : isolated) {
-		if(b) return true;
+		// clears the journal
+		mesh = std::move(compacted);
 	}
 
-	return false;
+	return num_removed;
 }
 
 
@@ -0,0 +1,858 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "from-soup.hpp"
+#include "binary-stream.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+struct Out_Of_Core_Options {
+	// approximate memory of chunk meshes processed at once, in bytes
+	int64_t memory_budget = int64_t(2) << 30;
+
+	// memory of one chunk poly with its share of verts, links and temporaries
+	// (about 200 bytes for Smesh<float> with EDGE_LINKS and VERT_POLY_LINKS)
+	int bytes_per_poly = 256;
+
+	// merge chunk verts with equal positions (shared verts are never merged with each other)
+	bool weld = true;
+
+	// chunk files are created in a subdirectory, removed at the end
+	std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
+};
+
+
+
+struct Out_Of_Core_Result {
+	int num_chunks = 0;
+	int max_chunk_polys = 0;
+	int num_chunks_in_flight = 0; // processed at once
+	int num_locked_verts = 0;     // shared by chunks
+	int num_verts = 0;            // output
+	int num_polys = 0;            // output
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// layout of a binary little endian PLY file with `vertex` (float or double x,y,z) and `face`
+	// (list vertex_indices of 32-bit ints) elements
+	//
+	struct Ply_Layout {
+		int64_t num_verts = 0;
+		int64_t num_faces = 0;
+
+		int vert_size = 0; // bytes per vertex record
+		int pos_offset[3] = {-1, -1, -1};
+		int pos_size = 0;  // 4 (float) or 8 (double)
+
+		int face_skip_before = 0; // scalar face properties around vertex_indices
+		int face_skip_after = 0;
+		int face_count_size = 0;
+
+		std::streamoff data_begin = 0;
+	};
+
+	inline int get_ply_type_size(const std::string& type) {
+		if(type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+		if(type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+		if(type == "int" || type == "uint" || type == "int32" || type == "uint32") return 4;
+		if(type == "float" || type == "float32") return 4;
+		if(type == "double" || type == "float64") return 8;
+		LOG(FATAL) << "PLY: unknown property type '" << type << "'";
+		return 0;
+	}
+
+	inline Ply_Layout read_ply_layout(std::istream& s) {
+		Ply_Layout r;
+
+		std::string line;
+		std::getline(s, line);
+		CHECK(line == "ply" || line == "ply\r") << "PLY: bad magic";
+
+		enum class Element { NONE, VERTEX, FACE, OTHER } element = Element::NONE;
+		bool has_vertex_indices = false;
+
+		while(std::getline(s, line)) {
+			if(!line.empty() && line.back() == '\r') line.pop_back();
+
+			std::istringstream ls(line);
+			std::string word;
+			ls >> word;
+
+			if(word == "format") {
+				ls >> word;
+				CHECK(word == "binary_little_endian") << "PLY: only binary_little_endian is supported, got " << word;
+			}
+			else if(word == "element") {
+				int64_t count;
+				ls >> word >> count;
+				if(word == "vertex") {
+					CHECK(element == Element::NONE) << "PLY: `vertex` must be the first element";
+					element = Element::VERTEX;
+					r.num_verts = count;
+				}
+				else if(word == "face") {
+					CHECK(element == Element::VERTEX) << "PLY: `face` must follow `vertex`";
+					element = Element::FACE;
+					r.num_faces = count;
+				}
+				else {
+					// ignored, but only after faces
+					CHECK(element == Element::FACE) << "PLY: unsupported element " << word;
+					element = Element::OTHER;
+				}
+			}
+			else if(word == "property" && element != Element::OTHER) {
+				std::string type, name;
+				ls >> type;
+
+				if(type == "list") {
+					std::string count_type, index_type;
+					ls >> count_type >> index_type >> name;
+					CHECK(element == Element::FACE && (name == "vertex_indices" || name == "vertex_index"))
+						<< "PLY: unsupported list property " << name;
+					CHECK_EQ(4, get_ply_type_size(index_type)) << "PLY: vertex indices must be 32-bit";
+					r.face_count_size = get_ply_type_size(count_type);
+					has_vertex_indices = true;
+					continue;
+				}
+
+				ls >> name;
+				const int size = get_ply_type_size(type);
+
+				if(element == Element::VERTEX) {
+					for(int i=0; i<3; ++i) {
+						if(name != std::string(1, char('x' + i))) continue;
+						CHECK(type == "float" || type == "float32" || type == "double" || type == "float64")
+							<< "PLY: vertex positions must be float or double";
+						CHECK(r.pos_size == 0 || r.pos_size == size) << "PLY: mixed position types";
+						r.pos_offset[i] = r.vert_size;
+						r.pos_size = size;
+					}
+					r.vert_size += size;
+				}
+				else if(element == Element::FACE) {
+					(has_vertex_indices ? r.face_skip_after : r.face_skip_before) += size;
+				}
+			}
+			else if(word == "end_header") {
+				break;
+			}
+		}
+
+		CHECK(s) << "PLY: truncated header";
+		CHECK(r.pos_offset[0] != -1 && r.pos_offset[1] != -1 && r.pos_offset[2] != -1) << "PLY: no vertex positions";
+		CHECK(r.num_faces == 0 || has_vertex_indices) << "PLY: no vertex_indices";
+		CHECK_LT(r.num_verts, int64_t(1) << 31) << "PLY: too many verts";
+
+		r.data_begin = s.tellg();
+		return r;
+	}
+
+
+
+	//
+	// sequential reads of small records from a big stream
+	//
+	class Buffered_Reader {
+	public:
+		explicit Buffered_Reader(std::istream& s, int buffer_size = 1 << 20) : stream(s), buffer(buffer_size) {}
+
+		const char* read(int n) {
+			if(end - pos < n) refill(n);
+			const char* r = buffer.data() + pos;
+			pos += n;
+			return r;
+		}
+
+	private:
+		void refill(int n) {
+			std::copy(buffer.begin() + pos, buffer.begin() + end, buffer.begin());
+			end -= pos;
+			pos = 0;
+
+			if((int)buffer.size() < n) buffer.resize(n);
+
+			stream.read(buffer.data() + end, buffer.size() - end);
+			end += (int)stream.gcount();
+			CHECK_GE(end, n) << "binary stream truncated";
+		}
+
+		std::istream& stream;
+		std::vector<char> buffer;
+		int pos = 0;
+		int end = 0;
+	};
+
+	inline int64_t read_ply_uint(const char* data, int size) {
+		switch(size) {
+			case 1: return (uint8_t)data[0];
+			case 2: { uint16_t x; std::memcpy(&x, data, 2); return x; }
+			default: { uint32_t x; std::memcpy(&x, data, 4); return x; }
+		}
+	}
+
+
+
+	//
+	// kd-tree split of a vertex histogram on a grid_size^3 grid into boxes of at most `max_count`
+	// verts (single cells can have more). returns chunk index of each cell (-1 for empty boxes)
+	//
+	template<class ALLOCATOR>
+	int partition_grid(const std::vector<int64_t, ALLOCATOR>& counts, int grid_size, int64_t max_count,
+			std::vector<int, typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<int>>& chunk_of_cell) {
+		const int g = grid_size;
+		const int h = g + 1;
+
+		// summed volume table
+		std::vector<int64_t, ALLOCATOR> sums(size_t(h) * h * h, 0);
+		auto sum_at = [&](int x, int y, int z) -> int64_t& { return sums[(size_t(x) * h + y) * h + z]; };
+
+		for(int x=0; x<g; ++x) {
+			for(int y=0; y<g; ++y) {
+				for(int z=0; z<g; ++z) {
+					sum_at(x+1, y+1, z+1) = counts[(size_t(x) * g + y) * g + z]
+						+ sum_at(x, y+1, z+1) + sum_at(x+1, y, z+1) + sum_at(x+1, y+1, z)
+						- sum_at(x, y, z+1) - sum_at(x, y+1, z) - sum_at(x+1, y, z)
+						+ sum_at(x, y, z);
+				}
+			}
+		}
+
+		using Box = std::array<int, 6>; // lo xyz, hi xyz
+
+		auto get_count = [&](const Box& b) {
+			return sum_at(b[3], b[4], b[5])
+				- sum_at(b[0], b[4], b[5]) - sum_at(b[3], b[1], b[5]) - sum_at(b[3], b[4], b[2])
+				+ sum_at(b[0], b[1], b[5]) + sum_at(b[0], b[4], b[2]) + sum_at(b[3], b[1], b[2])
+				- sum_at(b[0], b[1], b[2]);
+		};
+
+		chunk_of_cell.assign(size_t(g) * g * g, -1);
+		int num_chunks = 0;
+
+		std::vector<Box> stack;
+		stack.push_back({0, 0, 0, g, g, g});
+		while(!stack.empty()) {
+			Box b = stack.back();
+			stack.pop_back();
+
+			const int64_t count = get_count(b);
+			if(count == 0) continue;
+
+			int axis = 0;
+			for(int i=1; i<3; ++i) {
+				if(b[3+i] - b[i] > b[3+axis] - b[axis]) axis = i;
+			}
+
+			if(count <= max_count || b[3+axis] - b[axis] == 1) {
+				for(int x=b[0]; x<b[3]; ++x) {
+					for(int y=b[1]; y<b[4]; ++y) {
+						for(int z=b[2]; z<b[5]; ++z) chunk_of_cell[(size_t(x) * g + y) * g + z] = num_chunks;
+					}
+				}
+				++num_chunks;
+				continue;
+			}
+
+			// weighted median
+			Box left = b;
+			for(left[3+axis] = b[axis] + 1; left[3+axis] < b[3+axis] - 1; ++left[3+axis]) {
+				if(2 * get_count(left) >= count) break;
+			}
+
+			Box right = b;
+			right[axis] = left[3+axis];
+
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+
+		return num_chunks;
+	}
+
+
+
+	//
+	// positions of sorted `keys` from a flat xyz file of T, in coalesced reads
+	//
+	template<class T>
+	void read_positions(std::istream& s, const int32_t* keys, int n, T* out) {
+		std::vector<T> buffer;
+		for(int i=0; i<n; ) {
+			const int first = keys[i];
+			int j = i;
+			while(j+1 < n && keys[j+1] - keys[j] <= 64 && keys[j+1] - first < (1 << 16)) ++j;
+
+			buffer.resize( size_t(keys[j] - first + 1) * 3 );
+			s.seekg( std::streamoff(first) * 3 * sizeof(T) );
+			read_pod(s, buffer.data(), buffer.size());
+
+			for(int k=i; k<=j; ++k) std::copy_n(&buffer[size_t(keys[k] - first) * 3], 3, out + size_t(k) * 3);
+			i = j + 1;
+		}
+	}
+
+
+
+	// lock bit of Out_Of_Core vert_chunk entries
+	constexpr uint16_t out_of_core_locked = 0x8000;
+
+	// chunk output file
+	struct Out_Of_Core_Chunk_Header {
+		int32_t num_verts;   // not locked
+		int32_t num_polys;
+		int32_t num_locked_normals;
+	};
+
+	struct Out_Of_Core_Locked_Normal {
+		int32_t rank;
+		float normal[3];
+	};
+
+	// removes the directory at end of scope
+	struct Temp_Dir {
+		explicit Temp_Dir(const std::filesystem::path& p) : path(p) {
+			std::filesystem::create_directories(path);
+		}
+
+		~Temp_Dir() {
+			std::error_code error;
+			std::filesystem::remove_all(path, error);
+		}
+
+		const std::filesystem::path path;
+	};
+
+
+
+	//
+	// process_ply_out_of_core with positions of type P (float or double, as in the input file)
+	// in temporary files and output
+	//
+	template<class MESH, class P, class FUN>
+	Out_Of_Core_Result process_ply_out_of_core_impl(std::istream& in, const Ply_Layout& layout,
+			const std::filesystem::path& output, const FUN& process_chunk, const Out_Of_Core_Options& options) {
+		DCHECK_EQ(layout.pos_size, (int)sizeof(P));
+
+		using Pos = typename MESH::Pos;
+		using Scalar = typename MESH::Scalar;
+		using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+		using Floats = std::vector<float, typename MESH::template Allocator<float>>;
+		using Pos_Scalars = std::vector<P, typename MESH::template Allocator<P>>;
+
+		Out_Of_Core_Result r;
+
+		constexpr int grid_size = 64;
+		constexpr int N = MESH::POLY_SIZE;
+		constexpr bool has_normals = smesh::has_member_normal<typename MESH::Vert_Props>::value;
+
+		Temp_Dir temp( options.temp_dir / ("smesh-out-of-core-" +
+			std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())) );
+
+		const auto positions_path = temp.path / "positions";
+		auto get_faces_path = [&](int chunk) { return temp.path / (std::to_string(chunk) + ".faces"); };
+		auto get_result_path = [&](int chunk) { return temp.path / (std::to_string(chunk) + ".result"); };
+
+		const int num_input_verts = (int)layout.num_verts;
+
+
+
+		//
+		// verts: bounds and flat positions file
+		//
+		Pos min = Pos::Constant( std::numeric_limits<Scalar>::max() );
+		Pos max = -min;
+		{
+			SMESH_SCOPED_TIMER("process_ply_out_of_core/read_verts");
+
+			std::ofstream positions(positions_path, std::ios::binary);
+			CHECK(positions) << "can't write " << positions_path;
+
+			constexpr int block_size = 65536;
+			std::vector<char> block(size_t(block_size) * layout.vert_size);
+			std::vector<P> xyz(size_t(block_size) * 3);
+
+			for(int b=0; b<num_input_verts; b+=block_size) {
+				const int n = std::min(block_size, num_input_verts - b);
+				read_pod(in, block.data(), size_t(n) * layout.vert_size);
+
+				for(int i=0; i<n; ++i) {
+					for(int j=0; j<3; ++j) {
+						std::memcpy(&xyz[i*3 + j], &block[size_t(i) * layout.vert_size + layout.pos_offset[j]], sizeof(P));
+
+						min[j] = std::min(min[j], Scalar(xyz[i*3 + j]));
+						max[j] = std::max(max[j], Scalar(xyz[i*3 + j]));
+					}
+				}
+
+				write_pod(positions, xyz.data(), size_t(n) * 3);
+			}
+
+			CHECK(positions) << "can't write " << positions_path;
+		}
+
+		auto get_cell = [&](const P* p) {
+			int cell = 0;
+			for(int j=0; j<3; ++j) {
+				const auto extent = max[j] - min[j];
+				int c = extent > 0 ? int((p[j] - min[j]) / extent * grid_size) : 0;
+				cell = cell * grid_size + std::clamp(c, 0, grid_size - 1);
+			}
+			return cell;
+		};
+
+		// calls fun(vert, xyz) for all verts of the positions file
+		auto for_each_position = [&](const auto& fun) {
+			std::ifstream positions(positions_path, std::ios::binary);
+			constexpr int block_size = 65536;
+			std::vector<P> xyz(size_t(block_size) * 3);
+			for(int b=0; b<num_input_verts; b+=block_size) {
+				const int n = std::min(block_size, num_input_verts - b);
+				read_pod(positions, xyz.data(), size_t(n) * 3);
+				for(int i=0; i<n; ++i) fun(b + i, &xyz[size_t(i) * 3]);
+			}
+		};
+
+
+
+		//
+		// chunks: kd-tree over vertex histogram
+		//
+		std::vector<uint16_t, typename MESH::template Allocator<uint16_t>> vert_chunk(num_input_verts);
+		{
+			SMESH_SCOPED_TIMER("process_ply_out_of_core/partition");
+
+			std::vector<int64_t, typename MESH::template Allocator<int64_t>> counts(size_t(grid_size) * grid_size * grid_size, 0);
+			for_each_position([&](int, const P* p) { ++counts[get_cell(p)]; });
+
+			// meshes have about 2 polys per vert
+			const int64_t max_chunk_polys = std::max<int64_t>(1,
+				options.memory_budget / options.bytes_per_poly / smesh::get_num_threads());
+
+			Ints chunk_of_cell;
+			r.num_chunks = partition_grid(counts, grid_size, std::max<int64_t>(1, max_chunk_polys / 2), chunk_of_cell);
+			CHECK_LE(r.num_chunks, (int)out_of_core_locked) << "too many chunks, increase memory_budget";
+
+			for_each_position([&](int v, const P* p) { vert_chunk[v] = (uint16_t)chunk_of_cell[get_cell(p)]; });
+		}
+
+
+
+		//
+		// faces: to chunk files (chunk of the first vertex), fan-triangulated
+		//
+		Ints chunk_num_polys(r.num_chunks, 0);
+		{
+			SMESH_SCOPED_TIMER("process_ply_out_of_core/read_faces");
+
+			in.seekg(layout.data_begin + std::streamoff(layout.num_verts) * layout.vert_size);
+			Buffered_Reader reader(in);
+
+			std::vector<std::vector<int32_t>> buffers(r.num_chunks);
+			// about 64 MB of buffers in total
+			const int flush_size = std::max(1 << 10, (16 << 20) / std::max(r.num_chunks, 1));
+			auto flush = [&](int chunk) {
+				std::ofstream s(get_faces_path(chunk), std::ios::binary | std::ios::app);
+				write_pod(s, buffers[chunk].data(), buffers[chunk].size());
+				CHECK(s) << "can't write " << get_faces_path(chunk);
+				buffers[chunk].clear();
+			};
+
+			std::vector<int32_t> face;
+			for(int64_t f=0; f<layout.num_faces; ++f) {
+				reader.read(layout.face_skip_before);
+				const int n = (int)read_ply_uint(reader.read(layout.face_count_size), layout.face_count_size);
+
+				face.resize(n);
+				std::memcpy(face.data(), reader.read(n * 4), n * 4);
+				reader.read(layout.face_skip_after);
+
+				for(auto v : face) CHECK(v >= 0 && v < num_input_verts) << "PLY: vertex index out of range";
+				if(n < N) continue;
+
+				const int chunk = vert_chunk[face[0]] & ~out_of_core_locked;
+				for(auto v : face) {
+					if((vert_chunk[v] & ~out_of_core_locked) != chunk) vert_chunk[v] |= out_of_core_locked;
+				}
+
+				auto& buffer = buffers[chunk];
+				for(int i=1; i+1<n; ++i) {
+					buffer.insert(buffer.end(), {face[0], face[i], face[i+1]});
+					++chunk_num_polys[chunk];
+				}
+
+				if((int)buffer.size() >= flush_size) flush(chunk);
+			}
+
+			for(int i=0; i<r.num_chunks; ++i) {
+				if(!buffers[i].empty()) flush(i);
+			}
+		}
+
+		r.max_chunk_polys = r.num_chunks ? *std::max_element(chunk_num_polys.begin(), chunk_num_polys.end()) : 0;
+
+		// output index of locked vert v: lock_ranks[v/64] + locked verts in [v/64*64, v)
+		Ints lock_ranks(num_input_verts / 64 + 2, 0);
+		for(int v=0; v<num_input_verts; ++v) {
+			if(vert_chunk[v] & out_of_core_locked) ++lock_ranks[v/64 + 1];
+		}
+		std::partial_sum(lock_ranks.begin(), lock_ranks.end(), lock_ranks.begin());
+		r.num_locked_verts = lock_ranks.back();
+
+		auto get_lock_rank = [&](int v) {
+			int rank = lock_ranks[v/64];
+			for(int i=v/64*64; i<v; ++i) rank += bool(vert_chunk[i] & out_of_core_locked);
+			return rank;
+		};
+
+
+
+		//
+		// process chunks, as many at once as fit in the budget
+		//
+		r.num_chunks_in_flight = (int)std::clamp<int64_t>(
+			options.memory_budget / std::max<int64_t>(1, int64_t(r.max_chunk_polys) * options.bytes_per_poly),
+			1, smesh::get_num_threads());
+
+		Ints chunk_num_verts(r.num_chunks, 0);
+		std::vector<uint8_t> chunk_done(r.num_chunks, 0);
+		{
+			SMESH_SCOPED_TIMER("process_ply_out_of_core/process_chunks");
+
+			std::atomic<int> next_chunk{0};
+
+			smesh::parallel_for(0, r.num_chunks_in_flight, 1, [&](int) {
+				std::ifstream positions(positions_path, std::ios::binary);
+
+				for(;;) {
+					const int chunk = next_chunk++;
+					if(chunk >= r.num_chunks) break;
+					if(chunk_num_polys[chunk] == 0) continue;
+
+					SMESH_SCOPED_TIMER("process_ply_out_of_core/chunk");
+
+					// faces with chunk-local vertex indices
+					Ints faces(size_t(chunk_num_polys[chunk]) * N);
+					{
+						std::ifstream s(get_faces_path(chunk), std::ios::binary);
+						read_pod(s, faces.data(), faces.size());
+					}
+
+					Ints keys(faces.begin(), faces.end());
+					std::sort(keys.begin(), keys.end());
+					keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+					for(auto& v : faces) v = int(std::lower_bound(keys.begin(), keys.end(), v) - keys.begin());
+
+					const int num_keys = (int)keys.size();
+					Pos_Scalars xyz(size_t(num_keys) * 3);
+					read_positions(positions, keys.data(), num_keys, xyz.data());
+
+					auto is_locked = [&](int i) { return bool(vert_chunk[keys[i]] & out_of_core_locked); };
+
+					// weld: verts with equal positions are merged into the first locked one, or the first one.
+					// locked verts are not merged with each other (polys of other chunks use them)
+					Ints remap(num_keys);
+					std::iota(remap.begin(), remap.end(), 0);
+
+					if(options.weld) {
+						auto same_pos = [&](int a, int b) {
+							return std::equal(&xyz[size_t(a) * 3], &xyz[size_t(a) * 3] + 3, &xyz[size_t(b) * 3]);
+						};
+
+						// locked first among equal positions
+						Ints order(num_keys);
+						std::iota(order.begin(), order.end(), 0);
+						std::sort(order.begin(), order.end(), [&](int a, int b) {
+							for(int j=0; j<3; ++j) {
+								if(xyz[size_t(a) * 3 + j] != xyz[size_t(b) * 3 + j]) return xyz[size_t(a) * 3 + j] < xyz[size_t(b) * 3 + j];
+							}
+							return is_locked(a) > is_locked(b);
+						});
+
+						int first = 0;
+						for(int i=1; i<num_keys; ++i) {
+							if(!same_pos(order[first], order[i])) first = i;
+							else if(!is_locked(order[i])) remap[ order[i] ] = order[first];
+						}
+					}
+
+					int num_polys = 0;
+					for(int i=0; i<chunk_num_polys[chunk]; ++i) {
+						int32_t t[N];
+						for(int j=0; j<N; ++j) t[j] = remap[ faces[i*N + j] ];
+						if(t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) continue;
+						std::copy(t, t+N, &faces[size_t(num_polys) * N]);
+						++num_polys;
+					}
+
+					// used verts only
+					Ints vert_key(num_keys, -1);
+					for(int i=0; i<num_polys*N; ++i) vert_key[ faces[i] ] = 0;
+
+					int num_verts = 0;
+					for(int i=0; i<num_keys; ++i) {
+						if(vert_key[i] == -1) continue;
+						vert_key[i] = num_verts;
+						std::copy_n(&xyz[size_t(i) * 3], 3, &xyz[size_t(num_verts) * 3]);
+						keys[num_verts] = keys[i];
+						++num_verts;
+					}
+					for(int i=0; i<num_polys*N; ++i) faces[i] = vert_key[ faces[i] ];
+
+					MESH mesh;
+
+					if constexpr(MESH::Has_Quantized_Pos) {
+						Pos chunk_min = max, chunk_max = min;
+						for(int i=0; i<num_verts; ++i) {
+							Pos p(xyz[i*3 + 0], xyz[i*3 + 1], xyz[i*3 + 2]);
+							chunk_min = chunk_min.cwiseMin(p);
+							chunk_max = chunk_max.cwiseMax(p);
+						}
+						mesh.verts.pos_codec.set_bounds(chunk_min, chunk_max);
+					}
+
+					mesh.verts.add_range(xyz.data(), num_verts);
+					mesh.polys.add_range(faces.data(), num_polys, MESH::Has_Vert_Poly_Links);
+					if constexpr(MESH::Has_Edge_Links) smesh::internal::link_edges_by_vert(mesh);
+
+					xyz = Pos_Scalars();
+					faces = Ints();
+
+					auto& locked = mesh.verts.layers.add("locked", uint8_t(0));
+					auto& lock_rank = mesh.verts.layers.add("out_of_core_lock_rank", int32_t(-1));
+					for(int i=0; i<num_verts; ++i) {
+						if(!(vert_chunk[keys[i]] & out_of_core_locked)) continue;
+						locked[i] = 1;
+						lock_rank[i] = get_lock_rank(keys[i]);
+					}
+					keys = Ints();
+
+					process_chunk(mesh, std::as_const(locked));
+
+					// result: verts that are not locked, then locked normals, then polys (negative indices are
+					// -(lock rank + 1))
+					std::ofstream s(get_result_path(chunk), std::ios::binary);
+
+					Out_Of_Core_Chunk_Header header = {0, 0, 0};
+					std::vector<int32_t> index(mesh.verts.domain_end(), -1);
+					for(auto v : mesh.verts) {
+						if(lock_rank[v.key] == -1) index[v.key] = header.num_verts++;
+						else if(has_normals) ++header.num_locked_normals;
+					}
+					for(auto p : mesh.polys) { (void)p; ++header.num_polys; }
+					write_pod(s, &header, 1);
+
+					for(auto v : mesh.verts) {
+						if(index[v.key] == -1) continue;
+						Eigen::Matrix<P,3,1> pos = v.pos().template cast<P>();
+						write_pod(s, pos.data(), 3);
+					}
+
+					if constexpr(has_normals) {
+						for(auto v : mesh.verts) {
+							if(index[v.key] == -1) continue;
+							Eigen::Vector3f normal = v.props().normal.template cast<float>();
+							write_pod(s, normal.data(), 3);
+						}
+
+						for(auto v : mesh.verts) {
+							if(index[v.key] != -1) continue;
+							Out_Of_Core_Locked_Normal ln = {lock_rank[v.key], {}};
+							for(int j=0; j<3; ++j) ln.normal[j] = float(v.props().normal[j]);
+							write_pod(s, &ln, 1);
+						}
+					}
+
+					for(auto p : mesh.polys) {
+						int32_t t[N];
+						for(int j=0; j<N; ++j) {
+							const int v = p.verts[j].key;
+							t[j] = index[v] != -1 ? index[v] : -(lock_rank[v] + 1);
+						}
+						write_pod(s, t, N);
+					}
+
+					CHECK(s) << "can't write " << get_result_path(chunk);
+
+					chunk_num_verts[chunk] = header.num_verts;
+					chunk_num_polys[chunk] = header.num_polys;
+					chunk_done[chunk] = 1;
+
+					std::error_code error;
+					std::filesystem::remove(get_faces_path(chunk), error);
+				}
+			});
+		}
+
+
+
+		//
+		// output: locked verts, then chunk verts, then polys
+		//
+		SMESH_SCOPED_TIMER("process_ply_out_of_core/write");
+
+		Ints chunk_first_vert(r.num_chunks + 1, r.num_locked_verts);
+		for(int i=1; i<=r.num_chunks; ++i) chunk_first_vert[i] = chunk_first_vert[i-1] + chunk_num_verts[i-1];
+
+		r.num_verts = chunk_first_vert.back();
+		r.num_polys = std::accumulate(chunk_num_polys.begin(), chunk_num_polys.end(), 0);
+
+		std::ofstream out(output, std::ios::binary);
+		CHECK(out) << "can't write " << output;
+
+		const char* pos_type = sizeof(P) == 8 ? "double" : "float";
+		out << "ply\n" << "format binary_little_endian 1.0\n" << "comment smesh out-of-core\n"
+			<< "element vertex " << r.num_verts << "\n"
+			<< "property " << pos_type << " x\n" << "property " << pos_type << " y\n" << "property " << pos_type << " z\n";
+		if(has_normals) out << "property float nx\n" << "property float ny\n" << "property float nz\n";
+		out << "element face " << r.num_polys << "\n"
+			<< "property list uchar int vertex_indices\n" << "end_header\n";
+
+		// normals of locked verts: sum over chunks
+		Floats locked_normals(has_normals ? size_t(r.num_locked_verts) * 3 : 0, 0.0f);
+		for(int chunk=0; chunk<r.num_chunks && has_normals; ++chunk) {
+			if(!chunk_done[chunk]) continue;
+
+			std::ifstream s(get_result_path(chunk), std::ios::binary);
+			Out_Of_Core_Chunk_Header header;
+			read_pod(s, &header, 1);
+			s.seekg(std::streamoff(header.num_verts) * 3 * (sizeof(P) + sizeof(float)), std::ios::cur);
+
+			for(int i=0; i<header.num_locked_normals; ++i) {
+				Out_Of_Core_Locked_Normal ln;
+				read_pod(s, &ln, 1);
+				for(int j=0; j<3; ++j) locked_normals[size_t(ln.rank) * 3 + j] += ln.normal[j];
+			}
+		}
+
+		{
+			int rank = 0;
+			for_each_position([&](int v, const P* p) {
+				if(!(vert_chunk[v] & out_of_core_locked)) return;
+				write_pod(out, p, 3);
+				if(has_normals) {
+					Eigen::Vector3f normal(&locked_normals[size_t(rank) * 3]);
+					if(normal.squaredNorm() > 0) normal.normalize();
+					write_pod(out, normal.data(), 3);
+				}
+				++rank;
+			});
+		}
+
+		for(int chunk=0; chunk<r.num_chunks; ++chunk) {
+			if(!chunk_done[chunk]) continue;
+
+			std::ifstream s(get_result_path(chunk), std::ios::binary);
+			Out_Of_Core_Chunk_Header header;
+			read_pod(s, &header, 1);
+
+			std::vector<P> positions(size_t(header.num_verts) * 3);
+			read_pod(s, positions.data(), positions.size());
+
+			std::vector<float> normals(has_normals ? size_t(header.num_verts) * 3 : 0);
+			read_pod(s, normals.data(), normals.size());
+
+			for(int i=0; i<header.num_verts; ++i) {
+				write_pod(out, &positions[size_t(i) * 3], 3);
+				if(has_normals) write_pod(out, &normals[size_t(i) * 3], 3);
+			}
+		}
+
+		for(int chunk=0; chunk<r.num_chunks; ++chunk) {
+			if(!chunk_done[chunk]) continue;
+
+			std::ifstream s(get_result_path(chunk), std::ios::binary);
+			Out_Of_Core_Chunk_Header header;
+			read_pod(s, &header, 1);
+			s.seekg(std::streamoff(header.num_verts) * 3 * (sizeof(P) + (has_normals ? sizeof(float) : 0))
+				+ std::streamoff(header.num_locked_normals) * sizeof(Out_Of_Core_Locked_Normal), std::ios::cur);
+
+			std::vector<int32_t> polys(size_t(header.num_polys) * N);
+			read_pod(s, polys.data(), polys.size());
+
+			for(int i=0; i<header.num_polys; ++i) {
+				const uint8_t n = N;
+				write_pod(out, &n, 1);
+				for(int j=0; j<N; ++j) {
+					int32_t& v = polys[size_t(i) * N + j];
+					v = v >= 0 ? chunk_first_vert[chunk] + v : -v - 1;
+				}
+				write_pod(out, &polys[size_t(i) * N], N);
+			}
+		}
+
+		CHECK(out) << "can't write " << output;
+
+		return r;
+	}
+
+}
+
+
+
+
+
+//
+// process a binary PLY file that doesn't fit in memory, chunk by chunk, and write the result
+//
+// - input is partitioned spatially into chunks of polys, sized so that chunks processed at once
+//   fit in `options.memory_budget` (a kd-tree over a vertex histogram)
+// - each chunk is loaded as an ordinary MESH (welded, with edge links and vert-poly links), and
+//   passed to process_chunk(MESH& chunk, const auto& locked). independent chunks run in parallel
+// - verts referenced by polys of more than one chunk are locked (`locked[v.key] != 0`, also the
+//   `locked` vert layer): process_chunk must not move or erase them, so chunks stitch back together
+//   - e.g. use the `can_collapse` and `can_cap_edge` arguments of fast_collapse_edges and cap_holes
+// - verts of the output are locked verts first, then the rest, chunk by chunk. if Vert_Props has
+//   `normal`, normals are written too (normals of locked verts are averaged over chunks)
+//
+// besides chunks, needs 2 bytes per input vertex in memory. verts not used by polys are dropped.
+// positions keep the input precision (float or double) in temporary files and output; normals
+// are written as float
+//
+//   process_ply_out_of_core<Mesh>("in.ply", "out.ply", [](Mesh& chunk, const auto& locked) {
+//       fast_collapse_edges(chunk, 0.01, weights, [&](const auto& e) {
+//           return !locked[e.verts[0].key] && !locked[e.verts[1].key];
+//       });
+//   });
+//
+template<class MESH, class FUN>
+Out_Of_Core_Result process_ply_out_of_core(const std::filesystem::path& input, const std::filesystem::path& output,
+		const FUN& process_chunk, const Out_Of_Core_Options& options = Out_Of_Core_Options()) {
+	SMESH_SCOPED_TIMER("process_ply_out_of_core");
+
+	std::ifstream in(input, std::ios::binary);
+	CHECK(in) << "can't open " << input;
+
+	const auto layout = smesh::internal::read_ply_layout(in);
+
+	if(layout.pos_size == 8) {
+		return smesh::internal::process_ply_out_of_core_impl<MESH, double>(in, layout, output, process_chunk, options);
+	}
+	return smesh::internal::process_ply_out_of_core_impl<MESH, float>(in, layout, output, process_chunk, options);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+
+
+namespace smesh {
+
+
+
+
+
+
+
+
+
+namespace internal {
+
+	inline std::atomic<int>& num_threads_setting() {
+		static std::atomic<int> num_threads{0};
+		return num_threads;
+	}
+
+	// true while the thread runs chunks of parallel_for_chunks
+	inline bool& in_parallel_region() {
+		thread_local bool r = false;
+		return r;
+	}
+
+}
+
+
+
+//
+// number of threads used by parallel algorithms
+// 0 (default) means std::thread::hardware_concurrency()
+//
+// nested parallel algorithms (called from inside parallel_for) run in the calling thread
+//
+inline void set_num_threads(int num_threads) {
+	internal::num_threads_setting() = num_threads;
+}
+
+inline int get_num_threads() {
+	if(internal::in_parallel_region()) return 1;
+	int r = internal::num_threads_setting();
+	if(r <= 0) r = (int)std::thread::hardware_concurrency();
+	return std::max(r, 1);
+}
+
+
+
+
+//
+// number of threads `parallel_for_chunks` will use for given range and grain
+// (use it to size per-thread accumulators)
+//
+inline int get_num_threads(int begin, int end, int grain) {
+	grain = std::max(grain, 1);
+	int num_chunks = (end - begin + grain - 1) / grain;
+	return std::max(1, std::min(get_num_threads(), num_chunks));
+}
+
+
+
+
+//
+// call fun(thread_idx, chunk_begin, chunk_end) for chunks of [begin,end) of size `grain`
+//
+// - chunks are handed out dynamically, so `grain` should be big enough to hide the scheduling cost
+// - runs in the calling thread if there's only one chunk
+// - first exception thrown by `fun` is rethrown in the calling thread
+//
+template<class FUN>
+void parallel_for_chunks(int begin, int end, int grain, const FUN& fun) {
+	if(begin >= end) return;
+
+	grain = std::max(grain, 1);
+	const int num_threads = get_num_threads(begin, end, grain);
+
+	if(num_threads == 1) {
+		fun(0, begin, end);
+		return;
+	}
+
+	std::atomic<int> next{begin};
+	std::exception_ptr exception;
+	std::mutex exception_mutex;
+
+	auto worker = [&](int thread_idx) {
+		bool& nested = internal::in_parallel_region();
+		const bool was_nested = nested;
+		nested = true;
+
+		try {
+			for(;;) {
+				int b = next.fetch_add(grain);
+				if(b >= end) break;
+				fun(thread_idx, b, std::min(b + grain, end));
+			}
+		}
+		catch(...) {
+			std::lock_guard<std::mutex> lock(exception_mutex);
+			if(!exception) exception = std::current_exception();
+			next = end;
+		}
+
+		nested = was_nested;
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads - 1);
+	for(int i=1; i<num_threads; ++i) {
+		threads.emplace_back(worker, i);
+	}
+
+	worker(0);
+
+	for(auto& thread : threads) thread.join();
+
+	if(exception) std::rethrow_exception(exception);
+}
+
+
+
+
+//
+// call fun(i) for each i in [begin,end)
+//
+template<class FUN>
+void parallel_for(int begin, int end, int grain, const FUN& fun) {
+	parallel_for_chunks(begin, end, grain, [&fun](int, int b, int e) {
+		for(int i=b; i<e; ++i) fun(i);
+	});
+}
+
+
+
+
+
+//
+// sort [begin,end) with random access iterators: runs are sorted in parallel, then merged
+// pairwise (merge rounds are parallel too). not stable
+//
+template<class ITER, class LESS>
+void parallel_sort(ITER begin, ITER end, const LESS& less) {
+	const int n = int(end - begin);
+	const int num_runs = get_num_threads(0, n, 65536);
+
+	if(num_runs == 1) {
+		std::sort(begin, end, less);
+		return;
+	}
+
+	std::vector<int> bounds(num_runs + 1);
+	for(int i=0; i<=num_runs; ++i) bounds[i] = int(int64_t(n) * i / num_runs);
+
+	parallel_for(0, num_runs, 1, [&](int i) {
+		std::sort(begin + bounds[i], begin + bounds[i+1], less);
+	});
+
+	for(int width=1; width<num_runs; width*=2) {
+		parallel_for(0, (num_runs + 2*width - 1) / (2*width), 1, [&](int i) {
+			const int a = i * 2*width;
+			const int m = std::min(a + width, num_runs);
+			const int e = std::min(a + 2*width, num_runs);
+			if(m < e) std::inplace_merge(begin + bounds[a], begin + bounds[m], begin + bounds[e], less);
+		});
+	}
+}
+
+
+
+} // namespace smesh
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <salgo/accessors-common.hpp>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+
+//
+// vertex position storage, see QUANTIZED_POS and HALF_POS mesh flags
+//
+
+namespace smesh::internal {
+
+	//
+	// IEEE 754 binary16, round to nearest even
+	//
+	inline uint16_t float_to_half(float f) {
+		uint32_t x;
+		std::memcpy(&x, &f, 4);
+
+		const uint32_t sign = (x >> 16) & 0x8000;
+		const uint32_t abs = x & 0x7fffffff;
+
+		// inf or nan
+		if(abs >= 0x7f800000) return sign | 0x7c00 | (abs > 0x7f800000 ? 0x0200 : 0);
+
+		// overflow (65520 and above round to inf)
+		if(abs >= 0x477ff000) return sign | 0x7c00;
+
+		// subnormal
+		if(abs < 0x38800000) {
+			if(abs <= 0x33000000) return sign; // 2^-25 and below round to zero
+
+			const int shift = 126 - int(abs >> 23);
+			const uint32_t m = (abs & 0x7fffff) | 0x800000;
+			uint32_t h = m >> shift;
+			const uint32_t rem = m & ((1u << shift) - 1);
+			const uint32_t half = 1u << (shift - 1);
+			if(rem > half || (rem == half && (h & 1))) ++h;
+			return uint16_t(sign | h);
+		}
+
+		// normal: rebias exponent 127 -> 15 (carry into exponent is fine)
+		uint32_t h = (abs - 0x38000000) >> 13;
+		const uint32_t rem = abs & 0x1fff;
+		if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h;
+		return uint16_t(sign | h);
+	}
+
+	inline float half_to_float(uint16_t h) {
+		const uint32_t sign = uint32_t(h & 0x8000) << 16;
+		const uint32_t e = (h >> 10) & 0x1f;
+		const uint32_t m = h & 0x3ff;
+
+		if(e == 0) {
+			const float f = std::ldexp(float(m), -24);
+			return sign ? -f : f;
+		}
+
+		uint32_t x;
+		if(e == 31) x = sign | 0x7f800000 | (m << 13);
+		else x = sign | ((e + 112) << 23) | (m << 13);
+
+		float f;
+		std::memcpy(&f, &x, 4);
+		return f;
+	}
+
+
+
+
+	//
+	// default: Pos stored as is
+	//
+	template<class POS>
+	struct Full_Pos_Codec {
+		using Stored = POS;
+
+		static Stored get_zero() { return POS(0,0,0); }
+
+		const POS& decode(const Stored& s) const { return s; }
+		const Stored& encode(const POS& p) const { return p; }
+	};
+
+
+
+	struct Half_Pos {
+		std::array<uint16_t, 3> h = {{0,0,0}};
+	};
+
+	//
+	// 6 bytes per vertex, ~3 significant decimal digits (relative to magnitude)
+	//
+	template<class POS>
+	struct Half_Pos_Codec {
+		using Stored = Half_Pos;
+
+		static Stored get_zero() { return {}; }
+
+		POS decode(const Stored& s) const {
+			return POS( half_to_float(s.h[0]), half_to_float(s.h[1]), half_to_float(s.h[2]) );
+		}
+
+		Stored encode(const POS& p) const {
+			return {{{ float_to_half(float(p[0])), float_to_half(float(p[1])), float_to_half(float(p[2])) }}};
+		}
+	};
+
+
+
+	struct Quantized_Pos {
+		std::array<uint16_t, 3> q = {{0,0,0}};
+	};
+
+	//
+	// 6 bytes per vertex, 16 bits per axis on a uniform grid over the mesh bounds
+	// (see set_pos_bounds). bounds must be set before encoding, and positions must be inside them
+	// (both checked in debug builds; positions outside the bounds are clamped otherwise)
+	//
+	template<class POS>
+	struct Quantized_Pos_Codec {
+		using Stored = Quantized_Pos;
+		using Scalar = typename POS::Scalar;
+
+		static constexpr int MAX = 65535;
+
+		POS origin = {0,0,0};
+		POS step = {1,1,1};
+		bool has_bounds = false;
+
+		static Stored get_zero() { return {}; }
+
+		void set_bounds(const POS& min, const POS& max) {
+			origin = min;
+			for(int i=0; i<3; ++i) step[i] = std::max(max[i] - min[i], Scalar(0)) / MAX;
+			has_bounds = true;
+		}
+
+		POS get_min() const { return origin; }
+		POS get_max() const { return origin + step * MAX; }
+
+		POS decode(const Stored& s) const {
+			return POS( origin[0] + s.q[0] * step[0], origin[1] + s.q[1] * step[1], origin[2] + s.q[2] * step[2] );
+		}
+
+		Stored encode(const POS& p) const {
+			DCHECK(has_bounds) << "QUANTIZED_POS: call set_pos_bounds before adding vertices";
+
+			Stored r;
+			for(int i=0; i<3; ++i) {
+				if(step[i] == 0) continue;
+				auto x = std::round( (p[i] - origin[i]) / step[i] );
+				DCHECK(x >= 0 && x <= MAX) << "QUANTIZED_POS: position " << p.transpose() << " outside of bounds "
+					<< get_min().transpose() << " - " << get_max().transpose();
+				r.q[i] = uint16_t( std::clamp(x, Scalar(0), Scalar(MAX)) );
+			}
+			return r;
+		}
+	};
+
+
+
+
+	//
+	// `pos` of vertex accessors when positions are encoded: decodes on read, encodes on write
+	//
+	template<class CODEC, class POS, salgo::Const_Flag C>
+	class Encoded_Pos_Proxy {
+	public:
+		using Stored = typename CODEC::Stored;
+		using Scalar = typename POS::Scalar;
+
+		Encoded_Pos_Proxy(const CODEC& c, salgo::Const<Stored,C>& s) : codec(c), stored(s) {}
+
+		POS operator()() const { return codec.decode(stored); }
+		operator POS() const { return (*this)(); }
+
+		Scalar operator[](int i) const { return (*this)()[i]; }
+
+		template<class X>
+		const Encoded_Pos_Proxy& operator=(const X& x) const {
+			static_assert(C == salgo::MUTAB, "can't assign to const pos");
+			stored = codec.encode( POS(x) );
+			return *this;
+		}
+
+		const Encoded_Pos_Proxy& operator=(const Encoded_Pos_Proxy& o) const {
+			return *this = o();
+		}
+
+		template<class X> const Encoded_Pos_Proxy& operator+=(const X& x) const { return *this = (*this)() + x; }
+		template<class X> const Encoded_Pos_Proxy& operator-=(const X& x) const { return *this = (*this)() - x; }
+		template<class X> const Encoded_Pos_Proxy& operator*=(const X& x) const { return *this = (*this)() * x; }
+		template<class X> const Encoded_Pos_Proxy& operator/=(const X& x) const { return *this = (*this)() / x; }
+
+		// arithmetic, so `pv.pos - pv.next().pos` works like with plain Pos references
+		friend POS operator-(const Encoded_Pos_Proxy& a, const Encoded_Pos_Proxy& b) { return a() - b(); }
+		friend POS operator+(const Encoded_Pos_Proxy& a, const Encoded_Pos_Proxy& b) { return a() + b(); }
+		template<class X> friend POS operator-(const Encoded_Pos_Proxy& a, const X& b) { return a() - b; }
+		template<class X> friend POS operator-(const X& a, const Encoded_Pos_Proxy& b) { return a - b(); }
+		template<class X> friend POS operator+(const Encoded_Pos_Proxy& a, const X& b) { return a() + b; }
+		template<class X> friend POS operator+(const X& a, const Encoded_Pos_Proxy& b) { return a + b(); }
+		template<class X> friend POS operator*(const Encoded_Pos_Proxy& a, const X& b) { return a() * b; }
+		template<class X> friend POS operator*(const X& a, const Encoded_Pos_Proxy& b) { return a * b(); }
+
+	private:
+		const CODEC& codec;
+		salgo::Const<Stored,C>& stored;
+	};
+
+}
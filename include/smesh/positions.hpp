@@ -0,0 +1,58 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <vector>
+
+
+
+//
+// set quantization grid of a QUANTIZED_POS mesh (re-encodes existing vertices)
+//
+// set it before adding vertices, or positions are quantized twice. load_ply sets it from the file
+//
+template<class MESH>
+void set_pos_bounds(MESH& mesh, const typename MESH::Pos& min, const typename MESH::Pos& max) {
+	static_assert(MESH::Has_Quantized_Pos, "set_pos_bounds requires QUANTIZED_POS");
+	SMESH_SCOPED_TIMER("set_pos_bounds");
+
+	auto old_codec = mesh.verts.pos_codec;
+	mesh.verts.pos_codec.set_bounds(min, max);
+
+	for(auto v : mesh.verts) {
+		auto& stored = mesh.verts.raw(v.key).pos;
+		stored = mesh.verts.pos_codec.encode( old_codec.decode(stored) );
+	}
+}
+
+
+
+
+//
+// decoded vertex positions as a flat array indexed by vertex key (erased verts are left
+// uninitialized), so hot loops don't decode the same vertex repeatedly
+//
+// works for any position storage. computed in parallel, see set_num_threads
+//
+//   auto positions = decode_positions<float>(mesh);
+//
+template<class T = float, class MESH>
+auto decode_positions(const MESH& mesh) {
+	SMESH_SCOPED_TIMER("decode_positions");
+
+	using Pos = Eigen::Matrix<T,3,1>;
+	std::vector<Pos, typename MESH::template Allocator<Pos>> r(mesh.verts.domain_end());
+
+	std::vector<int, typename MESH::template Allocator<int>> keys;
+	keys.reserve(mesh.verts.domain_end());
+	for(auto v : mesh.verts) keys.push_back(v.key);
+
+	smesh::parallel_for(0, (int)keys.size(), 16384, [&](int i) {
+		const int key = keys[i];
+		r[key] = mesh.verts.pos_codec.decode( mesh.verts.raw(key).pos ).template cast<T>();
+	});
+
+	return r;
+}
@@ -0,0 +1,617 @@
+#pragma once
+
+#include "collapse-edges.hpp"
+#include "lod.hpp"
+#include "binary-stream.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+
+
+//
+// progressive mesh: base mesh + stream of vertex splits
+//
+// each vertex split is the inverse of one edge collapse (see collapse_edge): it restores
+// the position of the kept vert, re-creates the removed vert, moves its corners back to it
+// and re-creates the removed (degenerate) polys with their edge links
+//
+// verts and polys are referred to by ids: base entities are numbered 0.. in storage order,
+// then each split creates the next vert id and the next poly ids
+//
+// only positions and topology are encoded - vert/poly props are not. position bounds are stored
+// too, so QUANTIZED_POS decoders use the encoder's grid
+//
+template<class MESH>
+struct Progressive_Mesh {
+	using Pos = typename MESH::Pos;
+
+	// poly: vert ids and edge links (poly_id * POLY_SIZE + edge, or -1 if open)
+	struct Poly_Record {
+		int32_t verts[MESH::POLY_SIZE];
+		int32_t links[MESH::POLY_SIZE];
+	};
+
+	// corner of existing poly that is moved from 'vert' to the new vert
+	struct Corner_Record {
+		int32_t poly;
+		int32_t corner;
+	};
+
+	struct Split_Record {
+		int32_t vert;        // kept vert id
+		int32_t num_corners;
+		int32_t num_polys;
+		Pos vert_pos;        // kept vert position before the collapse
+		Pos new_vert_pos;
+	};
+
+	// QUANTIZED_POS: bounds of the input's grid, otherwise bounding box of all positions
+	Pos pos_min = Pos(0,0,0);
+	Pos pos_max = Pos(0,0,0);
+
+	std::vector<Pos> base_positions;
+	std::vector<Poly_Record> base_polys;
+
+	// concatenated, in split order
+	std::vector<Split_Record> splits;
+	std::vector<Corner_Record> corners;
+	std::vector<Poly_Record> polys;
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	constexpr char progressive_mesh_magic[4] = {'S','M','P','M'};
+	constexpr uint32_t progressive_mesh_version = 2;
+
+}
+
+
+
+
+
+//
+// decimate a copy of 'mesh' with collapse_edge (like fast_collapse_edges) and record every
+// collapse as a vertex split
+//
+// the input mesh needs edge links (and vert-poly links if enabled) computed
+//
+template<class MESH>
+Progressive_Mesh<MESH> encode_progressive_mesh(const MESH& mesh, const typename MESH::Scalar& max_edge_length) {
+	SMESH_SCOPED_TIMER("encode_progressive_mesh");
+
+	using PM = Progressive_Mesh<MESH>;
+	using Scalar = typename MESH::Scalar;
+	constexpr int N = MESH::POLY_SIZE;
+
+	MESH work;
+	smesh::internal::copy_compact(mesh, work);
+
+	// collapse log, in work mesh keys (no adds during decimation, so keys are unique)
+	struct Collapse {
+		int a;
+		int b;
+		typename MESH::Pos a_pos;
+		typename MESH::Pos b_pos;
+		int corners_end;
+		int polys_end;
+	};
+
+	struct Removed_Poly {
+		int key;
+		typename PM::Poly_Record record; // work vert keys, links as work poly key * N + edge
+	};
+
+	std::vector<Collapse> collapses;
+	std::vector<typename PM::Corner_Record> corners; // work poly keys
+	std::vector<Removed_Poly> removed;
+
+	std::vector<int32_t, typename MESH::template Allocator<int32_t>> weights(work.verts.domain_end(), 1);
+
+	// polys around 'b' either lose a corner to 'a' or become degenerate and get removed
+	auto record_poly_vert = [&](const auto& pv, int a) {
+		auto p = pv.poly;
+
+		bool has_a = false;
+		for(auto ppv : p.verts) {
+			if(ppv.key == a) has_a = true;
+		}
+
+		if(!has_a) {
+			corners.push_back({p.key, pv.handle.vert});
+			return;
+		}
+
+		Removed_Poly rp;
+		rp.key = p.key;
+		for(int i=0; i<N; ++i) {
+			rp.record.verts[i] = p.verts[i].key;
+			auto pe = p.edges[i];
+			rp.record.links[i] = pe.has_link ? pe.link().handle.poly * N + pe.link().handle.edge : -1;
+		}
+		removed.push_back(rp);
+	};
+
+	bool change = true;
+	while(change) {
+		change = false;
+
+		for(auto p : work.polys) {
+			for(auto e : p.edges) {
+				if(!e.owns_edge) continue;
+				if(e.segment.trace().squaredNorm() > max_edge_length * max_edge_length) continue;
+
+				const int a = e.verts[0].key;
+				const int b = e.verts[1].key;
+
+				const int old_num_corners = (int)corners.size();
+				const int old_num_removed = (int)removed.size();
+
+				Collapse c = {a, b, e.verts[0].pos(), e.verts[1].pos(), 0, 0};
+
+				if constexpr(MESH::Has_Vert_Poly_Links) {
+					for(auto pv : e.verts[1].poly_links) record_poly_vert(pv, a);
+				}
+				else {
+					for(auto pv : e.next_vert().ring()) record_poly_vert(pv, a);
+				}
+
+				if(!collapse_edge(e, (Scalar)weights[b] / (weights[a] + weights[b]))) {
+					corners.resize(old_num_corners);
+					removed.resize(old_num_removed);
+					continue;
+				}
+
+				weights[a] += weights[b];
+
+				c.corners_end = (int)corners.size();
+				c.polys_end = (int)removed.size();
+				collapses.push_back(c);
+
+				change = true;
+				break; // this poly does not exist now
+			}
+		}
+	}
+
+
+
+	// assign ids: base entities first, then splits in reverse collapse order
+
+	std::vector<int32_t> vert_ids(work.verts.domain_end(), -1);
+	std::vector<int32_t> poly_ids(work.polys.domain_end(), -1);
+
+	int32_t num_vert_ids = 0;
+	for(auto v : work.verts) vert_ids[v.key] = num_vert_ids++;
+
+	int32_t num_poly_ids = 0;
+	for(auto p : work.polys) poly_ids[p.key] = num_poly_ids++;
+
+	for(int i=(int)collapses.size()-1; i>=0; --i) {
+		vert_ids[collapses[i].b] = num_vert_ids++;
+
+		for(int j = i ? collapses[i-1].polys_end : 0; j<collapses[i].polys_end; ++j) {
+			poly_ids[removed[j].key] = num_poly_ids++;
+		}
+	}
+
+	auto map_link = [&](int32_t link) {
+		return link == -1 ? -1 : poly_ids[link / N] * N + link % N;
+	};
+
+	auto map_poly = [&](const typename PM::Poly_Record& pr) {
+		typename PM::Poly_Record r;
+		for(int i=0; i<N; ++i) {
+			r.verts[i] = vert_ids[pr.verts[i]];
+			r.links[i] = map_link(pr.links[i]);
+		}
+		return r;
+	};
+
+
+
+	PM r;
+
+	r.base_positions.reserve(work.verts.domain_end());
+	for(auto v : work.verts) r.base_positions.push_back(v.pos());
+
+	r.base_polys.reserve(work.polys.domain_end());
+	for(auto p : work.polys) {
+		typename PM::Poly_Record pr;
+		for(int i=0; i<N; ++i) {
+			pr.verts[i] = vert_ids[p.verts[i].key];
+			auto pe = p.edges[i];
+			pr.links[i] = pe.has_link ? poly_ids[pe.link().handle.poly] * N + pe.link().handle.edge : -1;
+		}
+		r.base_polys.push_back(pr);
+	}
+
+	r.splits.reserve(collapses.size());
+	r.corners.reserve(corners.size());
+	r.polys.reserve(removed.size());
+
+	for(int i=(int)collapses.size()-1; i>=0; --i) {
+		const auto& c = collapses[i];
+		const int corners_begin = i ? collapses[i-1].corners_end : 0;
+		const int polys_begin = i ? collapses[i-1].polys_end : 0;
+
+		r.splits.push_back({vert_ids[c.a], c.corners_end - corners_begin, c.polys_end - polys_begin, c.a_pos, c.b_pos});
+
+		for(int j=corners_begin; j<c.corners_end; ++j) {
+			r.corners.push_back({poly_ids[corners[j].poly], corners[j].corner});
+		}
+
+		for(int j=polys_begin; j<c.polys_end; ++j) {
+			r.polys.push_back(map_poly(removed[j].record));
+		}
+	}
+
+	if constexpr(MESH::Has_Quantized_Pos) {
+		r.pos_min = mesh.verts.pos_codec.get_min();
+		r.pos_max = mesh.verts.pos_codec.get_max();
+	}
+	else if(!r.base_positions.empty()) {
+		r.pos_min = r.pos_max = r.base_positions[0];
+		auto extend = [&r](const typename MESH::Pos& pos) {
+			r.pos_min = r.pos_min.cwiseMin(pos);
+			r.pos_max = r.pos_max.cwiseMax(pos);
+		};
+		for(const auto& pos : r.base_positions) extend(pos);
+		for(const auto& split : r.splits) {
+			extend(split.vert_pos);
+			extend(split.new_vert_pos);
+		}
+	}
+
+	return r;
+}
+
+
+
+
+
+
+//
+// binary stream: header, position bounds, base mesh, then one self-contained record per split
+// (split, its corners, its polys), so splits can be decoded as bytes arrive
+//
+// native endianness and scalar type
+//
+template<class MESH>
+void write_progressive_mesh(std::ostream& s, const Progressive_Mesh<MESH>& pm) {
+	SMESH_SCOPED_TIMER("write_progressive_mesh");
+	using namespace smesh::internal;
+
+	const uint32_t header[] = {
+		progressive_mesh_version,
+		(uint32_t)sizeof(typename MESH::Scalar),
+		(uint32_t)MESH::POLY_SIZE,
+		(uint32_t)pm.base_positions.size(),
+		(uint32_t)pm.base_polys.size(),
+		(uint32_t)pm.splits.size()
+	};
+
+	write_pod(s, progressive_mesh_magic, 4);
+	write_pod(s, header, 6);
+
+	write_pod(s, pm.pos_min.data(), 3);
+	write_pod(s, pm.pos_max.data(), 3);
+
+	for(const auto& pos : pm.base_positions) write_pod(s, pos.data(), 3);
+	write_pod(s, pm.base_polys.data(), pm.base_polys.size());
+
+	int corners_begin = 0;
+	int polys_begin = 0;
+	for(const auto& split : pm.splits) {
+		const int32_t fields[] = {split.vert, split.num_corners, split.num_polys};
+		write_pod(s, fields, 3);
+		write_pod(s, split.vert_pos.data(), 3);
+		write_pod(s, split.new_vert_pos.data(), 3);
+
+		write_pod(s, pm.corners.data() + corners_begin, split.num_corners);
+		write_pod(s, pm.polys.data() + polys_begin, split.num_polys);
+
+		corners_begin += split.num_corners;
+		polys_begin += split.num_polys;
+	}
+}
+
+
+
+
+
+//
+// builds the base mesh and applies vertex splits incrementally, keeping edge links
+// (and vert-poly links if enabled) valid after every split
+//
+//   Progressive_Mesh_Decoder<Mesh> decoder(mesh);
+//   if(!decoder.read_base(stream)) ... // incomplete, or failed()
+//   while(decoder.read_splits(stream, 1000)) render(mesh);
+//
+// the stream can be read while it is still arriving: an incomplete base or split record is left
+// unconsumed (the stream is rewound to its start, so it must be seekable) and read by a later
+// call. a record with out-of-range ids or broken links stops decoding, see failed()
+//
+template<class MESH>
+class Progressive_Mesh_Decoder {
+public:
+	using PM = Progressive_Mesh<MESH>;
+	using Scalar = typename MESH::Scalar;
+	static constexpr int N = MESH::POLY_SIZE;
+
+	explicit Progressive_Mesh_Decoder(MESH& m) : mesh(m) {}
+
+	//
+	// read the base mesh into the target mesh, which must be empty. returns false if the base is
+	// incomplete (the stream is rewound to its start, as for splits, so call it again when more
+	// data arrives) or invalid (see failed()). the mesh is not modified then
+	//
+	bool read_base(std::istream& s) {
+		SMESH_SCOPED_TIMER("Progressive_Mesh_Decoder::read_base");
+
+		DCHECK(mesh.verts.empty() && mesh.polys.empty()) << "Progressive_Mesh_Decoder: target mesh not empty";
+
+		num_splits = 0;
+		num_splits_applied = 0;
+		has_failed = false;
+
+		const auto base_begin = s.tellg();
+
+		uint32_t header[6];
+		Scalar bounds[6];
+		std::vector<Scalar, typename MESH::template Allocator<Scalar>> positions;
+
+		if(!read_base_records(s, header, bounds, positions)) {
+			if(!has_failed) {
+				// incomplete: leave it for the next call
+				s.clear();
+				s.seekg(base_begin);
+				has_failed = base_begin == std::istream::pos_type(-1) || !s;
+			}
+			return false;
+		}
+
+		num_splits = (int)header[5];
+
+		if constexpr(MESH::Has_Quantized_Pos) {
+			using Pos = typename MESH::Pos;
+			mesh.verts.pos_codec.set_bounds(Pos(bounds[0], bounds[1], bounds[2]), Pos(bounds[3], bounds[4], bounds[5]));
+		}
+
+		const int num_verts = (int)header[3];
+		vert_keys.reserve(num_verts);
+		mesh.verts.reserve(num_verts);
+		for(int i=0; i<num_verts; ++i) {
+			const Scalar* pos = &positions[size_t(i) * 3];
+			vert_keys.push_back( mesh.verts.add(pos[0], pos[1], pos[2]).key );
+		}
+
+		add_polys();
+		return true;
+	}
+
+	//
+	// read and apply up to 'max_splits' splits; returns number of splits applied
+	//
+	// stops early at the end of the available data or at an invalid record
+	//
+	int read_splits(std::istream& s, int max_splits = std::numeric_limits<int>::max()) {
+		SMESH_SCOPED_TIMER("Progressive_Mesh_Decoder::read_splits");
+
+		int r = 0;
+		for(; r < max_splits && num_splits_applied < num_splits && !has_failed; ++r) {
+			const auto record_begin = s.tellg();
+
+			int32_t fields[3];
+			Scalar pos[6];
+			if(!read_split(s, fields, pos)) {
+				if(has_failed) break;
+
+				// incomplete: leave it for the next call
+				s.clear();
+				s.seekg(record_begin);
+				has_failed = record_begin == std::istream::pos_type(-1) || !s;
+				break;
+			}
+
+			apply_split(fields[0], pos);
+		}
+
+		return r;
+	}
+
+	int get_num_splits() const { return num_splits; }
+	int get_num_splits_applied() const { return num_splits_applied; }
+	bool done() const { return num_splits_applied == num_splits; }
+
+	// an invalid base or split record was read (or an incomplete one could not be rewound): no
+	// more splits will be applied
+	bool failed() const { return has_failed; }
+
+private:
+	// header, bounds, base positions and base polys (into 'polys'). false if incomplete, or
+	// invalid (sets has_failed)
+	template<class POSITIONS>
+	bool read_base_records(std::istream& s, uint32_t* header, Scalar* bounds, POSITIONS& positions) {
+		using namespace smesh::internal;
+
+		char magic[4];
+		if(!try_read_pod(s, magic, 4)) return false;
+		if(!std::equal(magic, magic+4, progressive_mesh_magic)) {
+			has_failed = true;
+			return false;
+		}
+
+		if(!try_read_pod(s, header, 6)) return false;
+
+		// scalar type and poly size are fixed by MESH: a mismatch is a usage error, not bad data
+		CHECK_EQ(header[1], sizeof(Scalar)) << "progressive mesh scalar type mismatch";
+		CHECK_EQ(header[2], (uint32_t)N) << "progressive mesh poly size mismatch";
+
+		// ids and links (poly id * N + edge) must fit int32
+		constexpr uint32_t max_count = std::numeric_limits<int32_t>::max() / 3 / N;
+		if(header[0] != progressive_mesh_version || header[3] > max_count || header[4] > max_count ||
+				header[5] > (uint32_t)std::numeric_limits<int32_t>::max()) {
+			has_failed = true;
+			return false;
+		}
+
+		if(!try_read_pod(s, bounds, 6)) return false;
+		for(int j=0; j<3; ++j) {
+			if(!std::isfinite(bounds[j]) || !std::isfinite(bounds[3+j]) || bounds[j] > bounds[3+j]) has_failed = true;
+		}
+		if(has_failed) return false;
+
+		const int num_verts = (int)header[3];
+		const int num_polys = (int)header[4];
+
+		if(!read_chunked(s, positions, num_verts * 3) || !read_chunked(s, polys, num_polys)) return false;
+
+		// base links are two-way, between base polys
+		for(int i=0; i<num_polys; ++i) {
+			const auto& pr = polys[i];
+			for(int j=0; j<N; ++j) {
+				if(pr.verts[j] < 0 || pr.verts[j] >= num_verts) has_failed = true;
+
+				const auto link = pr.links[j];
+				if(link == -1) continue;
+				if(link < 0 || link >= num_polys * N || link / N == i || polys[link / N].links[link % N] != i * N + j) {
+					has_failed = true;
+				}
+			}
+		}
+
+		return !has_failed;
+	}
+
+	// false if the record is incomplete, or invalid (sets has_failed)
+	bool read_split(std::istream& s, int32_t* fields, Scalar* pos) {
+		using namespace smesh::internal;
+
+		if(!try_read_pod(s, fields, 3) || !try_read_pod(s, pos, 6)) return false;
+
+		const int num_vert_ids = (int)vert_keys.size();
+		const int num_poly_ids = (int)poly_keys.size();
+
+		// corners are distinct corners of existing polys
+		if(fields[0] < 0 || fields[0] >= num_vert_ids || fields[1] < 0 || fields[2] < 0 ||
+				fields[1] > int64_t(num_poly_ids) * N) {
+			has_failed = true;
+			return false;
+		}
+
+		if(!read_chunked(s, corners, fields[1]) || !read_chunked(s, polys, fields[2])) return false;
+
+		for(const auto& c : corners) {
+			if(c.poly < 0 || c.poly >= num_poly_ids || c.corner < 0 || c.corner >= N) has_failed = true;
+		}
+
+		// polys can use the new vert, and link to each other
+		const int64_t num_links = (int64_t(num_poly_ids) + fields[2]) * N;
+		for(int k=0; k<(int)polys.size(); ++k) {
+			const auto& pr = polys[k];
+			for(int i=0; i<N; ++i) {
+				if(pr.verts[i] < 0 || pr.verts[i] > num_vert_ids) has_failed = true;
+				if(pr.links[i] < -1 || pr.links[i] >= num_links) has_failed = true;
+				if(pr.links[i] != -1 && pr.links[i] / N == num_poly_ids + k) has_failed = true;
+			}
+		}
+
+		return !has_failed;
+	}
+
+	// grows 'v' only as data arrives, so a corrupt count can't allocate more than the stream holds
+	template<class VECTOR>
+	static bool read_chunked(std::istream& s, VECTOR& v, int n) {
+		constexpr int chunk = 4096;
+
+		v.clear();
+		for(int i=0; i<n; i+=chunk) {
+			const int m = std::min(chunk, n - i);
+			v.resize(i + m);
+			if(!smesh::internal::try_read_pod(s, v.data() + i, m)) return false;
+		}
+		return true;
+	}
+
+	void apply_split(int32_t vert, const Scalar* pos) {
+		auto a = mesh.verts[ vert_keys[vert] ];
+		a.pos = typename MESH::Pos(pos[0], pos[1], pos[2]);
+
+		auto b = mesh.verts.add(pos[3], pos[4], pos[5]);
+		vert_keys.push_back(b.key);
+
+		for(const auto& c : corners) {
+			auto pv = mesh.polys[ poly_keys[c.poly] ].verts[ c.corner ];
+			if constexpr(MESH::Has_Vert_Poly_Links) {
+				mesh.verts.raw(pv.key).poly_links.erase(pv.handle);
+			}
+			pv.key = b.key;
+			if constexpr(MESH::Has_Vert_Poly_Links) {
+				b.poly_links.add(pv);
+			}
+		}
+
+		add_polys();
+
+		++num_splits_applied;
+	}
+
+	// add 'polys' and link them; links to existing polys replace links created by the collapse
+	void add_polys() {
+		const int first = (int)poly_keys.size();
+
+		for(const auto& pr : polys) {
+			auto p = mesh.polys.add( vert_keys[pr.verts[0]], vert_keys[pr.verts[1]], vert_keys[pr.verts[2]] );
+			poly_keys.push_back(p.key);
+
+			if constexpr(MESH::Has_Vert_Poly_Links) {
+				for(auto pv : p.verts) pv.vert.poly_links.add(pv);
+			}
+		}
+
+		if constexpr(MESH::Has_Edge_Links) {
+			for(int i=0; i<(int)polys.size(); ++i) {
+				for(int j=0; j<N; ++j) {
+					const auto link = polys[i].links[j];
+					if(link == -1) continue;
+
+					auto pe = mesh.polys[ poly_keys[first + i] ].edges[j];
+					if(pe.has_link) continue; // linked from the other side
+
+					auto other = mesh.polys[ poly_keys[link / N] ].edges[ link % N ];
+					if(other.has_link) other.unlink();
+					pe.link(other);
+				}
+			}
+		}
+	}
+
+private:
+	MESH& mesh;
+
+	int num_splits = 0;
+	int num_splits_applied = 0;
+	bool has_failed = false;
+
+	// id -> mesh key
+	std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+
+	// reused buffers
+	std::vector<typename PM::Corner_Record, typename MESH::template Allocator<typename PM::Corner_Record>> corners;
+	std::vector<typename PM::Poly_Record, typename MESH::template Allocator<typename PM::Poly_Record>> polys;
+};
+
@@ -0,0 +1,351 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+//
+// result of find_self_intersections
+//
+struct Self_Intersections {
+	std::vector<std::pair<int,int>> poly_pairs; // intersecting poly keys (a < b), sorted
+	int64_t num_tested = 0;                     // pairs that reached the triangle-triangle test
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// triangle-triangle intersection from orientation signs only (no thresholds or divisions)
+	//
+	namespace tri_tri {
+		using Vec3 = Eigen::Vector3d;
+		using Vec2 = Eigen::Vector2d;
+
+		template<class T>
+		int sign(T x) { return (x > 0) - (x < 0); }
+
+		// positive if d is on the side of (a,b,c) its normal points to
+		inline int orient_3d(const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& d) {
+			return sign( (b - a).cross(c - a).dot(d - a) );
+		}
+
+		inline int orient_2d(const Vec2& a, const Vec2& b, const Vec2& c) {
+			const Vec2 ab = b - a;
+			const Vec2 ac = c - a;
+			return sign( ab[0] * ac[1] - ab[1] * ac[0] );
+		}
+
+		// closed segments
+		inline bool segments_intersect_2d(const Vec2& p, const Vec2& q, const Vec2& a, const Vec2& b) {
+			const int o1 = orient_2d(p, q, a);
+			const int o2 = orient_2d(p, q, b);
+			const int o3 = orient_2d(a, b, p);
+			const int o4 = orient_2d(a, b, q);
+
+			if(o1 * o2 < 0 && o3 * o4 < 0) return true;
+
+			// collinear touching
+			auto on_segment = [](const Vec2& s, const Vec2& t, const Vec2& x) {
+				return (x.array() >= s.cwiseMin(t).array()).all() && (x.array() <= s.cwiseMax(t).array()).all();
+			};
+			return (o1 == 0 && on_segment(p, q, a)) || (o2 == 0 && on_segment(p, q, b)) ||
+				(o3 == 0 && on_segment(a, b, p)) || (o4 == 0 && on_segment(a, b, q));
+		}
+
+		// segment in the plane of the triangle: test in the projection that drops the dominant normal axis
+		inline bool coplanar_segment_triangle(const Vec3& p, const Vec3& q, const Vec3& a, const Vec3& b, const Vec3& c) {
+			int axis = 0;
+			const Vec3 normal = (b - a).cross(c - a);
+			if(normal.cwiseAbs().maxCoeff(&axis) == 0) return false; // degenerate triangle
+
+			const int x = (axis + 1) % 3;
+			const int y = (axis + 2) % 3;
+			const Vec2 P(p[x], p[y]), Q(q[x], q[y]), A(a[x], a[y]), B(b[x], b[y]), C(c[x], c[y]);
+
+			auto inside = [&](const Vec2& s) {
+				const int o0 = orient_2d(A, B, s);
+				const int o1 = orient_2d(B, C, s);
+				const int o2 = orient_2d(C, A, s);
+				return (o0 >= 0 && o1 >= 0 && o2 >= 0) || (o0 <= 0 && o1 <= 0 && o2 <= 0);
+			};
+
+			return inside(P) || inside(Q) || segments_intersect_2d(P, Q, A, B) ||
+				segments_intersect_2d(P, Q, B, C) || segments_intersect_2d(P, Q, C, A);
+		}
+
+		// closed segment vs closed triangle
+		inline bool segment_triangle(const Vec3& p, const Vec3& q, const Vec3& a, const Vec3& b, const Vec3& c) {
+			const int sp = orient_3d(a, b, c, p);
+			const int sq = orient_3d(a, b, c, q);
+			if(sp == 0 && sq == 0) return coplanar_segment_triangle(p, q, a, b, c);
+			if(sp == sq) return false;
+
+			// the segment reaches the plane: its line has to pass through the triangle
+			const int s0 = orient_3d(p, q, a, b);
+			const int s1 = orient_3d(p, q, b, c);
+			const int s2 = orient_3d(p, q, c, a);
+			return (s0 >= 0 && s1 >= 0 && s2 >= 0) || (s0 <= 0 && s1 <= 0 && s2 <= 0);
+		}
+
+		// all verts of `o` strictly on one side of the plane of `t`
+		inline bool separated_by_plane(const Vec3* t, const Vec3* o) {
+			const int s0 = orient_3d(t[0], t[1], t[2], o[0]);
+			const int s1 = orient_3d(t[0], t[1], t[2], o[1]);
+			const int s2 = orient_3d(t[0], t[1], t[2], o[2]);
+			return (s0 > 0 && s1 > 0 && s2 > 0) || (s0 < 0 && s1 < 0 && s2 < 0);
+		}
+
+		// the intersection of two triangles is bounded by points where an edge of one crosses the other
+		inline bool triangles_intersect(const Vec3* a, const Vec3* b) {
+			if(separated_by_plane(a, b) || separated_by_plane(b, a)) return false;
+
+			for(int i=0; i<3; ++i) {
+				if(segment_triangle(a[i], a[(i+1) % 3], b[0], b[1], b[2])) return true;
+				if(segment_triangle(b[i], b[(i+1) % 3], a[0], a[1], a[2])) return true;
+			}
+			return false;
+		}
+	}
+
+
+
+	//
+	// polys with vert keys `a` and `b` intersect, other than at shared verts and edges
+	//
+	// polys sharing an edge are never reported. polys sharing a vert are reported if the edge of one
+	// opposite to that vert crosses the other
+	//
+	template<class POSITIONS>
+	bool polys_intersect(const POSITIONS& positions, const int (&a)[3], const int (&b)[3]) {
+		using Vec3 = tri_tri::Vec3;
+
+		int num_shared = 0;
+		int shared_a = -1;
+		int shared_b = -1;
+		for(int i=0; i<3; ++i) {
+			for(int j=0; j<3; ++j) {
+				if(a[i] != b[j]) continue;
+				++num_shared;
+				shared_a = i;
+				shared_b = j;
+			}
+		}
+		if(num_shared >= 2) return false;
+
+		const Vec3 pa[3] = {positions[a[0]], positions[a[1]], positions[a[2]]};
+		const Vec3 pb[3] = {positions[b[0]], positions[b[1]], positions[b[2]]};
+
+		if(num_shared == 1) {
+			return tri_tri::segment_triangle(pa[(shared_a+1) % 3], pa[(shared_a+2) % 3], pb[0], pb[1], pb[2]) ||
+				tri_tri::segment_triangle(pb[(shared_b+1) % 3], pb[(shared_b+2) % 3], pa[0], pa[1], pa[2]);
+		}
+
+		return tri_tri::triangles_intersect(pa, pb);
+	}
+
+}
+
+
+
+
+
+//
+// find pairs of intersecting polys, e.g. as a post-condition of fast_collapse_edges or cap_holes
+// (check_solid only looks at connectivity)
+//
+// - broad phase: polys are binned into a uniform grid (cell size is the mean poly extent) by a
+//   parallel sort of (cell, poly) entries. boxes are compared within a cell, and each pair only in
+//   the cell of the min corner of their boxes' overlap, so no pair is tested twice
+// - narrow phase: triangle-triangle test from orientation signs, in parallel across cells.
+//   neighbors sharing an edge are skipped, neighbors sharing a vert only report a real fold
+//
+// positions are tested in double precision. computed in parallel, see set_num_threads
+//
+//   CHECK( find_self_intersections(mesh).poly_pairs.empty() );
+//
+template<class MESH>
+Self_Intersections find_self_intersections(const MESH& mesh) {
+	static_assert(MESH::POLY_SIZE == 3, "find_self_intersections requires triangles");
+	SMESH_SCOPED_TIMER("find_self_intersections");
+
+	using Vec3 = Eigen::Vector3d;
+	using Cell = Eigen::Vector3i;
+	using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+	using Vecs = std::vector<Vec3, typename MESH::template Allocator<Vec3>>;
+	constexpr int N = MESH::POLY_SIZE;
+
+	Self_Intersections r;
+
+	Ints poly_keys;
+	poly_keys.reserve(mesh.polys.domain_end());
+	for(auto p : mesh.polys) poly_keys.push_back(p.key);
+
+	const int num_polys = (int)poly_keys.size();
+	if(num_polys < 2) return r;
+
+	const auto positions = decode_positions<double>(mesh);
+
+	auto get_verts = [&](int i, int (&verts)[N]) {
+		for(int j=0; j<N; ++j) verts[j] = (int)mesh.polys.raw(poly_keys[i]).verts[j].key;
+	};
+
+
+
+	//
+	// poly boxes, mesh box and mean poly extent
+	//
+	Vecs mins(num_polys);
+	Vecs maxs(num_polys);
+
+	constexpr int box_grain = 16384;
+	const int num_box_threads = smesh::get_num_threads(0, num_polys, box_grain);
+	Vecs thread_mins(num_box_threads, Vec3::Constant( std::numeric_limits<double>::max() ));
+	Vecs thread_maxs(num_box_threads, Vec3::Constant( std::numeric_limits<double>::lowest() ));
+	std::vector<double> thread_extents(num_box_threads, 0);
+
+	smesh::parallel_for_chunks(0, num_polys, box_grain, [&](int thread, int b, int e) {
+		for(int i=b; i<e; ++i) {
+			int verts[N];
+			get_verts(i, verts);
+
+			mins[i] = maxs[i] = positions[verts[0]];
+			for(int j=1; j<N; ++j) {
+				mins[i] = mins[i].cwiseMin(positions[verts[j]]);
+				maxs[i] = maxs[i].cwiseMax(positions[verts[j]]);
+			}
+
+			thread_mins[thread] = thread_mins[thread].cwiseMin(mins[i]);
+			thread_maxs[thread] = thread_maxs[thread].cwiseMax(maxs[i]);
+			thread_extents[thread] += (maxs[i] - mins[i]).maxCoeff();
+		}
+	});
+
+	Vec3 min = thread_mins[0];
+	Vec3 max = thread_maxs[0];
+	double extent_sum = 0;
+	for(int i=0; i<num_box_threads; ++i) {
+		min = min.cwiseMin(thread_mins[i]);
+		max = max.cwiseMax(thread_maxs[i]);
+		extent_sum += thread_extents[i];
+	}
+
+
+
+	//
+	// grid: cell coordinates are packed into 21 bits each
+	//
+	constexpr int max_cells = 1 << 21;
+	double cell_size = std::max(extent_sum / num_polys, (max - min).maxCoeff() / (max_cells - 1));
+	if(!(cell_size > 0)) cell_size = 1;
+
+	auto get_cell = [&](const Vec3& p) {
+		Cell c;
+		for(int j=0; j<3; ++j) {
+			c[j] = std::clamp( (int)std::floor((p[j] - min[j]) / cell_size), 0, max_cells - 1 );
+		}
+		return c;
+	};
+
+	auto get_cell_key = [](const Cell& c) {
+		return uint64_t(c[0]) | uint64_t(c[1]) << 21 | uint64_t(c[2]) << 42;
+	};
+
+	// (cell, poly) entries, sorted by cell
+	std::vector<int64_t, typename MESH::template Allocator<int64_t>> entry_begins(num_polys + 1, 0);
+	smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+		entry_begins[i+1] = (get_cell(maxs[i]) - get_cell(mins[i]) + Cell::Ones()).template cast<int64_t>().prod();
+	});
+	std::partial_sum(entry_begins.begin(), entry_begins.end(), entry_begins.begin());
+	CHECK_LT(entry_begins.back(), INT_MAX) << "find_self_intersections: too many grid entries";
+
+	struct Entry {
+		uint64_t cell;
+		int poly; // index in poly_keys
+	};
+
+	const int num_entries = (int)entry_begins.back();
+	std::vector<Entry, typename MESH::template Allocator<Entry>> entries(num_entries);
+
+	smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+		const Cell lo = get_cell(mins[i]);
+		const Cell hi = get_cell(maxs[i]);
+		int64_t e = entry_begins[i];
+		Cell c;
+		for(c[2]=lo[2]; c[2]<=hi[2]; ++c[2]) {
+			for(c[1]=lo[1]; c[1]<=hi[1]; ++c[1]) {
+				for(c[0]=lo[0]; c[0]<=hi[0]; ++c[0]) entries[e++] = {get_cell_key(c), i};
+			}
+		}
+	});
+
+	smesh::parallel_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.cell < b.cell || (a.cell == b.cell && a.poly < b.poly);
+	});
+
+
+
+	//
+	// narrow phase: each cell is processed by the chunk its first entry is in
+	//
+	constexpr int cell_grain = 4096;
+	const int num_threads = smesh::get_num_threads(0, num_entries, cell_grain);
+	std::vector<std::vector<std::pair<int,int>>> thread_pairs(num_threads);
+	std::vector<int64_t> thread_tested(num_threads, 0);
+
+	smesh::parallel_for_chunks(0, num_entries, cell_grain, [&](int thread, int b, int e) {
+		for(int begin=b; begin<e; ++begin) {
+			const uint64_t cell = entries[begin].cell;
+			if(begin > 0 && entries[begin-1].cell == cell) continue;
+
+			int end = begin + 1;
+			while(end < num_entries && entries[end].cell == cell) ++end;
+
+			for(int i=begin; i<end; ++i) {
+				const int pa = entries[i].poly;
+				for(int j=i+1; j<end; ++j) {
+					const int pb = entries[j].poly;
+
+					if((mins[pa].array() > maxs[pb].array()).any() || (mins[pb].array() > maxs[pa].array()).any()) continue;
+					if(get_cell_key( get_cell(mins[pa].cwiseMax(mins[pb])) ) != cell) continue;
+
+					int va[N], vb[N];
+					get_verts(pa, va);
+					get_verts(pb, vb);
+
+					++thread_tested[thread];
+					if(smesh::internal::polys_intersect(positions, va, vb)) {
+						const int ka = poly_keys[pa];
+						const int kb = poly_keys[pb];
+						thread_pairs[thread].emplace_back(std::min(ka, kb), std::max(ka, kb));
+					}
+				}
+			}
+		}
+	});
+
+	for(int i=0; i<num_threads; ++i) {
+		r.poly_pairs.insert(r.poly_pairs.end(), thread_pairs[i].begin(), thread_pairs[i].end());
+		r.num_tested += thread_tested[i];
+	}
+	std::sort(r.poly_pairs.begin(), r.poly_pairs.end());
+
+	return r;
+}
@@ -10,10 +10,18 @@
 #include <salgo/segment.hpp>
 
 #include "common.hpp"
+#include "instrumentation.hpp"
+#include "pos-codec.hpp"
+#include "layers.hpp"
+#include "parallel.hpp"
 
 
 
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <iterator>
+#include <vector>
 
 
 
@@ -39,7 +47,10 @@ enum class Smesh_Flags {
 	VERTS_ERASABLE =  0x0001,
 	POLYS_ERASABLE =  0x0002,
 	EDGE_LINKS =      0x0004,
-	VERT_POLY_LINKS = 0x0008
+	VERT_POLY_LINKS = 0x0008,
+	JOURNAL =         0x0010,
+	QUANTIZED_POS =   0x0020,
+	HALF_POS =        0x0040
 };
 
 namespace {
@@ -47,6 +58,9 @@ namespace {
 	constexpr auto POLYS_ERASABLE  = Smesh_Flags::POLYS_ERASABLE;
 	constexpr auto EDGE_LINKS      = Smesh_Flags::EDGE_LINKS;
 	constexpr auto VERT_POLY_LINKS = Smesh_Flags::VERT_POLY_LINKS;
+	constexpr auto JOURNAL         = Smesh_Flags::JOURNAL;
+	constexpr auto QUANTIZED_POS   = Smesh_Flags::QUANTIZED_POS;
+	constexpr auto HALF_POS        = Smesh_Flags::HALF_POS;
 };
 
 
@@ -54,6 +68,13 @@ ENABLE_BITWISE_OPERATORS( Smesh_Flags );
 
 
 
+// special props (see README), detected by io and other algorithms
+GENERATE_HAS_MEMBER(normal);
+GENERATE_HAS_MEMBER(color);
+GENERATE_HAS_MEMBER(texcoords);
+
+
+
 
 
 
@@ -70,11 +91,33 @@ namespace internal {
 
 
 
+	// edge props, stored in the half-edge that owns the edge
+	template<bool, class MESH> struct Add_Member_edge_props {
+		typename MESH::Edge_Props edge_props;
+	};
+	template<      class MESH> struct Add_Member_edge_props <false, MESH> {};
+
+
+
 	// links from verts to poly-verts
 	// optim TODO: replace with small object optimization vector
-	template<bool, class MESH> struct Add_Member_poly_links { std::unordered_set<typename MESH::H_Poly_Vert> poly_links; };
+	template<bool, class MESH> struct Add_Member_poly_links { typename MESH::Poly_Links_Set poly_links; };
 	template<      class MESH> struct Add_Member_poly_links <false, MESH> {};
 
+
+
+	// index into mesh.indexed_vert_props
+	template<bool, class MESH> struct Add_Member_indexed_props_key { int32_t indexed_props_key = -1; };
+	template<      class MESH> struct Add_Member_indexed_props_key <false, MESH> {};
+
+
+
+	// SMESH_PROPS::Indexed_Vert is optional
+	template<class PROPS, class = void> struct Get_Indexed_Vert_Props { using Type = void; };
+	template<class PROPS> struct Get_Indexed_Vert_Props<PROPS, std::void_t<typename PROPS::Indexed_Vert>> {
+		using Type = typename PROPS::Indexed_Vert;
+	};
+
 }
 
 
@@ -133,6 +176,10 @@ struct g_H_Poly_Vert{
 	bool operator!=(const g_H_Poly_Vert& o) const {
 		return !(*this == o);
 	}
+
+	bool operator<(const g_H_Poly_Vert& o) const {
+		return poly < o.poly || (poly == o.poly && vert < o.vert);
+	}
 };
 
 
@@ -173,6 +220,10 @@ struct g_H_Poly_Edge {
 	bool operator!=(const g_H_Poly_Edge& o) const {
 		return !(*this == o);
 	}
+
+	bool operator<(const g_H_Poly_Edge& o) const {
+		return poly < o.poly || (poly == o.poly && edge < o.edge);
+	}
 };
 
 
@@ -185,6 +236,8 @@ namespace {
 		using Vert = void;
 		using Poly = void;
 		using Poly_Vert = void;
+		using Edge = void;
+		using Indexed_Vert = void;
 	};
 
 	constexpr Smesh_Flags _default__smesh_flags =
@@ -198,11 +251,13 @@ namespace {
 // a triangle mesh structure with edge links (half-edges)
 //
 // - lazy removal of vertices or polygons (see bool del flag). TODO: remap support when no lazy removal
+// - ALLOCATOR is rebound for every container owned by the mesh (see allocator.hpp for a per-job arena)
 //
 template <
 	class SCALAR,
 	auto FLAGS = _default__smesh_flags,
-	class SMESH_PROPS = _Default__Smesh_Props
+	class SMESH_PROPS = _Default__Smesh_Props,
+	class ALLOCATOR = std::allocator<char>
 >
 class Smesh {
 
@@ -217,22 +272,68 @@ private:
 public:
 	static constexpr Smesh_Flags Flags = FLAGS;
 
+	// allocator for containers owned by the mesh, and for algorithms' temporaries
+	template<class T>
+	using Allocator = typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<T>;
+
+	// runtime attribute layers (see layers.hpp)
+	using Layers = internal::Layers<ALLOCATOR>;
+	template<class T> using Layer = typename Layers::template Layer<T>;
+
 	using Vert_Props =      Type_Or_Void< typename SMESH_PROPS::Vert >;
 	using Poly_Props =      Type_Or_Void< typename SMESH_PROPS::Poly >;
 	using Poly_Vert_Props = Type_Or_Void< typename SMESH_PROPS::Poly_Vert >;
+	using Edge_Props =      Type_Or_Void< typename SMESH_PROPS::Edge >;
+
+	// vertex props shared by poly-verts, see mesh.indexed_vert_props
+	using Indexed_Vert_Props = Type_Or_Void< typename internal::Get_Indexed_Vert_Props<SMESH_PROPS>::Type >;
 
 	static constexpr bool Has_Edge_Links = bool(Flags & EDGE_LINKS);
 	static constexpr bool Has_Vert_Poly_Links = bool(Flags & VERT_POLY_LINKS);
+	static constexpr bool Has_Journal = bool(Flags & JOURNAL);
 
 	static constexpr bool Has_Vert_Props = !std::is_same_v<Vert_Props, Void>;
 	static constexpr bool Has_Poly_Props = !std::is_same_v<Poly_Props, Void>;
 	static constexpr bool Has_Poly_Vert_Props = !std::is_same_v<Poly_Vert_Props, Void>;
+	static constexpr bool Has_Edge_Props = !std::is_same_v<Edge_Props, Void>;
+	static constexpr bool Has_Indexed_Vert_Props = !std::is_same_v<Indexed_Vert_Props, Void>;
 
 
 	static const int POLY_SIZE = 3;
 
 
 
+	static constexpr bool Has_Quantized_Pos = bool(Flags & QUANTIZED_POS);
+	static constexpr bool Has_Half_Pos = bool(Flags & HALF_POS);
+	static constexpr bool Has_Encoded_Pos = Has_Quantized_Pos || Has_Half_Pos;
+	static_assert(!(Has_Quantized_Pos && Has_Half_Pos), "QUANTIZED_POS and HALF_POS are exclusive");
+
+	// vertex position storage (see pos-codec.hpp), `Pos` is always the decoded type
+	using Pos_Codec = std::conditional_t<Has_Quantized_Pos, internal::Quantized_Pos_Codec<Pos>,
+		std::conditional_t<Has_Half_Pos, internal::Half_Pos_Codec<Pos>, internal::Full_Pos_Codec<Pos>>>;
+	using Stored_Pos = typename Pos_Codec::Stored;
+
+	// type of `pos` in vertex accessors: Proxy to Pos, or decoding proxy
+	template<Const_Flag C>
+	using Pos_Proxy = std::conditional_t<Has_Encoded_Pos,
+		internal::Encoded_Pos_Proxy<Pos_Codec, Pos, C>, Proxy<Pos,C>>;
+
+	// type of `pos` in poly-vert accessors: reference to Pos, or decoding proxy
+	template<Const_Flag C>
+	using Pos_Ref = std::conditional_t<Has_Encoded_Pos,
+		internal::Encoded_Pos_Proxy<Pos_Codec, Pos, C>, Const<Pos,C>&>;
+
+private:
+	template<Const_Flag C>
+	static Pos_Ref<C> get_pos_ref(Const<Smesh,C>& m, Const<Stored_Pos,C>& stored) {
+		if constexpr(Has_Encoded_Pos) return Pos_Ref<C>(m.verts.pos_codec, stored);
+		else return stored;
+	}
+
+public:
+
+
+
 
 
 
@@ -268,6 +369,9 @@ public:
 	using H_Poly_Vert = g_H_Poly_Vert;
 	using H_Poly_Edge = g_H_Poly_Edge;
 
+	using Poly_Links_Set = std::unordered_set<H_Poly_Vert,
+		std::hash<H_Poly_Vert>, std::equal_to<H_Poly_Vert>, Allocator<H_Poly_Vert>>;
+
 
 
 
@@ -339,7 +443,7 @@ public:
 	};
 
 	template<Const_Flag C>
-	using I_Poly_Link = salgo::internal::Iterator< A_Poly_Vert<C>, std::unordered_set<H_Poly_Vert>, C,
+	using I_Poly_Link = salgo::internal::Iterator< A_Poly_Vert<C>, Poly_Links_Set, C,
 		Const<Smesh,C>&, A_Poly_Vert_From_Poly_Link_Iter<C> >;
 
 
@@ -373,17 +477,24 @@ private:
 
 		using Mesh = Smesh;
 
-		Proxy<Pos,C> pos;
+		Pos_Proxy<C> pos;
 		Proxy<Vert_Props,C> props;
 
 		A_Poly_Links<C> poly_links;
 
+		Context mesh;
+
 		// add erase that erases neighbor polys too?
+		void erase() {
+			if constexpr(Has_Journal) mesh.journal.log_erase_vert(this->key);
+			BASE::erase();
+		}
 
 		A_Vert_Template( Context m, Const<Owner,C>& o, const int i) : BASE(o, i),
-				pos( o.raw(i).pos ),
+				pos( get_pos_ref<C>(m, o.raw(i).pos) ),
 				props( o.raw(i) ),
-				poly_links(m, i) {}
+				poly_links(m, i),
+				mesh(m) {}
 	};
 
 
@@ -400,6 +511,73 @@ private:
 	> :: BUILD;
 
 	class Verts_Storage : public Verts_Storage_Base {
+	public:
+		// quantization bounds etc. (see set_pos_bounds)
+		Pos_Codec pos_codec;
+
+		// runtime attribute layers, indexed by vert key (see layers.hpp)
+		Layers layers = Layers(1);
+
+		// encodes positions if needed
+		template<class... ARGS>
+		auto add(ARGS&&... args) {
+			auto r = [&]() {
+				if constexpr(!Has_Encoded_Pos || sizeof...(ARGS) == 0) {
+					return Verts_Storage_Base::add(std::forward<ARGS>(args)...);
+				}
+				else if constexpr(sizeof...(ARGS) == 1 && (std::is_same_v<std::decay_t<ARGS>, Stored_Pos> && ...)) {
+					return Verts_Storage_Base::add(std::forward<ARGS>(args)...);
+				}
+				else {
+					return Verts_Storage_Base::add( pos_codec.encode( Pos(std::forward<ARGS>(args)...) ) );
+				}
+			}();
+
+			layers.on_add(this->domain_end());
+			return r;
+		}
+
+		// add `num_verts` verts from flat `xyz` array (x0,y0,z0, x1,y1,z1, ...)
+		// returns key of the first one, the rest follow
+		template<class T>
+		int add_range(const T* xyz, int num_verts) {
+			return add_range_impl(num_verts, [xyz](int i) {
+				return Pos( Scalar(xyz[i*3 + 0]), Scalar(xyz[i*3 + 1]), Scalar(xyz[i*3 + 2]) );
+			});
+		}
+
+		// add verts from range of positions (anything `Pos` is constructible from)
+		template<class ITER>
+		int add_range(ITER begin, ITER end) {
+			using Category = typename std::iterator_traits<ITER>::iterator_category;
+			if constexpr(std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+				return add_range_impl((int)(end - begin), [begin](int i) { return Pos( begin[i] ); });
+			}
+			else {
+				std::vector<Pos, Allocator<Pos>> positions;
+				for(auto it = begin; it != end; ++it) positions.emplace_back(*it);
+				return add_range(positions.begin(), positions.end());
+			}
+		}
+
+	private:
+		// reserve once, construct serially, then fill (and encode) positions in parallel
+		template<class GET_POS>
+		int add_range_impl(int n, const GET_POS& get_pos) {
+			SMESH_SCOPED_TIMER("verts.add_range");
+
+			const int first = this->domain_end();
+			this->reserve(first + n);
+			for(int i=0; i<n; ++i) Verts_Storage_Base::add();
+
+			smesh::parallel_for(0, n, 16384, [&](int i) {
+				this->raw(first + i).pos = pos_codec.encode( get_pos(i) );
+			});
+
+			layers.on_add(this->domain_end());
+			return first;
+		}
+
 		Verts_Storage(Smesh& m) : Verts_Storage_Base(m) {}
 		friend Smesh;
 	};
@@ -441,8 +619,6 @@ public:
 		Proxy<Poly_Props,C> props;
 
 		void erase() {
-			BASE::erase();
-
 			// unlink edges
 			if constexpr(bool(Flags & EDGE_LINKS)) {
 				for(auto pe : edges) {
@@ -453,19 +629,30 @@ public:
 			// unlink vertices
 			if constexpr(bool(Flags & VERT_POLY_LINKS)) {
 				for(auto pv : verts) {
+					if constexpr(Has_Journal) mesh.journal.log_erase_poly_link(pv.key, pv.handle);
 					pv.vert.val().poly_links.erase(pv.handle);
+					SMESH_COUNT(VERT_POLY_LINKS_REMOVED, 1);
+					SMESH_COUNT(HASH_PROBES, 1);
 				}
 			}
+
+			if constexpr(Has_Journal) mesh.journal.log_erase_poly(this->key);
+
+			BASE::erase();
+			SMESH_COUNT(POLYS_ERASED, 1);
 		}
 
 		Const<A_Poly_Verts<C>,C> verts;
 		Const<A_Poly_Edges<C>,C> edges;
 
+		Context mesh;
+
 
 		A_Poly_Template( Context m, Const<Owner,C>& o, const int i ) : BASE ( o, i ),
 				props( o.raw(i) ),
 				verts( m, i ),
-				edges( m, i ) {
+				edges( m, i ),
+				mesh( m ) {
 			//DCHECK_NE(raw().verts[0].idx, raw().verts[1].idx) << "polygon is degenerate";
 			//DCHECK_NE(raw().verts[1].idx, raw().verts[2].idx) << "polygon is degenerate";
 			//DCHECK_NE(raw().verts[2].idx, raw().verts[0].idx) << "polygon is degenerate";
@@ -487,6 +674,58 @@ private:
 	> :: BUILD;
 
 	class Polys_Storage : public Polys_Storage_Base {
+	public:
+		// runtime attribute layers, indexed by poly key (see layers.hpp)
+		Layers layers = Layers(1);
+
+		// runtime attribute layers, indexed by `poly_key * POLY_SIZE + vert_idx`
+		Layers corner_layers = Layers(POLY_SIZE);
+
+		template<class... ARGS>
+		auto add(ARGS&&... args) {
+			auto r = Polys_Storage_Base::add(std::forward<ARGS>(args)...);
+			layers.on_add(this->domain_end());
+			corner_layers.on_add(this->domain_end());
+			return r;
+		}
+
+		// add `num_polys` polys from flat `indices` array (a0,b0,c0, a1,b1,c1, ...) of vert keys
+		// returns key of the first one, the rest follow
+		//
+		// `add_vert_poly_links`: link new poly-verts to their verts (VERT_POLY_LINKS meshes),
+		// instead of calling compute_vert_poly_links later
+		template<class T>
+		int add_range(const T* indices, int num_polys, bool add_vert_poly_links = false) {
+			SMESH_SCOPED_TIMER("polys.add_range");
+
+			using Key = typename Verts_Storage::Key;
+
+			// reserve once, construct serially, then fill vert keys in parallel (like verts.add_range)
+			const int first = this->domain_end();
+			this->reserve(first + num_polys);
+			for(int i=0; i<num_polys; ++i) Polys_Storage_Base::add(Key(), Key(), Key());
+
+			smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+				auto& verts = this->raw(first + i).verts;
+				for(int j=0; j<POLY_SIZE; ++j) verts[j].key = Key( indices[i*POLY_SIZE + j] );
+			});
+
+			// serial: polys share their verts' link sets
+			if constexpr(bool(Flags & VERT_POLY_LINKS)) if(add_vert_poly_links) {
+				for(int i=0; i<num_polys; ++i) {
+					for(auto pv : (*this)[first + i].verts) pv.vert.poly_links.add( pv );
+				}
+			}
+
+			DCHECK(!add_vert_poly_links || bool(Flags & VERT_POLY_LINKS))
+				<< "polys.add_range: mesh has no VERT_POLY_LINKS";
+
+			layers.on_add(this->domain_end());
+			corner_layers.on_add(this->domain_end());
+			return first;
+		}
+
+	private:
 		Polys_Storage(Smesh& m) : Polys_Storage_Base(m) {}
 		friend Smesh;
 	};
@@ -511,6 +750,145 @@ public:
 
 
 
+	//
+	// EDGES
+	//
+	// each edge once: half-edges that own their edge (see A_Poly_Edge::owns_edge)
+	//
+
+public:
+	template<Const_Flag C>
+	class I_Edge {
+	public:
+		auto operator*() const {
+			return A_Poly_Edge<C>( mesh, (*poly).key, edge );
+		}
+
+		auto& operator++() {
+			++edge;
+			skip();
+			return *this;
+		}
+
+		bool operator==(const I_Edge& o) const { return !(poly != o.poly) && edge == o.edge; }
+		bool operator!=(const I_Edge& o) const { return !(*this == o); }
+
+	private:
+		using Poly_Iter = decltype( std::declval<Const<Polys_Storage,C>&>().begin() );
+
+		I_Edge( Const<Smesh,C>& m, const Poly_Iter& p, const Poly_Iter& pe ) : mesh(m), poly(p), poly_end(pe) {
+			skip();
+		}
+
+		void skip() {
+			for(;;) {
+				if(edge == POLY_SIZE) {
+					++poly;
+					edge = 0;
+				}
+
+				if(!(poly != poly_end)) return;
+
+				int p = (*poly).key;
+				if(owns_edge( mesh.polys.raw(p).verts[edge], {p, edge} )) return;
+
+				++edge;
+			}
+		}
+
+		Const<Smesh,C>& mesh;
+		Poly_Iter poly;
+		const Poly_Iter poly_end;
+		decltype(H_Poly_Edge::edge) edge = 0;
+
+		friend Smesh;
+	};
+
+
+	class Edges {
+	public:
+		auto begin()       { return I_Edge<MUTAB>( smesh, smesh.polys.begin(), smesh.polys.end() ); }
+		auto end()         { return I_Edge<MUTAB>( smesh, smesh.polys.end(),   smesh.polys.end() ); }
+
+		auto begin() const { return I_Edge<CONST>( std::as_const(smesh), std::as_const(smesh).polys.begin(), std::as_const(smesh).polys.end() ); }
+		auto end()   const { return I_Edge<CONST>( std::as_const(smesh), std::as_const(smesh).polys.end(),   std::as_const(smesh).polys.end() ); }
+
+	private:
+		Edges(Smesh& m) : smesh(m) {}
+		Smesh& smesh;
+
+		friend Smesh;
+	};
+
+	Edges edges = Edges(*this);
+
+
+
+
+	//
+	// INDEXED VERT PROPS
+	//
+	// table of vertex props referenced by poly-verts (`pv.indexed_props_key()`), e.g. texcoords:
+	// poly-verts of a vertex that are on the same side of a seam share one entry
+	//
+	// entries are never modified by mesh algorithms, only appended (see merge_verts), so old entries
+	// stay valid for undo. use compact_indexed_vert_props to drop unreferenced ones
+	//
+public:
+	using Indexed_Vert_Props_Table = std::conditional_t<Has_Indexed_Vert_Props,
+		std::vector<Indexed_Vert_Props, Allocator<Indexed_Vert_Props>>, Void>;
+
+	Indexed_Vert_Props_Table indexed_vert_props;
+
+
+
+public:
+	Smesh() {}
+
+	// `edges` and `journal` refer to their parent mesh, so they're not copied. the journal history
+	// is bound to the elements it was recorded on: it starts empty in copies, and is cleared when
+	// the elements are replaced by assignment or moved out (not allowed in an open transaction)
+	Smesh(const Smesh& o) : verts(o.verts), polys(o.polys), indexed_vert_props(o.indexed_vert_props) {}
+	Smesh(Smesh&& o) : verts(std::move(o.verts)), polys(std::move(o.polys)),
+			indexed_vert_props(std::move(o.indexed_vert_props)) {
+		o.clear_journal();
+	}
+
+	Smesh& operator=(const Smesh& o) {
+		clear_journal();
+		verts = o.verts;
+		polys = o.polys;
+		indexed_vert_props = o.indexed_vert_props;
+		return *this;
+	}
+
+	Smesh& operator=(Smesh&& o) {
+		clear_journal();
+		o.clear_journal();
+		verts = std::move(o.verts);
+		polys = std::move(o.polys);
+		indexed_vert_props = std::move(o.indexed_vert_props);
+		return *this;
+	}
+
+private:
+	void clear_journal() {
+		if constexpr(Has_Journal) journal.clear();
+	}
+
+public:
+
+
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -527,11 +905,13 @@ private:
 		template<class... Args>
 		Vert(Args&&... args) : pos( std::forward<Args>(args)... ) {}
 		
-		Pos pos = {0,0,0};
+		Stored_Pos pos = Pos_Codec::get_zero();
 	};
 	
 	struct Poly_Vert : public Poly_Vert_Props,
-			public internal::Add_Member_edge_link<bool(Flags & EDGE_LINKS), Smesh> { // vertex and corresponidng edge
+			public internal::Add_Member_edge_link<bool(Flags & EDGE_LINKS), Smesh>,
+			public internal::Add_Member_edge_props<Has_Edge_Props, Smesh>,
+			public internal::Add_Member_indexed_props_key<Has_Indexed_Vert_Props, Smesh> { // vertex and corresponidng edge
 		typename Verts_Storage::Key key; // vertex index
 	};
 	
@@ -569,6 +949,425 @@ private:
 
 
 
+
+
+
+
+	//
+	// JOURNAL
+	//
+	// opt-in (JOURNAL flag) log of inverse operations, for undo/redo of mesh edits:
+	//
+	//   mesh.journal.begin();
+	//   merge_verts(a, b, 0.5);
+	//   mesh.journal.commit(); // or rollback()
+	//   ...
+	//   mesh.journal.undo();
+	//   mesh.journal.redo();
+	//
+	// - logged: verts/polys add and erase, edge link/unlink, vert-poly links add/clear
+	// - writes through `pos`, `props` and `key` proxies are not seen: call touch_vert() / touch_poly_vert()
+	//   before them (merge_verts and collapse_edge do)
+	// - adds are detected by storage growth, and verts/polys restored by undo/redo get new keys
+	//   (erased keys are never reused). use resolve_vert() / resolve_poly() to update old keys
+	// - edits made outside of transactions are not logged; call clear() after them
+	// - memory and time are proportional to the edit size
+	//
+public:
+	class Journal {
+	public:
+		void begin() {
+			CHECK(!recording) << "Journal::begin(): transaction already open";
+
+			// new transaction drops redo history
+			truncate( get_state(num_applied) );
+			transactions.resize(num_applied);
+
+			verts_end = smesh.verts.domain_end();
+			polys_end = smesh.polys.domain_end();
+			recording = true;
+		}
+
+		void commit() {
+			CHECK(recording) << "Journal::commit(): no open transaction";
+			sync();
+			recording = false;
+
+			transactions.push_back({(int)records.size(), (int)vert_pool.size(), (int)poly_pool.size()});
+			++num_applied;
+		}
+
+		void rollback() {
+			CHECK(recording) << "Journal::rollback(): no open transaction";
+			sync();
+			recording = false;
+
+			auto state = get_state(num_applied);
+			for(int i=(int)records.size()-1; i>=state.records_end; --i) apply(records[i], false);
+			truncate(state);
+			dead_poly_links.clear();
+		}
+
+		bool can_undo() const { return num_applied > 0; }
+		bool can_redo() const { return num_applied < (int)transactions.size(); }
+
+		bool undo() {
+			CHECK(!recording) << "Journal::undo(): transaction open";
+			if(!can_undo()) return false;
+
+			int begin = get_state(num_applied-1).records_end;
+			for(int i=transactions[num_applied-1].records_end-1; i>=begin; --i) apply(records[i], false);
+			dead_poly_links.clear();
+
+			--num_applied;
+			return true;
+		}
+
+		bool redo() {
+			CHECK(!recording) << "Journal::redo(): transaction open";
+			if(!can_redo()) return false;
+
+			int end = transactions[num_applied].records_end;
+			for(int i=get_state(num_applied).records_end; i<end; ++i) apply(records[i], true);
+			dead_poly_links.clear();
+
+			++num_applied;
+			return true;
+		}
+
+		// forget all history
+		void clear() {
+			CHECK(!recording) << "Journal::clear(): transaction open";
+			records.clear();
+			vert_pool.clear();
+			poly_pool.clear();
+			transactions.clear();
+			num_applied = 0;
+			vert_remap.clear();
+			poly_remap.clear();
+		}
+
+		bool is_recording() const { return recording; }
+
+		// current key of vert/poly that had `key` when it was logged
+		int resolve_vert(int key) const { return resolve(vert_remap, key); }
+		int resolve_poly(int key) const { return resolve(poly_remap, key); }
+
+		// call before modifying vert `pos` or `props`
+		void touch_vert(int key) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::SET_VERT, key, -1, -1, -1, (int)vert_pool.size()});
+			vert_pool.push_back( get_vert_snapshot(key) );
+		}
+
+		// call before modifying poly-vert `key`
+		void touch_poly_vert(const H_Poly_Vert& h) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::SET_POLY_VERT_KEY, h.poly, h.vert, smesh.polys.raw(h.poly).verts[h.vert].key, -1, -1});
+		}
+
+		// call before modifying poly-vert `indexed_props_key`
+		void touch_poly_vert_indexed_props(const H_Poly_Vert& h) {
+			if constexpr(Has_Indexed_Vert_Props) {
+				if(!recording) return;
+				sync();
+				records.push_back({Op::SET_INDEXED_PROPS_KEY, h.poly, h.vert,
+					smesh.polys.raw(h.poly).verts[h.vert].indexed_props_key, -1, -1});
+			}
+		}
+
+	public:
+		// called by accessors
+
+		void log_erase_vert(int key) {
+			if(!recording) return;
+			sync();
+			if constexpr(Has_Vert_Poly_Links) {
+				DCHECK(smesh.verts.raw(key).poly_links.empty()) << "Journal: erasing vert with poly links";
+			}
+			records.push_back({Op::ERASE_VERT, key, -1, -1, -1, (int)vert_pool.size()});
+			vert_pool.push_back( get_vert_snapshot(key) );
+		}
+
+		// after unlinking its edges and verts
+		void log_erase_poly(int key) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::ERASE_POLY, key, -1, -1, -1, (int)poly_pool.size()});
+			poly_pool.push_back( get_poly_snapshot(key) );
+		}
+
+		void log_link(const H_Poly_Edge& a, const H_Poly_Edge& b) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::LINK, a.poly, a.edge, b.poly, b.edge, -1});
+		}
+
+		void log_unlink(const H_Poly_Edge& a, const H_Poly_Edge& b) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::UNLINK, a.poly, a.edge, b.poly, b.edge, -1});
+		}
+
+		void log_add_poly_link(int vert, const H_Poly_Vert& h) {
+			if(!recording) return;
+			sync();
+			records.push_back({Op::ADD_POLY_LINK, vert, -1, h.poly, h.vert, -1});
+		}
+
+		// logged only if present
+		void log_erase_poly_link(int vert, const H_Poly_Vert& h) {
+			if(!recording) return;
+			if constexpr(Has_Vert_Poly_Links) {
+				if(!smesh.verts.raw(vert).poly_links.count(h)) return;
+			}
+			sync();
+			records.push_back({Op::ERASE_POLY_LINK, vert, -1, h.poly, h.vert, -1});
+		}
+
+	private:
+		enum class Op : int8_t {
+			ADD_VERTS,         // key..other
+			ADD_POLYS,         // key..other
+			ERASE_VERT,        // key
+			ERASE_POLY,        // key
+			SET_VERT,          // key
+			SET_POLY_VERT_KEY, // (key,idx), other = vert key
+			SET_INDEXED_PROPS_KEY, // (key,idx), other = indexed props key
+			LINK,              // (key,idx) - (other,other_idx)
+			UNLINK,            // (key,idx) - (other,other_idx)
+			ADD_POLY_LINK,     // vert key, (other,other_idx)
+			ERASE_POLY_LINK    // vert key, (other,other_idx)
+		};
+
+		struct Record {
+			Op op;
+			int key;
+			int idx;
+			int other;
+			int other_idx;
+			int data; // first vert_pool or poly_pool entry
+		};
+
+		struct Vert_Snapshot {
+			Stored_Pos pos;
+			Vert_Props props;
+		};
+
+		struct State {
+			int records_end = 0;
+			int vert_pool_end = 0;
+			int poly_pool_end = 0;
+		};
+
+		using Remap = std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+			Allocator<std::pair<const int, int>>>;
+
+		static int resolve(const Remap& remap, int key) {
+			for(auto it = remap.find(key); it != remap.end(); it = remap.find(key)) key = it->second;
+			return key;
+		}
+
+		State get_state(int num_transactions) const {
+			return num_transactions ? transactions[num_transactions-1] : State();
+		}
+
+		void truncate(const State& state) {
+			records.resize(state.records_end);
+			vert_pool.resize(state.vert_pool_end);
+			poly_pool.erase(poly_pool.begin() + state.poly_pool_end, poly_pool.end());
+		}
+
+		// log adds since last record
+		void sync() {
+			const int v_end = smesh.verts.domain_end();
+			if(v_end > verts_end) {
+				records.push_back({Op::ADD_VERTS, verts_end, -1, v_end, -1, (int)vert_pool.size()});
+				vert_pool.resize(vert_pool.size() + v_end - verts_end); // filled on undo
+				verts_end = v_end;
+			}
+
+			const int p_end = smesh.polys.domain_end();
+			if(p_end > polys_end) {
+				records.push_back({Op::ADD_POLYS, polys_end, -1, p_end, -1, (int)poly_pool.size()});
+				poly_pool.insert(poly_pool.end(), p_end - polys_end, Poly(-1,-1,-1)); // filled on undo
+				polys_end = p_end;
+			}
+		}
+
+		Vert_Snapshot get_vert_snapshot(int key) const {
+			const auto& v = smesh.verts.raw(key);
+			return {v.pos, static_cast<const Vert_Props&>(v)};
+		}
+
+		// edge links are restored by their own records
+		Poly get_poly_snapshot(int key) const {
+			Poly p = smesh.polys.raw(key);
+			if constexpr(Has_Edge_Links) {
+				for(auto& pv : p.verts) pv.edge_link.poly = -1;
+			}
+			return p;
+		}
+
+		void add_vert(int key, const Vert_Snapshot& snapshot) {
+			auto v = smesh.verts.add(snapshot.pos);
+			static_cast<Vert_Props&>(smesh.verts.raw(v.key)) = snapshot.props;
+			vert_remap[resolve_vert(key)] = v.key;
+		}
+
+		void add_poly(int key, const Poly& snapshot) {
+			Poly p = snapshot;
+			for(auto& pv : p.verts) pv.key = resolve_vert(pv.key);
+			auto new_key = smesh.polys.add(std::as_const(p)).key;
+			auto old_key = resolve_poly(key);
+			poly_remap[old_key] = new_key;
+
+			// vert-poly links restored before the poly itself (e.g. merge_verts clears them after erasing polys)
+			if constexpr(Has_Vert_Poly_Links) {
+				auto range = dead_poly_links.equal_range(old_key);
+				for(auto it = range.first; it != range.second; ++it) {
+					auto& set = smesh.verts.raw(it->second.first).poly_links;
+					set.erase({old_key, it->second.second});
+					set.insert({new_key, it->second.second});
+				}
+				dead_poly_links.erase(range.first, range.second);
+			}
+		}
+
+		void erase_vert(int key, Vert_Snapshot& snapshot) {
+			key = resolve_vert(key);
+			snapshot = get_vert_snapshot(key);
+			smesh.verts[key].erase();
+		}
+
+		void erase_poly(int key, Poly& snapshot) {
+			key = resolve_poly(key);
+			snapshot = get_poly_snapshot(key);
+			smesh.polys[key].erase();
+		}
+
+		void set_poly_link(const Record& r, bool add) {
+			if constexpr(Has_Vert_Poly_Links) {
+				auto& set = smesh.verts.raw(resolve_vert(r.key)).poly_links;
+				H_Poly_Vert h{resolve_poly(r.other), decltype(H_Poly_Vert::vert)(r.other_idx)};
+				if(add) {
+					set.insert(h);
+					dead_poly_links.insert({h.poly, {resolve_vert(r.key), h.vert}}); // if the poly is restored later
+				}
+				else set.erase(h);
+			}
+		}
+
+		void set_link(const Record& r, bool link) {
+			if constexpr(Has_Edge_Links) {
+				auto a = smesh.polys[ resolve_poly(r.key) ].edges[ r.idx ];
+				if(link) a.link( smesh.polys[ resolve_poly(r.other) ].edges[ r.other_idx ] );
+				else a.unlink();
+			}
+		}
+
+		// forward: redo, otherwise undo
+		void apply(Record& r, bool forward) {
+			switch(r.op) {
+			case Op::ADD_VERTS:
+				if(forward) for(int k=r.key; k<r.other; ++k) add_vert(k, vert_pool[r.data + k - r.key]);
+				else for(int k=r.other-1; k>=r.key; --k) erase_vert(k, vert_pool[r.data + k - r.key]);
+				break;
+
+			case Op::ADD_POLYS:
+				if(forward) for(int k=r.key; k<r.other; ++k) add_poly(k, poly_pool[r.data + k - r.key]);
+				else for(int k=r.other-1; k>=r.key; --k) erase_poly(k, poly_pool[r.data + k - r.key]);
+				break;
+
+			case Op::ERASE_VERT:
+				if(forward) erase_vert(r.key, vert_pool[r.data]);
+				else add_vert(r.key, vert_pool[r.data]);
+				break;
+
+			case Op::ERASE_POLY:
+				if(forward) erase_poly(r.key, poly_pool[r.data]);
+				else add_poly(r.key, poly_pool[r.data]);
+				break;
+
+			case Op::SET_VERT: {
+				auto key = resolve_vert(r.key);
+				auto snapshot = get_vert_snapshot(key);
+				smesh.verts.raw(key).pos = vert_pool[r.data].pos;
+				static_cast<Vert_Props&>(smesh.verts.raw(key)) = vert_pool[r.data].props;
+				vert_pool[r.data] = snapshot;
+				break;
+			}
+
+			case Op::SET_POLY_VERT_KEY: {
+				auto& key = smesh.polys.raw( resolve_poly(r.key) ).verts[ r.idx ].key;
+				int old = resolve_vert(r.other);
+				r.other = key;
+				key = old;
+				break;
+			}
+
+			case Op::SET_INDEXED_PROPS_KEY: {
+				if constexpr(Has_Indexed_Vert_Props) {
+					auto& key = smesh.polys.raw( resolve_poly(r.key) ).verts[ r.idx ].indexed_props_key;
+					std::swap(key, r.other);
+				}
+				break;
+			}
+
+			case Op::LINK:            set_link(r, forward); break;
+			case Op::UNLINK:          set_link(r, !forward); break;
+			case Op::ADD_POLY_LINK:   set_poly_link(r, forward); break;
+			case Op::ERASE_POLY_LINK: set_poly_link(r, !forward); break;
+			}
+		}
+
+	private:
+		Journal(Smesh& m) : smesh(m) {}
+		Smesh& smesh;
+
+		bool recording = false;
+		int verts_end = 0;
+		int polys_end = 0;
+
+		std::vector<Record, Allocator<Record>> records;
+		std::vector<Vert_Snapshot, Allocator<Vert_Snapshot>> vert_pool;
+		std::vector<Poly, Allocator<Poly>> poly_pool;
+
+		std::vector<State, Allocator<State>> transactions;
+		int num_applied = 0;
+
+		Remap vert_remap;
+		Remap poly_remap;
+
+		// poly key -> (vert, corner) of vert-poly links added during current undo/redo
+		std::unordered_multimap<int, std::pair<int,int8_t>, std::hash<int>, std::equal_to<int>,
+			Allocator<std::pair<const int, std::pair<int,int8_t>>>> dead_poly_links;
+
+		friend Smesh;
+	};
+
+private:
+	class No_Journal {
+		No_Journal(Smesh&) {}
+		friend Smesh;
+	};
+
+	using Journal_Member = std::conditional_t<Has_Journal, Journal, No_Journal>;
+
+public:
+	Journal_Member journal = Journal_Member(*this);
+
+
+
+
+
+
+
+
+
+
 
 
 
@@ -581,7 +1380,11 @@ public:
 			DCHECK(smesh.verts.raw(vert).poly_links.find(pv.handle) == smesh.verts.raw(vert).poly_links.end())
 				<< "handle already in set";
 
+			if constexpr(Has_Journal) smesh.journal.log_add_poly_link(vert, pv.handle);
+
 			smesh.verts.raw(vert).poly_links.insert(pv.handle);
+			SMESH_COUNT(VERT_POLY_LINKS_CREATED, 1);
+			SMESH_COUNT(HASH_PROBES, 1);
 		}
 
 		int size() const {
@@ -593,6 +1396,11 @@ public:
 		}
 
 		void clear() const {
+			if constexpr(Has_Journal) {
+				for(const auto& h : smesh.verts.raw(vert).poly_links) smesh.journal.log_erase_poly_link(vert, h);
+			}
+
+			SMESH_COUNT(VERT_POLY_LINKS_REMOVED, size());
 			smesh.verts.raw(vert).poly_links.clear();
 		}
 
@@ -741,7 +1549,9 @@ public:
 	template<Const_Flag C>
 	class A_Poly_Vert {
 	public:
-		Const<Pos,C>& pos;
+		using Mesh = Smesh;
+
+		Pos_Ref<C> pos;
 
 		Const<typename Verts_Storage::Key,C>& key;
 
@@ -787,6 +1597,28 @@ public:
 		}
 
 
+		// polygon-vertices around this vertex, found using edge links (see A_Ring)
+		auto ring() const {
+			static_assert(Has_Edge_Links, "ring() requires EDGE_LINKS");
+			return A_Ring<C>(mesh, handle);
+		}
+
+
+		// index into mesh.indexed_vert_props, or -1
+		auto& indexed_props_key() const {
+			static_assert(Has_Indexed_Vert_Props, "indexed_props_key() requires Indexed_Vert_Props");
+			return raw().indexed_props_key;
+		}
+
+		// entry of mesh.indexed_vert_props
+		auto& indexed_props() const {
+			static_assert(Has_Indexed_Vert_Props, "indexed_props() requires Indexed_Vert_Props");
+			DCHECK_GE(raw().indexed_props_key, 0) << "indexed props not assigned";
+			DCHECK_LT(raw().indexed_props_key, (int)mesh.indexed_vert_props.size()) << "indexed props key out of range";
+			return mesh.indexed_vert_props[ raw().indexed_props_key ];
+		}
+
+
 		const H_Poly_Vert handle;
 
 
@@ -802,7 +1634,7 @@ public:
 
 	private:
 		A_Poly_Vert( Const<Smesh,C>& m, int p, decltype(H_Poly_Vert::vert) pv ) :
-				pos( m.verts.raw( m.polys.raw(p).verts[pv].key ).pos ),
+				pos( get_pos_ref<C>(m, m.verts.raw( m.polys.raw(p).verts[pv].key ).pos) ),
 				key(              m.polys.raw(p).verts[pv].key ),
 				idx_in_poly( pv ),
 				vert(    m.verts[ m.polys.raw(p).verts[pv].key ] ),
@@ -857,9 +1689,12 @@ public:
 			DCHECK_EQ(update().verts[0].key, other_poly_edge().verts[1].key);
 			DCHECK_EQ(update().verts[1].key, other_poly_edge().verts[0].key);
 
+			if constexpr(Has_Journal) mesh.journal.log_link(handle, other_poly_edge.handle);
+
 			// 2-way
 			raw().edge_link = edge_to_vert(other_poly_edge.handle);
 			other_poly_edge.raw().edge_link = edge_to_vert(handle);
+			SMESH_COUNT(EDGE_LINKS_CREATED, 1);
 		}
 
 		void unlink() const {
@@ -867,8 +1702,18 @@ public:
 			DCHECK(raw().edge_link.get(mesh).next_edge().has_link) << "mesh corrupted";
 			DCHECK(raw().edge_link.get(mesh).next_edge().link() == *this) << "mesh corrupted";
 
+			if constexpr(Has_Journal) mesh.journal.log_unlink(handle, {raw().edge_link.poly, raw().edge_link.vert});
+
+			// both half-edges keep edge props of the owner
+			if constexpr(Has_Edge_Props) {
+				auto& other = raw().edge_link.get(mesh).raw();
+				if(Smesh::owns_edge(raw(), handle)) other.edge_props = raw().edge_props;
+				else raw().edge_props = other.edge_props;
+			}
+
 			raw().edge_link.get(mesh).raw().edge_link.poly = -1;
 			raw().edge_link.poly = -1;
+			SMESH_COUNT(EDGE_LINKS_REMOVED, 1);
 		}
 
 		A_Poly_Edge<C> prev() const {
@@ -921,12 +1766,36 @@ public:
 
 		const bool has_link;
 
+		// true if not linked, or if linked half-edge has greater handle
+		// edge props are stored in the owner half-edge
+		const bool owns_edge;
+
+		// shared by both half-edges; when linking, props of the new owner are kept and props of
+		// the other half-edge are dropped. without EDGE_LINKS each half-edge has its own props
+		Proxy<Edge_Props,C> props;
+
 
 	private:
 		auto& raw() const {
 			return mesh.polys.raw(handle.poly).verts[handle.edge];
 		}
 
+		static auto& raw_edge_props( Const<Smesh,C>& m, const int p, const int8_t pv ) {
+			if constexpr(Has_Edge_Props) {
+				auto& r = m.polys.raw(p).verts[pv];
+				if constexpr(Has_Edge_Links) {
+					if(!Smesh::owns_edge( r, {p,pv} )) {
+						return m.polys.raw( r.edge_link.poly ).verts[ r.edge_link.vert ].edge_props;
+					}
+				}
+				return r.edge_props;
+			}
+			else {
+				static Void void_props;
+				return void_props;
+			}
+		}
+
 
 		static inline H_Poly_Vert edge_to_vert(const H_Poly_Edge& x) {
 			return {x.poly, x.edge};
@@ -942,9 +1811,11 @@ public:
 			    m.verts[ m.polys.raw(p).verts[(pv+1)%POLY_SIZE].key ]
 			}},
 			segment(
-				m.verts.raw( m.polys.raw(p).verts[pv].key ).pos,
-				m.verts.raw( m.polys.raw(p).verts[(pv+1)%POLY_SIZE].key ).pos),
-			has_link(m.polys.raw(p).verts[pv].edge_link.poly != -1) {}
+				m.verts.pos_codec.decode( m.verts.raw( m.polys.raw(p).verts[pv].key ).pos ),
+				m.verts.pos_codec.decode( m.verts.raw( m.polys.raw(p).verts[(pv+1)%POLY_SIZE].key ).pos )),
+			has_link(m.polys.raw(p).verts[pv].edge_link.poly != -1),
+			owns_edge( Smesh::owns_edge( m.polys.raw(p).verts[pv], {p,pv} ) ),
+			props( raw_edge_props(m, p, pv) ) {}
 
 	public:
 		auto update() const { return A_Poly_Edge(mesh, handle.poly, handle.edge); }
@@ -961,8 +1832,102 @@ public:
 
 
 
+
+
+
+
+	//
+	// one-ring circulator: polygon-vertices of the fan around a vertex, connected by edge links
+	//
+	// - does not need VERT_POLY_LINKS
+	// - for each polygon-vertex `pv`: `pv.poly` is the polygon, `pv.next().vert` the neighbor vertex,
+	//   and `pv.next_edge()` the outgoing edge
+	// - boundary fans are walked from one open edge to the other, so the last polygon-vertex's
+	//   `prev().vert` is the one extra neighbor vertex
+	// - only the fan reachable from the starting polygon-vertex is visited (non-manifold vertices have more)
+	//
+public:
+	template<Const_Flag C>
+	class A_Ring {
+	public:
+		class Iterator {
+		public:
+			auto operator*() const {
+				return A_Poly_Vert<C>(mesh, curr.poly, curr.vert);
+			}
+
+			auto& operator++() {
+				// cross previous edge: the linked edge starts at the same vertex
+				const auto& l = mesh.polys.raw(curr.poly).verts[(curr.vert + POLY_SIZE - 1) % POLY_SIZE].edge_link;
+				if(l.poly == -1 || l == first) curr = H_Poly_Vert();
+				else curr = l;
+				return *this;
+			}
+
+			bool operator==(const Iterator& o) const { return curr == o.curr; }
+			bool operator!=(const Iterator& o) const { return !(*this == o); }
+
+		private:
+			Iterator( Const<Smesh,C>& m, const H_Poly_Vert& c, const H_Poly_Vert& f ) : mesh(m), curr(c), first(f) {}
+			Const<Smesh,C>& mesh;
+			H_Poly_Vert curr;
+			const H_Poly_Vert first;
+
+			friend A_Ring;
+		};
+
+		auto begin() const { return Iterator(mesh, first, first); }
+		auto end() const { return Iterator(mesh, H_Poly_Vert(), first); }
+
+		// true if the fan is open (vertex lies on a hole)
+		bool is_boundary() const { return boundary; }
+
+	private:
+		A_Ring( Const<Smesh,C>& m, const H_Poly_Vert& start ) : mesh(m), first(start) {
+			// walk backwards (crossing next edges) to the first polygon-vertex of an open fan
+			for(;;) {
+				const auto& l = mesh.polys.raw(first.poly).verts[first.vert].edge_link;
+				if(l.poly == -1) {
+					boundary = true;
+					break;
+				}
+
+				H_Poly_Vert prev{ l.poly, decltype(H_Poly_Vert::vert)((l.vert + 1) % POLY_SIZE) };
+				if(prev == start) break;
+				first = prev;
+			}
+		}
+
+		Const<Smesh,C>& mesh;
+		H_Poly_Vert first;
+		bool boundary = false;
+
+		friend Smesh;
+	};
+
+
+
+
+
+
+
 	
 	
+
+
+
+private:
+	static bool owns_edge(const Poly_Vert& raw, const H_Poly_Edge& handle) {
+		if constexpr(Has_Edge_Links) {
+			const auto& l = raw.edge_link;
+			return l.poly == -1 || handle < H_Poly_Edge{l.poly, l.vert};
+		}
+		else {
+			(void)raw;
+			(void)handle;
+			return true;
+		}
+	}
 }; // class Smesh
 	
 
@@ -980,8 +1945,8 @@ inline std::ostream& operator<<(std::ostream& s, const g_H_Poly_Edge& pe) {
 
 
 // ostream
-template<class SCALAR, Smesh_Flags FLAGS, class OPTIONS, Const_Flag C>
-std::ostream& operator<<(std::ostream& stream, const typename Smesh<SCALAR, FLAGS, OPTIONS>::template A_Poly<C>& a_poly) {
+template<class SCALAR, Smesh_Flags FLAGS, class OPTIONS, class ALLOCATOR, Const_Flag C>
+std::ostream& operator<<(std::ostream& stream, const typename Smesh<SCALAR, FLAGS, OPTIONS, ALLOCATOR>::template A_Poly<C>& a_poly) {
 	stream << "poly(key:" << a_poly.key << ",indices:" <<
 		a_poly.verts[0].key << "," <<
 		a_poly.verts[1].key << "," <<
@@ -1013,47 +1978,65 @@ std::ostream& operator<<(std::ostream& stream, const typename Smesh<SCALAR, FLAG
 // BUILDER
 template<class SCALAR,
 	auto  FLAGS = _default__smesh_flags,
-	class PROPS = _Default__Smesh_Props
+	class PROPS = _Default__Smesh_Props,
+	class ALLOCATOR = std::allocator<char>
 >
 class Smesh_Builder {
 private:
-	template<class S, Smesh_Flags F, class P>
-	using _Smesh = Smesh<S,F,P>;
+	template<class S, Smesh_Flags F, class P, class A>
+	using _Smesh = Smesh<S,F,P,A>;
 
-	template<class VERT, class POLY, class POLY_VERT>
+	template<class VERT, class POLY, class POLY_VERT, class EDGE, class INDEXED_VERT>
 	struct Props {
 		using Vert = VERT;
 		using Poly = POLY;
 		using Poly_Vert = POLY_VERT;
+		using Edge = EDGE;
+		using Indexed_Vert = INDEXED_VERT;
 	};
 
+	using Indexed_Vert = typename internal::Get_Indexed_Vert_Props<PROPS>::Type;
+
 public:
-	using Smesh = _Smesh<SCALAR, FLAGS, PROPS>;
+	using Smesh = _Smesh<SCALAR, FLAGS, PROPS, ALLOCATOR>;
 
 	//
 
 	template<class NEW_VERT_PROPS>
 	using Vert_Props      = Smesh_Builder<SCALAR, FLAGS,
-		Props<NEW_VERT_PROPS, typename PROPS::Poly, typename PROPS::Poly_Vert>>;
+		Props<NEW_VERT_PROPS, typename PROPS::Poly, typename PROPS::Poly_Vert, typename PROPS::Edge, Indexed_Vert>, ALLOCATOR>;
 	
 	template<class NEW_POLY_PROPS>
 	using Poly_Props      = Smesh_Builder<SCALAR, FLAGS,
-		Props<typename PROPS::Vert, NEW_POLY_PROPS, typename PROPS::Poly_Vert>>;
+		Props<typename PROPS::Vert, NEW_POLY_PROPS, typename PROPS::Poly_Vert, typename PROPS::Edge, Indexed_Vert>, ALLOCATOR>;
 
 	template<class NEW_POLY_VERT_PROPS>
 	using Poly_Vert_Props = Smesh_Builder<SCALAR, FLAGS,
-		Props<typename PROPS::Vert, typename PROPS::Poly, NEW_POLY_VERT_PROPS>>;
+		Props<typename PROPS::Vert, typename PROPS::Poly, NEW_POLY_VERT_PROPS, typename PROPS::Edge, Indexed_Vert>, ALLOCATOR>;
+
+	template<class NEW_EDGE_PROPS>
+	using Edge_Props      = Smesh_Builder<SCALAR, FLAGS,
+		Props<typename PROPS::Vert, typename PROPS::Poly, typename PROPS::Poly_Vert, NEW_EDGE_PROPS, Indexed_Vert>, ALLOCATOR>;
+
+	template<class NEW_INDEXED_VERT_PROPS>
+	using Indexed_Vert_Props = Smesh_Builder<SCALAR, FLAGS,
+		Props<typename PROPS::Vert, typename PROPS::Poly, typename PROPS::Poly_Vert, typename PROPS::Edge, NEW_INDEXED_VERT_PROPS>, ALLOCATOR>;
 
 
 
 	template<Smesh_Flags NEW_FLAGS>
-	using Flags           = Smesh_Builder<SCALAR, NEW_FLAGS, PROPS>;
+	using Flags           = Smesh_Builder<SCALAR, NEW_FLAGS, PROPS, ALLOCATOR>;
 
 	template<Smesh_Flags NEW_FLAGS>
-	using Add_Flags       = Smesh_Builder<SCALAR, FLAGS |  NEW_FLAGS, PROPS>;
+	using Add_Flags       = Smesh_Builder<SCALAR, FLAGS |  NEW_FLAGS, PROPS, ALLOCATOR>;
 
 	template<Smesh_Flags NEW_FLAGS>
-	using Rem_Flags    = Smesh_Builder<SCALAR, FLAGS & ~NEW_FLAGS, PROPS>;
+	using Rem_Flags    = Smesh_Builder<SCALAR, FLAGS & ~NEW_FLAGS, PROPS, ALLOCATOR>;
+
+
+
+	template<class NEW_ALLOCATOR>
+	using Allocator       = Smesh_Builder<SCALAR, FLAGS, PROPS, NEW_ALLOCATOR>;
 };
 
 
@@ -1070,6 +2053,7 @@ public:
 
 
 
+
 } // namespace smesh
 
 
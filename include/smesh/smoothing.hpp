@@ -0,0 +1,252 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+enum class Smoothing_Weights {
+	UNIFORM,  // umbrella operator
+	COTANGENT // (cot alpha + cot beta) / 2, negative weights clamped to 0
+};
+
+
+
+//
+// weighted vertex neighborhoods in CSR form, see compute_smoothing_operator
+//
+template<class SCALAR>
+struct Smoothing_Operator {
+	std::vector<int> begins;     // neighbors of vert v: [ begins[v], begins[v+1] )
+	std::vector<int> neighbors;
+	std::vector<SCALAR> weights; // sum to 1 for each vert
+	std::vector<uint8_t> pinned; // boundary, isolated and erased verts: never moved
+
+	int num_pinned = 0;
+};
+
+
+
+
+
+//
+// neighbors of each vertex (over poly edges) and their weights, computed once and reused by smooth()
+//
+// - verts on unlinked edges are pinned (EDGE_LINKS), or on edges used by a single poly otherwise
+// - cotangent weights are computed from the current positions, and are not updated by smooth()
+//
+// computed in parallel, see set_num_threads
+//
+template<class MESH>
+auto compute_smoothing_operator(const MESH& mesh, Smoothing_Weights weighting = Smoothing_Weights::UNIFORM) {
+	static_assert(MESH::POLY_SIZE == 3, "compute_smoothing_operator requires triangles");
+	SMESH_SCOPED_TIMER("compute_smoothing_operator");
+
+	using Scalar = typename MESH::Scalar;
+	using Pos = Eigen::Matrix<Scalar,3,1>;
+	using Entry = std::pair<int, Scalar>; // neighbor, weight
+	constexpr int N = MESH::POLY_SIZE;
+
+	const int num_verts = mesh.verts.domain_end();
+
+	Smoothing_Operator<Scalar> r;
+	r.pinned.assign(num_verts, 1);
+
+	std::vector<int, typename MESH::template Allocator<int>> keys;
+	keys.reserve(mesh.polys.domain_end());
+	for(auto p : mesh.polys) keys.push_back(p.key);
+	const int num_polys = (int)keys.size();
+
+	auto get_vert = [&mesh](int poly, int i) { return (int)mesh.polys.raw(poly).verts[i].key; };
+
+	const auto positions = weighting == Smoothing_Weights::COTANGENT ?
+		decode_positions<Scalar>(mesh) : decltype(decode_positions<Scalar>(mesh))();
+
+	// cot of the angle at corner i of the poly
+	auto get_cot = [&](int poly, int i) {
+		const Pos& p = positions[get_vert(poly, i)];
+		const Pos a = positions[get_vert(poly, (i+1) % N)] - p;
+		const Pos b = positions[get_vert(poly, (i+N-1) % N)] - p;
+		const Scalar sine = a.cross(b).norm();
+		return sine > 0 ? a.dot(b) / sine : Scalar(0);
+	};
+
+	// 2 entries per corner: next and prev vert, bucketed by vert (counting sort)
+	std::vector<int, typename MESH::template Allocator<int>> begins(num_verts + 1, 0);
+	for(auto p : keys) {
+		for(int i=0; i<N; ++i) begins[get_vert(p, i) + 1] += 2;
+	}
+	std::partial_sum(begins.begin(), begins.end(), begins.begin());
+
+	std::vector<Entry, typename MESH::template Allocator<Entry>> entries(begins.back());
+	{
+		SMESH_SCOPED_TIMER("compute_smoothing_operator/entries");
+
+		std::vector<Scalar, typename MESH::template Allocator<Scalar>> cots(size_t(num_polys) * N, Scalar(1));
+		if(weighting == Smoothing_Weights::COTANGENT) {
+			smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+				for(int j=0; j<N; ++j) cots[size_t(i) * N + j] = get_cot(keys[i], j) / 2;
+			});
+		}
+
+		auto ends = begins;
+		for(int i=0; i<num_polys; ++i) {
+			const Scalar* cot = &cots[size_t(i) * N];
+			for(int j=0; j<N; ++j) {
+				const int v = get_vert(keys[i], j);
+				const int next = (j+1) % N;
+				const int prev = (j+N-1) % N;
+
+				// edge v-next is opposite to the prev corner, and v-prev to the next one
+				entries[ ends[v]++ ] = {get_vert(keys[i], next), cot[prev]};
+				entries[ ends[v]++ ] = {get_vert(keys[i], prev), cot[next]};
+			}
+		}
+	}
+
+	// open edges
+	if constexpr(MESH::Has_Edge_Links) {
+		for(auto p : keys) {
+			for(int i=0; i<N; ++i) {
+				if(mesh.polys.raw(p).verts[i].edge_link.poly != -1) continue;
+				r.pinned[get_vert(p, i)] = 2;
+				r.pinned[get_vert(p, (i+1) % N)] = 2;
+			}
+		}
+	}
+
+	// merge duplicate neighbors: rows are compacted in place, then moved to the front
+	std::vector<int, typename MESH::template Allocator<int>> row_sizes(num_verts + 1, 0);
+	smesh::parallel_for(0, num_verts, 4096, [&](int v) {
+		auto row = entries.begin() + begins[v];
+		auto row_end = entries.begin() + begins[v+1];
+		std::sort(row, row_end, [](const Entry& a, const Entry& b) { return a.first < b.first; });
+
+		int size = 0;
+		bool open = false;
+		for(auto it = row; it != row_end;) {
+			Entry merged = {it->first, 0};
+			int multiplicity = 0;
+			for(; it != row_end && it->first == merged.first; ++it, ++multiplicity) merged.second += it->second;
+
+			if(multiplicity == 1) open = true;
+			if(weighting == Smoothing_Weights::UNIFORM) merged.second = 1;
+			row[size++] = {merged.first, std::max(merged.second, Scalar(0))};
+		}
+
+		Scalar sum = 0;
+		for(int i=0; i<size; ++i) sum += row[i].second;
+
+		// erased and isolated verts stay pinned
+		if(size == 0 || !(sum > 0)) return;
+
+		if(!MESH::Has_Edge_Links && open) return;
+		if(r.pinned[v] == 2) return;
+
+		r.pinned[v] = 0;
+		for(int i=0; i<size; ++i) row[i].second /= sum;
+		row_sizes[v+1] = size;
+	});
+
+	std::partial_sum(row_sizes.begin(), row_sizes.end(), row_sizes.begin());
+
+	r.begins.assign(row_sizes.begin(), row_sizes.end());
+	r.neighbors.resize(r.begins.back());
+	r.weights.resize(r.begins.back());
+
+	smesh::parallel_for(0, num_verts, 16384, [&](int v) {
+		if(r.pinned[v]) r.pinned[v] = 1;
+		for(int i=0; i<r.begins[v+1] - r.begins[v]; ++i) {
+			r.neighbors[r.begins[v] + i] = entries[begins[v] + i].first;
+			r.weights[r.begins[v] + i] = entries[begins[v] + i].second;
+		}
+	});
+
+	for(auto pinned : r.pinned) r.num_pinned += pinned;
+
+	return r;
+}
+
+
+
+
+
+//
+// Laplacian smoothing: each iteration moves free verts by `lambda` towards the weighted average
+// of their neighbors. with `mu` (Taubin, e.g. lambda 0.5, mu -0.53), each iteration is followed
+// by a second pass with `mu`, which undoes the shrinking
+//
+// positions are decoded once and double-buffered; iterations run in parallel, see set_num_threads.
+// with JOURNAL, moved verts are touched, so smoothing inside a transaction can be undone
+//
+template<class MESH, class SCALAR>
+void smooth(MESH& mesh, const Smoothing_Operator<SCALAR>& op, int num_iterations,
+		double lambda = 0.5, double mu = 0) {
+	SMESH_SCOPED_TIMER("smooth");
+
+	using Pos = Eigen::Matrix<SCALAR,3,1>;
+
+	const int num_verts = mesh.verts.domain_end();
+	CHECK_EQ(num_verts + 1, (int)op.begins.size()) << "smooth: smoothing operator computed for another mesh";
+
+	auto src = decode_positions<SCALAR>(mesh);
+	auto dst = src;
+
+	auto pass = [&](SCALAR factor) {
+		smesh::parallel_for_chunks(0, num_verts, 4096, [&](int, int b, int e) {
+			for(int v=b; v<e; ++v) {
+				if(op.pinned[v]) continue;
+
+				Pos avg = Pos::Zero();
+				for(int i=op.begins[v]; i<op.begins[v+1]; ++i) avg += op.weights[i] * src[ op.neighbors[i] ];
+
+				dst[v] = src[v] + factor * (avg - src[v]);
+			}
+		});
+		std::swap(src, dst);
+	};
+
+	for(int i=0; i<num_iterations; ++i) {
+		pass(SCALAR(lambda));
+		if(mu != 0) pass(SCALAR(mu));
+	}
+
+	// journal records are appended serially, before the parallel write-back
+	if constexpr(MESH::Has_Journal) {
+		if(mesh.journal.is_recording()) {
+			for(int v=0; v<num_verts; ++v) if(!op.pinned[v]) mesh.journal.touch_vert(v);
+		}
+	}
+
+	smesh::parallel_for(0, num_verts, 16384, [&](int v) {
+		if(op.pinned[v]) return;
+		mesh.verts.raw(v).pos = mesh.verts.pos_codec.encode( src[v].template cast<typename MESH::Scalar>() );
+	});
+}
+
+
+
+template<class MESH>
+void smooth(MESH& mesh, int num_iterations, double lambda = 0.5,
+		Smoothing_Weights weighting = Smoothing_Weights::UNIFORM) {
+	smooth(mesh, compute_smoothing_operator(mesh, weighting), num_iterations, lambda);
+}
+
+
+
+template<class MESH>
+void taubin_smooth(MESH& mesh, int num_iterations, double lambda = 0.5, double mu = -0.53,
+		Smoothing_Weights weighting = Smoothing_Weights::UNIFORM) {
+	smooth(mesh, compute_smoothing_operator(mesh, weighting), num_iterations, lambda, mu);
+}
@@ -3,6 +3,12 @@
 
 #include "edge-links.hpp"
 #include "vert-poly-links.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 
 
@@ -11,6 +17,7 @@
 
 template<class MESH>
 bool has_degenerate_polys(const MESH& mesh) {
+	SMESH_SCOPED_TIMER("has_degenerate_polys");
 	for(auto p : mesh.polys) {
 		for(auto pv : p.verts) {
 			if(pv.key == pv.next().key) return true;
@@ -61,37 +68,221 @@ namespace {
 
 
 
-template<class MESH>
-auto check_solid(const MESH& mesh, Check_Solid_Flags flags = Check_Solid_Flags::NONE) {
+struct Validate_Mesh_Result {
 
-	Check_Solid_Result r;
+	enum class Issue_Type {
+		DEGENERATE_POLY = 0,
+		INVALID_EDGE_LINK,      // not 2-way, or out of range
+		OPEN_EDGE,              // only if ALLOW_HOLES is not set
+		INVALID_VERT_POLY_LINK, // points to poly-vert of other vertex
+		MISSING_VERT_POLY_LINK  // poly-vert not linked from its vertex
+	};
 
-	if(has_degenerate_polys(mesh)) {
-		r.failure = Check_Solid_Result::Failure::DEGENERATE_POLYS;
-		return r;
-	}
+	struct Issue {
+		Issue_Type type;
+		int vert = -1;        // for INVALID_VERT_POLY_LINK
+		smesh::g_H_Poly_Vert handle; // poly-vert, or half-edge {poly, edge}
+	};
 
-	if constexpr(MESH::Has_Edge_Links) {
-		if(!has_valid_edge_links(mesh)) {
-			r.failure = Check_Solid_Result::Failure::INVALID_EDGE_LINKS;
-			return r;
-		}
-		if(!bool(flags & ALLOW_HOLES) && !has_all_edge_links(mesh)) {
-			r.failure = Check_Solid_Result::Failure::INVALID_EDGE_LINKS;
-			return r;
+	bool is_solid = false;
+
+	int num_degenerate_polys = 0;
+	int num_invalid_edge_links = 0;
+	int num_open_edges = 0;
+	int num_invalid_vert_poly_links = 0;
+	int num_missing_vert_poly_links = 0;
+
+	// up to `max_issues`, sorted by handle (not necessarily the first ones)
+	std::vector<Issue> issues;
+};
+
+
+
+namespace smesh::internal {
+
+	// per-thread accumulator of validate_mesh
+	struct Validate_Mesh_Accumulator {
+		int counts[5] = {};
+		std::vector<Validate_Mesh_Result::Issue> issues;
+	};
+
+}
+
+
+
+//
+// all checks of check_solid in one parallel pass over polys (plus one over verts if there are
+// vert-poly links), using bitsets. collects every offending handle, up to `max_issues`
+//
+template<class MESH>
+auto validate_mesh(const MESH& mesh, Check_Solid_Flags flags = Check_Solid_Flags::NONE, int max_issues = 100) {
+	SMESH_SCOPED_TIMER("validate_mesh");
+
+	using Result = Validate_Mesh_Result;
+	using Issue_Type = Result::Issue_Type;
+	using Accumulator = smesh::internal::Validate_Mesh_Accumulator;
+	constexpr int N = MESH::POLY_SIZE;
+	constexpr int grain = 4096;
+
+	auto add_issue = [max_issues](Accumulator& acc, Issue_Type type, int vert, int poly, int idx) {
+		++acc.counts[(int)type];
+		if((int)acc.issues.size() < max_issues) {
+			acc.issues.push_back({type, vert, {poly, (int8_t)idx}});
 		}
+	};
+
+	const int polys_domain_end = mesh.polys.domain_end();
+
+	// live polys, so links to erased polys are detected
+	std::vector<int, typename MESH::template Allocator<int>> poly_keys;
+	std::vector<uint64_t, typename MESH::template Allocator<uint64_t>> alive( (polys_domain_end + 63) / 64 );
+	poly_keys.reserve(polys_domain_end);
+	for(auto p : mesh.polys) {
+		poly_keys.push_back(p.key);
+		alive[p.key / 64] |= uint64_t(1) << (p.key % 64);
 	}
 
+	auto is_alive = [&alive, polys_domain_end](int poly) {
+		return poly >= 0 && poly < polys_domain_end && (alive[poly / 64] & (uint64_t(1) << (poly % 64)));
+	};
+
+	// poly-verts linked from their verts
+	std::vector<std::atomic<uint64_t>, typename MESH::template Allocator<std::atomic<uint64_t>>> linked(
+		MESH::Has_Vert_Poly_Links ? (polys_domain_end * N + 63) / 64 : 0 );
+
+	std::vector<Accumulator> accs;
+
 	if constexpr(MESH::Has_Vert_Poly_Links) {
-		if(!has_valid_vert_poly_links(mesh)) {
-			r.failure = Check_Solid_Result::Failure::INVALID_VERT_POLY_LINKS;
-			return r;
-		}
+		SMESH_SCOPED_TIMER("validate_mesh/verts");
+
+		std::vector<int, typename MESH::template Allocator<int>> vert_keys;
+		vert_keys.reserve(mesh.verts.domain_end());
+		for(auto v : mesh.verts) vert_keys.push_back(v.key);
+
+		const int n = (int)vert_keys.size();
+		accs.resize( smesh::get_num_threads(0, n, grain) );
+
+		smesh::parallel_for_chunks(0, n, grain, [&](int thread, int b, int e) {
+			auto& acc = accs[thread];
+			for(int i=b; i<e; ++i) {
+				const int v = vert_keys[i];
+				for(const auto& h : mesh.verts.raw(v).poly_links) {
+					if(!is_alive(h.poly) || h.vert < 0 || h.vert >= N ||
+							mesh.polys.raw(h.poly).verts[h.vert].key != v) {
+						add_issue(acc, Issue_Type::INVALID_VERT_POLY_LINK, v, h.poly, h.vert);
+						continue;
+					}
+
+					// only the vertex of a poly-vert can link it, so each bit is set at most once
+					const int bit = h.poly * N + h.vert;
+					linked[bit / 64].fetch_or(uint64_t(1) << (bit % 64), std::memory_order_relaxed);
+				}
+			}
+		});
+	}
+
+	{
+		SMESH_SCOPED_TIMER("validate_mesh/polys");
+
+		const int n = (int)poly_keys.size();
+		accs.resize( std::max((int)accs.size(), smesh::get_num_threads(0, n, grain)) );
+
+		smesh::parallel_for_chunks(0, n, grain, [&](int thread, int b, int e) {
+			auto& acc = accs[thread];
+			for(int i=b; i<e; ++i) {
+				const int p = poly_keys[i];
+				const auto& raw = mesh.polys.raw(p);
+
+				for(int j=0; j<N; ++j) {
+					if(raw.verts[j].key == raw.verts[(j+1) % N].key) {
+						add_issue(acc, Issue_Type::DEGENERATE_POLY, -1, p, j);
+						break;
+					}
+				}
+
+				if constexpr(MESH::Has_Edge_Links) {
+					for(int j=0; j<N; ++j) {
+						const auto& l = raw.verts[j].edge_link;
+						if(l.poly == -1) {
+							if(!bool(flags & ALLOW_HOLES)) add_issue(acc, Issue_Type::OPEN_EDGE, -1, p, j);
+							continue;
+						}
+
+						if(!is_alive(l.poly) || l.vert < 0 || l.vert >= N) {
+							add_issue(acc, Issue_Type::INVALID_EDGE_LINK, -1, p, j);
+							continue;
+						}
+
+						const auto& back = mesh.polys.raw(l.poly).verts[l.vert].edge_link;
+						if(back.poly != p || back.vert != j) {
+							add_issue(acc, Issue_Type::INVALID_EDGE_LINK, -1, p, j);
+						}
+					}
+				}
+
+				if constexpr(MESH::Has_Vert_Poly_Links) {
+					for(int j=0; j<N; ++j) {
+						const int bit = p * N + j;
+						if(!(linked[bit / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (bit % 64)))) {
+							add_issue(acc, Issue_Type::MISSING_VERT_POLY_LINK, -1, p, j);
+						}
+					}
+				}
+			}
+		});
 	}
 
 	(void)flags; // suppress unused warning
 
-	r.is_solid = true;
+	Result r;
+
+	int counts[5] = {};
+	for(auto& acc : accs) {
+		for(int i=0; i<5; ++i) counts[i] += acc.counts[i];
+		r.issues.insert(r.issues.end(), acc.issues.begin(), acc.issues.end());
+	}
+
+	r.num_degenerate_polys        = counts[(int)Issue_Type::DEGENERATE_POLY];
+	r.num_invalid_edge_links      = counts[(int)Issue_Type::INVALID_EDGE_LINK];
+	r.num_open_edges              = counts[(int)Issue_Type::OPEN_EDGE];
+	r.num_invalid_vert_poly_links = counts[(int)Issue_Type::INVALID_VERT_POLY_LINK];
+	r.num_missing_vert_poly_links = counts[(int)Issue_Type::MISSING_VERT_POLY_LINK];
+
+	std::sort(r.issues.begin(), r.issues.end(), [](const auto& a, const auto& b) {
+		return a.handle < b.handle || (a.handle == b.handle && a.type < b.type);
+	});
+	if((int)r.issues.size() > max_issues) r.issues.resize(max_issues);
+
+	r.is_solid = counts[0] + counts[1] + counts[2] + counts[3] + counts[4] == 0;
+	return r;
+}
+
+
+
+
+
+//
+// uses validate_mesh
+//
+template<class MESH>
+auto check_solid(const MESH& mesh, Check_Solid_Flags flags = Check_Solid_Flags::NONE) {
+	SMESH_SCOPED_TIMER("check_solid");
+
+	auto v = validate_mesh(mesh, flags, 0);
+
+	Check_Solid_Result r;
+	r.is_solid = v.is_solid;
+
+	if(v.num_degenerate_polys) {
+		r.failure = Check_Solid_Result::Failure::DEGENERATE_POLYS;
+	}
+	else if(v.num_invalid_edge_links || v.num_open_edges) {
+		r.failure = Check_Solid_Result::Failure::INVALID_EDGE_LINKS;
+	}
+	else if(v.num_invalid_vert_poly_links || v.num_missing_vert_poly_links) {
+		r.failure = Check_Solid_Result::Failure::INVALID_VERT_POLY_LINKS;
+	}
+
 	return r;
 }
 
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "smesh.hpp"
+#include "positions.hpp"
+#include "parallel.hpp"
+#include "instrumentation.hpp"
+
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+
+enum class Subdivision_Scheme {
+	MIDPOINT, // new verts at edge midpoints, old verts stay
+	LOOP      // Loop: smooth limit surface, open edges are cubic B-splines
+};
+
+
+
+
+
+namespace smesh::internal {
+
+	//
+	// one level of 1-to-4 subdivision of `src` into a new compact mesh
+	//
+	// child polys of poly p are 4*p + k: the corner polys (v_k, m_k, m_{k-1}) for k < 3, then the
+	// center poly (m_0, m_1, m_2), where m_k is the new vert of edge k. so the edge links of the
+	// children follow from the edge link of the parent, without any lookups
+	//
+	template<class MESH>
+	MESH subdivide_once(const MESH& src, Subdivision_Scheme scheme) {
+		SMESH_SCOPED_TIMER("subdivide_once");
+
+		using Scalar = typename MESH::Scalar;
+		using Pos = typename MESH::Pos;
+		using Ints = std::vector<int, typename MESH::template Allocator<int>>;
+		constexpr int N = MESH::POLY_SIZE;
+
+		// compact numbering of live verts and polys
+		Ints vert_keys;
+		Ints vert_index(src.verts.domain_end(), -1);
+		vert_keys.reserve(src.verts.domain_end());
+		for(auto v : src.verts) {
+			vert_index[v.key] = (int)vert_keys.size();
+			vert_keys.push_back(v.key);
+		}
+
+		Ints poly_keys;
+		Ints poly_index(src.polys.domain_end(), -1);
+		poly_keys.reserve(src.polys.domain_end());
+		for(auto p : src.polys) {
+			poly_index[p.key] = (int)poly_keys.size();
+			poly_keys.push_back(p.key);
+		}
+
+		const int num_verts = (int)vert_keys.size();
+		const int num_polys = (int)poly_keys.size();
+
+		auto get_vert = [&src](int poly, int i) { return (int)src.polys.raw(poly).verts[i].key; };
+		auto get_link = [&src](int poly, int i) -> const auto& { return src.polys.raw(poly).verts[i].edge_link; };
+
+		// same rule as Smesh::owns_edge
+		auto owns_edge = [&](int poly, int i) {
+			const auto& l = get_link(poly, i);
+			return l.poly == -1 || poly < l.poly || (poly == l.poly && i < l.vert);
+		};
+
+		// edges are numbered by their owning half-edges, in poly order
+		Ints edge_begins(num_polys + 1, 0);
+		smesh::parallel_for(0, num_polys, 16384, [&](int i) {
+			for(int j=0; j<N; ++j) edge_begins[i+1] += owns_edge(poly_keys[i], j);
+		});
+		std::partial_sum(edge_begins.begin(), edge_begins.end(), edge_begins.begin());
+		const int num_edges = edge_begins.back();
+
+		auto get_edge = [&](int poly, int i) {
+			int owner = poly;
+			int edge = i;
+			if(!owns_edge(poly, i)) {
+				owner = get_link(poly, i).poly;
+				edge = get_link(poly, i).vert;
+			}
+
+			int r = edge_begins[ poly_index[owner] ];
+			for(int j=0; j<edge; ++j) r += owns_edge(owner, j);
+			return r;
+		};
+
+
+
+		//
+		// positions: old verts, then one vert per edge
+		//
+		const auto positions = decode_positions<Scalar>(src);
+		std::vector<Pos, typename MESH::template Allocator<Pos>> new_positions(size_t(num_verts) + num_edges);
+
+		// corners of each vert (counting sort)
+		Ints corner_begins(num_verts + 1, 0);
+		for(auto p : poly_keys) {
+			for(int i=0; i<N; ++i) ++corner_begins[ vert_index[get_vert(p, i)] + 1 ];
+		}
+		std::partial_sum(corner_begins.begin(), corner_begins.end(), corner_begins.begin());
+
+		Ints corners(corner_begins.back());
+		{
+			auto ends = corner_begins;
+			for(auto p : poly_keys) {
+				for(int i=0; i<N; ++i) corners[ ends[vert_index[get_vert(p, i)]]++ ] = p * N + i;
+			}
+		}
+
+		smesh::parallel_for(0, num_verts, 16384, [&](int v) {
+			const Pos& pos = positions[vert_keys[v]];
+			new_positions[v] = pos;
+			if(scheme == Subdivision_Scheme::MIDPOINT) return;
+
+			Pos sum = Pos::Zero();
+			int valence = 0;
+
+			// neighbors across open edges
+			Pos boundary_sum = Pos::Zero();
+			int num_boundary = 0;
+
+			for(int c=corner_begins[v]; c<corner_begins[v+1]; ++c) {
+				const int p = corners[c] / N;
+				const int i = corners[c] % N;
+				const int next = (i+1) % N;
+				const int prev = (i+N-1) % N;
+
+				sum += positions[get_vert(p, next)];
+				++valence;
+
+				if(get_link(p, i).poly == -1) {
+					boundary_sum += positions[get_vert(p, next)];
+					++num_boundary;
+				}
+				if(get_link(p, prev).poly == -1) {
+					boundary_sum += positions[get_vert(p, prev)];
+					++num_boundary;
+				}
+			}
+
+			if(num_boundary == 0 && valence > 0) {
+				const Scalar beta = valence == 3 ? Scalar(3) / 16 : Scalar(3) / (8 * valence);
+				new_positions[v] = (1 - valence * beta) * pos + beta * sum;
+			}
+			else if(num_boundary == 2) {
+				new_positions[v] = Scalar(0.75) * pos + Scalar(0.125) * boundary_sum;
+			}
+			// non-manifold verts stay
+		});
+
+		smesh::parallel_for(0, num_polys, 16384, [&](int pi) {
+			const int p = poly_keys[pi];
+			for(int i=0; i<N; ++i) {
+				if(!owns_edge(p, i)) continue;
+
+				const Pos& a = positions[get_vert(p, i)];
+				const Pos& b = positions[get_vert(p, (i+1) % N)];
+				Pos& m = new_positions[num_verts + get_edge(p, i)];
+
+				const auto& l = get_link(p, i);
+				if(scheme == Subdivision_Scheme::MIDPOINT || l.poly == -1) {
+					m = (a + b) / 2;
+				}
+				else {
+					const Pos& c = positions[get_vert(p, (i+2) % N)];
+					const Pos& d = positions[get_vert(l.poly, (l.vert+2) % N)];
+					m = Scalar(0.375) * (a + b) + Scalar(0.125) * (c + d);
+				}
+			}
+		});
+
+
+
+		//
+		// polys, edge links
+		//
+		Ints indices(size_t(num_polys) * 4 * N);
+		smesh::parallel_for(0, num_polys, 16384, [&](int pi) {
+			const int p = poly_keys[pi];
+
+			int v[N], m[N];
+			for(int k=0; k<N; ++k) {
+				v[k] = vert_index[get_vert(p, k)];
+				m[k] = num_verts + get_edge(p, k);
+			}
+
+			int* t = &indices[size_t(pi) * 4 * N];
+			for(int k=0; k<N; ++k) {
+				t[k*N + 0] = v[k];
+				t[k*N + 1] = m[k];
+				t[k*N + 2] = m[(k+N-1) % N];
+			}
+			for(int k=0; k<N; ++k) t[3*N + k] = m[k];
+		});
+
+		MESH dst;
+		dst.verts.pos_codec = src.verts.pos_codec;
+		dst.verts.add_range(new_positions.begin(), new_positions.end());
+		new_positions = decltype(new_positions)();
+
+		dst.polys.add_range(indices.data(), num_polys * 4, MESH::Has_Vert_Poly_Links);
+		indices = Ints();
+
+		smesh::parallel_for(0, num_polys, 16384, [&](int pi) {
+			const int p = poly_keys[pi];
+
+			auto set_link = [&](int poly, int edge, int other_poly, int other_edge) {
+				auto& l = dst.polys.raw(poly).verts[edge].edge_link;
+				l.poly = other_poly;
+				l.vert = int8_t(other_edge);
+			};
+
+			for(int k=0; k<N; ++k) {
+				const int child = 4*pi + k;
+
+				// first half of parent edge k: twin is the second half of the linked edge
+				const auto& l0 = get_link(p, k);
+				if(l0.poly != -1) set_link(child, 0, 4*poly_index[l0.poly] + (l0.vert+1) % N, 2);
+
+				set_link(child, 1, 4*pi + 3, (k+N-1) % N);
+				set_link(4*pi + 3, (k+N-1) % N, child, 1);
+
+				// second half of parent edge k-1: twin is the first half of the linked edge
+				const auto& l2 = get_link(p, (k+N-1) % N);
+				if(l2.poly != -1) set_link(child, 2, 4*poly_index[l2.poly] + l2.vert, 0);
+			}
+		});
+
+		// props: old verts keep theirs, child polys copy their parent's
+		if constexpr(MESH::Has_Vert_Props) {
+			smesh::parallel_for(0, num_verts, 16384, [&](int v) {
+				dst.verts[v].props = src.verts[ vert_keys[v] ].props();
+			});
+		}
+		if constexpr(MESH::Has_Poly_Props) {
+			smesh::parallel_for(0, num_polys, 16384, [&](int pi) {
+				for(int k=0; k<4; ++k) dst.polys[4*pi + k].props = src.polys[ poly_keys[pi] ].props();
+			});
+		}
+
+		return dst;
+	}
+
+}
+
+
+
+
+
+//
+// subdivide each poly into 4, `levels` times, with Loop or midpoint scheme
+//
+// - the new mesh is built directly from edge links: child edge links are derived from parent ones
+//   (no hashing), so the result is solid if the input is. vert-poly links are added too
+// - each level is computed in parallel (see set_num_threads) into pre-sized storage
+// - the result is compact. old verts keep their props and come first, child polys copy their
+//   parent's props. other props and layers are not carried over
+//
+// requires EDGE_LINKS
+//
+template<class MESH>
+void subdivide(MESH& mesh, int levels = 1, Subdivision_Scheme scheme = Subdivision_Scheme::LOOP) {
+	static_assert(MESH::Has_Edge_Links, "subdivide requires EDGE_LINKS");
+	static_assert(MESH::POLY_SIZE == 3, "subdivide requires triangles");
+	static_assert(!MESH::Has_Indexed_Vert_Props, "subdivide does not support Indexed_Vert_Props");
+	SMESH_SCOPED_TIMER("subdivide");
+
+	for(int level=0; level<levels; ++level) {
+		mesh = smesh::internal::subdivide_once(mesh, scheme);
+	}
+}
@@ -2,6 +2,8 @@
 
 
 
+#include "instrumentation.hpp"
+
 #include <unordered_set>
 
 
@@ -11,7 +13,10 @@
 
 template<class MESH>
 bool has_valid_vert_poly_links(MESH& mesh) {
-	std::unordered_set<std::pair<int,int>> checked;
+	SMESH_SCOPED_TIMER("has_valid_vert_poly_links");
+	using Key = std::pair<int,int>;
+	std::unordered_set<Key, std::hash<Key>, std::equal_to<Key>,
+		typename MESH::template Allocator<Key>> checked;
 
 	for(auto v : mesh.verts) {
 		for(auto pv : v.poly_links) {
@@ -19,6 +24,7 @@ bool has_valid_vert_poly_links(MESH& mesh) {
 			if(v.key != pv.key) return false;
 
 			bool inserted = checked.insert({pv.poly.key, pv.idx_in_poly}).second;
+			SMESH_COUNT(HASH_PROBES, 1);
 			if(!inserted) {
 				// some vertex already linked to this poly_vert
 				return false;
@@ -29,6 +35,7 @@ bool has_valid_vert_poly_links(MESH& mesh) {
 	for(auto p : mesh.polys) {
 		for(auto pv : p.verts) {
 			auto it = checked.find({pv.poly.key, pv.idx_in_poly});
+			SMESH_COUNT(HASH_PROBES, 1);
 			if(it == checked.end()) {
 				// this poly_vert is not pointed by its vert
 				return false;
@@ -53,6 +60,7 @@ bool has_valid_vert_poly_links(MESH& mesh) {
 
 template<class MESH>
 void compute_vert_poly_links(MESH& mesh) {
+	SMESH_SCOPED_TIMER("compute_vert_poly_links");
 
 	for(auto v : mesh.verts) {
 		DCHECK(v.poly_links.empty()) << "compute_plinks expects empty plinks";
@@ -0,0 +1,122 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/positions.hpp>
+#include <smesh/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <list>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh_Builder<double>::Add_Flags<VERT_POLY_LINKS>::Smesh;
+using Quantized_Mesh = Smesh_Builder<float>::Add_Flags<QUANTIZED_POS>::Smesh;
+
+
+
+
+namespace {
+	// n*n grid of verts, 2*(n-1)^2 polys
+	void get_grid(int n, std::vector<float>& xyz, std::vector<int>& indices) {
+		for(int y=0; y<n; ++y) {
+			for(int x=0; x<n; ++x) {
+				xyz.insert(xyz.end(), {float(x), float(y), 0});
+			}
+		}
+
+		for(int y=0; y+1<n; ++y) {
+			for(int x=0; x+1<n; ++x) {
+				const int a = y*n + x;
+				indices.insert(indices.end(), {a, a+1, a+n+1,  a, a+n+1, a+n});
+			}
+		}
+	}
+}
+
+
+
+
+TEST(Add_Range, same_as_add) {
+	std::vector<float> xyz;
+	std::vector<int> indices;
+	get_grid(200, xyz, indices); // 40000 verts, 79202 polys: several chunks of the 16384 grain
+
+	Scoped_Num_Threads threads(4);
+
+	Mesh a;
+	for(int i=0; i<(int)xyz.size()/3; ++i) a.verts.add(xyz[i*3], xyz[i*3+1], xyz[i*3+2]);
+	for(int i=0; i<(int)indices.size()/3; ++i) a.polys.add(indices[i*3], indices[i*3+1], indices[i*3+2]);
+	compute_vert_poly_links(a);
+
+	Mesh b;
+	b.verts.add(7, 7, 7); // not first
+	auto& layer = b.verts.layers.add<int>("layer", 3);
+
+	EXPECT_EQ(1, b.verts.add_range(xyz.data(), (int)xyz.size()/3));
+	std::vector<int> shifted = indices;
+	for(auto& i : shifted) ++i;
+	EXPECT_EQ(0, b.polys.add_range(shifted.data(), (int)shifted.size()/3, true));
+
+	EXPECT_EQ(a.verts.domain_end() + 1, b.verts.domain_end());
+	EXPECT_EQ(a.polys.domain_end(), b.polys.domain_end());
+	EXPECT_EQ(b.verts.domain_end(), layer.size());
+	EXPECT_EQ(3, layer[b.verts.domain_end() - 1]);
+
+	for(auto v : a.verts) {
+		EXPECT_EQ(v.pos(), b.verts[v.key + 1].pos());
+	}
+
+	for(auto p : a.polys) {
+		for(int i=0; i<3; ++i) {
+			EXPECT_EQ(p.verts[i].key + 1, b.polys[p.key].verts[i].key);
+		}
+	}
+
+	for(auto v : a.verts) {
+		EXPECT_EQ(v.poly_links.size(), b.verts[v.key + 1].poly_links.size());
+	}
+	EXPECT_TRUE( has_valid_vert_poly_links(b) );
+}
+
+
+
+
+TEST(Add_Range, vert_poly_links) {
+	std::vector<float> xyz;
+	std::vector<int> indices;
+	get_grid(10, xyz, indices);
+
+	Mesh mesh;
+	mesh.verts.add_range(xyz.data(), (int)xyz.size()/3);
+	mesh.polys.add_range(indices.data(), (int)indices.size()/3, true);
+
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh) );
+	EXPECT_EQ(6, mesh.verts[11].poly_links.size());
+}
+
+
+
+
+TEST(Add_Range, iterators) {
+	std::list<Eigen::Vector3f> positions = {{1,2,3}, {4,5,6}};
+	std::vector<Eigen::Vector3f> more = {{7,8,9}};
+
+	Quantized_Mesh mesh;
+	set_pos_bounds(mesh, {0,0,0}, {10,10,10});
+
+	EXPECT_EQ(0, mesh.verts.add_range(positions.begin(), positions.end()));
+	EXPECT_EQ(2, mesh.verts.add_range(more.begin(), more.end()));
+
+	ASSERT_EQ(3, mesh.verts.domain_end());
+	EXPECT_NEAR(2, mesh.verts[0].pos()[1], 1e-3);
+	EXPECT_NEAR(6, mesh.verts[1].pos()[2], 1e-3);
+	EXPECT_NEAR(7, mesh.verts[2].pos()[0], 1e-3);
+}
@@ -0,0 +1,85 @@
+#include <smesh/smesh.hpp>
+#include <smesh/allocator.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh_Builder<double>::Allocator< Arena_Allocator<char> >::Smesh;
+
+
+
+struct Counting_Resource : std::pmr::memory_resource {
+	int num_allocations = 0;
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		++num_allocations;
+		return upstream.allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+		upstream.deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+		return this == &o;
+	}
+
+	std::pmr::monotonic_buffer_resource upstream;
+};
+
+
+
+
+
+TEST(Allocator, links_cube) {
+
+	Counting_Resource resource;
+	Scoped_Memory_Resource scope(&resource);
+
+	auto mesh = get_cube_mesh<Mesh>();
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	EXPECT_GT(resource.num_allocations, 0);
+
+	EXPECT_TRUE( is_solid(mesh) );
+}
+
+
+
+
+TEST(Allocator, cap_holes_sphere_holes_ply) {
+
+	std::pmr::monotonic_buffer_resource arena;
+	Scoped_Memory_Resource scope(&arena);
+
+	auto mesh = load_ply<Mesh>("sphere-holes.ply");
+	EXPECT_FALSE(mesh.verts.empty());
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	cap_holes(mesh);
+
+	EXPECT_TRUE( is_solid(mesh) );
+}
+
+
+
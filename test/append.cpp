@@ -0,0 +1,109 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/append.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+TEST(Append, two_cubes) {
+	auto dst = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(dst);
+	compute_vert_poly_links(dst);
+
+	auto src = dst;
+	for(auto v : src.verts) v.pos = Eigen::Vector3d(v.pos() + Eigen::Vector3d(3, 0, 0));
+
+	auto r = append(dst, src);
+
+	EXPECT_EQ(8, r.vert_begin);
+	EXPECT_EQ(12, r.poly_begin);
+	EXPECT_TRUE(r.boundary_edges.empty());
+
+	EXPECT_EQ(16, dst.verts.domain_end());
+	EXPECT_EQ(24, dst.polys.domain_end());
+	EXPECT_TRUE( has_valid_edge_links(dst) );
+	EXPECT_TRUE( has_all_edge_links(dst) );
+	EXPECT_TRUE( has_valid_vert_poly_links(dst) );
+	EXPECT_TRUE( is_solid(dst) );
+
+	for(auto v : src.verts) EXPECT_EQ(v.pos(), dst.verts[ r.vert_remap[v.key] ].pos());
+}
+
+
+
+TEST(Append, extract_cube_faces) {
+	auto mesh = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	// faces x = -1 and x = 1: 2 separate quads
+	Mesh part;
+	auto r = append(part, mesh, [](int p) { return p < 4; });
+
+	EXPECT_EQ(8, part.verts.domain_end());
+	EXPECT_EQ(4, part.polys.domain_end());
+	EXPECT_EQ(8, (int)r.boundary_edges.size());
+	EXPECT_TRUE( has_valid_edge_links(part) );
+	EXPECT_TRUE( has_valid_vert_poly_links(part) );
+
+	for(auto [p, e] : r.boundary_edges) {
+		EXPECT_EQ(-1, part.polys.raw(p).verts[e].edge_link.poly);
+	}
+
+	// one face: only its verts
+	auto face = extract(mesh, [](int p) { return p == 2 || p == 3; });
+	EXPECT_EQ(4, face.verts.domain_end());
+	EXPECT_EQ(2, face.polys.domain_end());
+	EXPECT_EQ(4, validate_mesh(face).num_open_edges);
+}
+
+
+
+TEST(Append, bunny_ply_extract) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	const int half = mesh.polys.domain_end() / 2;
+	auto is_selected = [half](int p) { return p < half; };
+
+	Mesh a, b;
+
+	Scoped_Num_Threads threads(1);
+	auto ra = append(a, mesh, is_selected);
+
+	threads.set(4);
+	auto rb = append(b, mesh, is_selected);
+
+	ASSERT_GT(a.polys.domain_end(), 0);
+	ASSERT_LT(a.polys.domain_end(), mesh.polys.domain_end());
+
+	EXPECT_TRUE( has_valid_edge_links(a) );
+	EXPECT_TRUE( has_valid_vert_poly_links(a) );
+	EXPECT_EQ(validate_mesh(a).num_open_edges, (int)ra.boundary_edges.size());
+
+	// same as recomputing links
+	auto recomputed = a;
+	EXPECT_EQ((int)ra.boundary_edges.size(), fast_compute_edge_links(recomputed).num_open_edges);
+
+	// same result for any number of threads
+	EXPECT_EQ(ra.boundary_edges, rb.boundary_edges);
+	EXPECT_EQ(ra.vert_remap, rb.vert_remap);
+}
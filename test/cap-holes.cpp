@@ -1,4 +1,5 @@
 #include <smesh/smesh.hpp>
+#include <smesh/allocator.hpp>
 
 #include <smesh/edge-links.hpp>
 #include <smesh/vert-poly-links.hpp>
@@ -9,16 +10,53 @@
 
 #include <smesh/io.hpp>
 
+#include <smesh/parallel.hpp>
+
 #include <gtest/gtest.h>
 
 #include "common.hpp"
 
+#include <cmath>
+#include <memory_resource>
+
 using namespace smesh;
 
 
 
 
 using Mesh = Smesh<double>;
+using Arena_Mesh = Smesh_Builder<double>::Allocator< Arena_Allocator<char> >::Smesh;
+
+
+
+
+namespace {
+	// closed n x n torus grid without quads (i,j) where i and j are divisible by 3: (n/3)^2
+	// square holes that don't touch each other
+	template<class MESH>
+	MESH get_torus_with_holes(int n) {
+		MESH mesh;
+
+		for(int i=0; i<n; ++i) {
+			for(int j=0; j<n; ++j) {
+				const double u = 2 * M_PI * i / n;
+				const double v = 2 * M_PI * j / n;
+				mesh.verts.add((2 + cos(v)) * cos(u), (2 + cos(v)) * sin(u), sin(v));
+			}
+		}
+
+		for(int i=0; i<n; ++i) {
+			for(int j=0; j<n; ++j) {
+				if(i % 3 == 0 && j % 3 == 0) continue;
+				const int i1 = (i+1) % n;
+				const int j1 = (j+1) % n;
+				add_quad(mesh, i*n + j, i1*n + j, i1*n + j1, i*n + j1);
+			}
+		}
+
+		return mesh;
+	}
+}
 
 
 
@@ -67,6 +105,96 @@ TEST(Cap_holes, bunny_holes_ply) {
 
 
 
+TEST(Cap_holes, bunny_holes_ply_threads) {
+
+	auto mesh1 = load_ply<Mesh>("bunny-holes.ply");
+	auto mesh4 = load_ply<Mesh>("bunny-holes.ply");
+
+	fast_compute_edge_links(mesh1);
+	fast_compute_edge_links(mesh4);
+
+	compute_vert_poly_links(mesh1);
+	compute_vert_poly_links(mesh4);
+
+	Scoped_Num_Threads threads(1);
+	auto r1 = cap_holes(mesh1);
+
+	threads.set(4);
+	auto r4 = cap_holes(mesh4);
+
+	EXPECT_EQ(5, r4.num_holes_capped);
+	EXPECT_EQ(r1.num_polys_created, r4.num_polys_created);
+
+	EXPECT_TRUE( is_solid(mesh1) );
+	EXPECT_TRUE( is_solid(mesh4) );
+}
+
+
+
+
+// perimeters above the parallel threshold, with a non-thread-safe arena on the calling thread
+TEST(Cap_holes, torus_holes_threads) {
+	constexpr int n = 120;
+	constexpr int num_holes = (n/3) * (n/3);
+
+	std::pmr::monotonic_buffer_resource arena;
+	Scoped_Memory_Resource scope(&arena);
+
+	auto mesh1 = get_torus_with_holes<Arena_Mesh>(n);
+	auto mesh4 = get_torus_with_holes<Arena_Mesh>(n);
+
+	fast_compute_edge_links(mesh1);
+	fast_compute_edge_links(mesh4);
+
+	compute_vert_poly_links(mesh1);
+	compute_vert_poly_links(mesh4);
+
+	Scoped_Num_Threads threads(1);
+	auto r1 = cap_holes(mesh1);
+
+	threads.set(4);
+	auto r4 = cap_holes(mesh4);
+
+	EXPECT_EQ(num_holes, r1.num_holes_capped);
+	EXPECT_EQ(num_holes, r4.num_holes_capped);
+	EXPECT_EQ(2 * num_holes, r4.num_polys_created);
+
+	EXPECT_TRUE( is_solid(mesh1) );
+	EXPECT_TRUE( is_solid(mesh4) );
+
+	ASSERT_EQ(mesh1.polys.domain_end(), mesh4.polys.domain_end());
+	for(auto p : mesh1.polys) {
+		for(int i=0; i<3; ++i) EXPECT_EQ(p.verts[i].key, mesh4.polys[p.key].verts[i].key);
+	}
+}
+
+
+
+
+TEST(Cap_holes, cap_hole_single) {
+
+	auto mesh = get_cube_mesh<Mesh>();
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	mesh.polys[0].erase();
+	mesh.polys[1].erase();
+
+	int num_polys_created = 0;
+	for(auto p : mesh.polys) {
+		for(auto pe : p.edges) {
+			if(!pe().has_link) num_polys_created += cap_hole(pe).num_polys_created;
+		}
+	}
+
+	EXPECT_EQ(2, num_polys_created);
+
+	EXPECT_TRUE( is_solid(mesh) );
+}
+
+
+
 
 
 
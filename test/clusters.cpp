@@ -0,0 +1,168 @@
+#include <smesh/smesh.hpp>
+#include <smesh/allocator.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/clusters.hpp>
+#include <smesh/mesh-utils.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory_resource>
+#include <set>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+using Arena_Mesh = Smesh_Builder<double>::Allocator< Arena_Allocator<char> >::Smesh;
+
+
+
+
+namespace {
+	template<class MESH, class CLUSTERS>
+	void check_clusters(const MESH& mesh, const CLUSTERS& clusters, int max_verts, int max_polys) {
+		int num_polys = 0;
+		for(auto p : mesh.polys) {
+			++num_polys;
+			ASSERT_NE(-1, clusters.poly_cluster[p.key]);
+		}
+		EXPECT_EQ(num_polys, (int)clusters.polys.size());
+		EXPECT_EQ(num_polys * 3, (int)clusters.indices.size());
+
+		// vert key -> colors of clusters using it
+		std::map<int, std::set<int>> vert_colors;
+		std::map<int, int> vert_num_clusters;
+
+		for(int i=0; i<(int)clusters.clusters.size(); ++i) {
+			const auto& c = clusters.clusters[i];
+			EXPECT_GT(c.num_polys(), 0);
+			EXPECT_LE(c.num_polys(), max_polys);
+			EXPECT_LE(c.num_verts(), max_verts);
+			EXPECT_LT(c.color, clusters.num_colors);
+
+			for(int j=c.polys_begin; j<c.polys_end; ++j) {
+				const int p = clusters.polys[j];
+				EXPECT_EQ(i, clusters.poly_cluster[p]);
+
+				// local indices map back to poly verts
+				for(int k=0; k<3; ++k) {
+					const int local = clusters.indices[j*3 + k];
+					ASSERT_LT(local, c.num_verts());
+					EXPECT_EQ(mesh.polys[p].verts[k].vert.key, clusters.verts[c.verts_begin + local]);
+				}
+
+				// normal cone
+				auto normal = compute_poly_normal(mesh.polys[p]);
+				EXPECT_GE(normal.dot(c.cone_axis), c.cone_cutoff - 1e-9);
+			}
+
+			for(int j=c.verts_begin; j<c.verts_end; ++j) {
+				const auto pos = mesh.verts[clusters.verts[j]].pos();
+				EXPECT_LE((pos - c.center).norm(), c.radius + 1e-9);
+				EXPECT_TRUE( (pos.array() >= c.min.array()).all() );
+				EXPECT_TRUE( (pos.array() <= c.max.array()).all() );
+
+				vert_colors[clusters.verts[j]].insert(c.color);
+				++vert_num_clusters[clusters.verts[j]];
+			}
+		}
+
+		// clusters sharing a vert have different colors
+		for(const auto& [v, colors] : vert_colors) EXPECT_EQ(vert_num_clusters[v], (int)colors.size());
+	}
+}
+
+
+
+
+TEST(Partition_into_clusters, cube) {
+	auto mesh = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(mesh);
+
+	auto clusters = partition_into_clusters(mesh, 8, 12);
+	ASSERT_EQ(1, (int)clusters.clusters.size());
+	EXPECT_EQ(12, clusters.clusters[0].num_polys());
+	EXPECT_EQ(8, clusters.clusters[0].num_verts());
+	EXPECT_EQ(1, clusters.num_colors);
+
+	// normals of a closed mesh are not in a cone
+	EXPECT_LE(clusters.clusters[0].cone_cutoff, 0);
+
+	check_clusters(mesh, clusters, 8, 12);
+}
+
+
+
+TEST(Partition_into_clusters, bunny_ply) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+
+	for(int num_threads : {1, 4}) {
+		Scoped_Num_Threads threads(num_threads);
+
+		auto clusters = partition_into_clusters(mesh, 64, 124);
+		check_clusters(mesh, clusters, 64, 124);
+
+		// meshlets are mostly full
+		EXPECT_LT((int)clusters.clusters.size(), mesh.polys.domain_end() / 50);
+	}
+}
+
+
+
+// regions grow on worker threads, while the arena resource is installed on this thread only
+TEST(Partition_into_clusters, bunny_ply_arena_threads) {
+	std::pmr::monotonic_buffer_resource arena;
+	Scoped_Memory_Resource scope(&arena);
+
+	auto mesh = load_ply<Arena_Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+
+	auto expected_mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(expected_mesh);
+
+	Scoped_Num_Threads threads(4);
+	auto clusters = partition_into_clusters(mesh, 64, 124);
+	check_clusters(mesh, clusters, 64, 124);
+
+	auto expected = partition_into_clusters(expected_mesh, 64, 124);
+	EXPECT_EQ(expected.polys, clusters.polys);
+	EXPECT_EQ(expected.verts, clusters.verts);
+	EXPECT_EQ(expected.poly_cluster, clusters.poly_cluster);
+}
+
+
+
+TEST(Partition_into_clusters, parallel_for_clusters) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+
+	Scoped_Num_Threads threads(4);
+	auto clusters = partition_into_clusters(mesh, 64, 124);
+
+	// clusters that run at once don't share verts: unsynchronized increments don't race
+	std::vector<int> counts(mesh.verts.domain_end(), 0);
+	std::atomic<int> num_calls{0};
+	parallel_for_clusters(clusters, [&](int c) {
+		const auto& cluster = clusters.clusters[c];
+		for(int i=cluster.verts_begin; i<cluster.verts_end; ++i) ++counts[ clusters.verts[i] ];
+		++num_calls;
+	});
+
+	EXPECT_EQ((int)clusters.clusters.size(), num_calls);
+
+	std::vector<int> expected(mesh.verts.domain_end(), 0);
+	for(auto v : clusters.verts) ++expected[v];
+	EXPECT_EQ(expected, counts);
+}
@@ -14,12 +14,15 @@
 
 #include "common.hpp"
 
+#include <vector>
+
 using namespace smesh;
 
 
 
 
 using Mesh = Smesh<double>;
+using Mesh_Edge_Links = Smesh_Builder<double>::Rem_Flags<VERT_POLY_LINKS>::Smesh;
 
 
 
@@ -70,3 +73,66 @@ TEST(Fast_collapse_edges, bunny_ply) {
 
 
 
+TEST(Fast_collapse_edges, bunny_ply_solid_edge_links_only) {
+
+	auto mesh = load_ply<Mesh_Edge_Links>("bunny-holes.ply");
+	EXPECT_FALSE( mesh.verts.empty() );
+
+	fast_compute_edge_links(mesh);
+
+	cap_holes(mesh);
+
+	EXPECT_TRUE( is_solid(mesh) );
+
+	auto r = fast_collapse_edges(mesh, 0.01);
+	EXPECT_GT( r.num_edges_collapsed, 0 );
+
+	EXPECT_TRUE( is_solid(mesh) );
+}
+
+
+
+
+// two octahedra touching at a vert: its one-ring covers only half of its polys
+TEST(Fast_collapse_edges, bowtie_edge_links_only) {
+	Mesh_Edge_Links mesh;
+
+	const int shared = mesh.verts.add(0, 0, 0);
+
+	auto add_octahedron = [&](double z, bool top_shared) {
+		const int px = mesh.verts.add( 1, 0, z);
+		const int nx = mesh.verts.add(-1, 0, z);
+		const int py = mesh.verts.add(0,  1, z);
+		const int ny = mesh.verts.add(0, -1, z);
+		const int pz = top_shared ? shared : mesh.verts.add(0, 0, z + 1);
+		const int nz = top_shared ? mesh.verts.add(0, 0, z - 1) : shared;
+
+		mesh.polys.add(pz, px, py);
+		mesh.polys.add(pz, py, nx);
+		mesh.polys.add(pz, nx, ny);
+		mesh.polys.add(pz, ny, px);
+		mesh.polys.add(nz, py, px);
+		mesh.polys.add(nz, nx, py);
+		mesh.polys.add(nz, ny, nx);
+		mesh.polys.add(nz, px, ny);
+	};
+
+	add_octahedron( 1, false);
+	add_octahedron(-1, true);
+
+	EXPECT_EQ(0, fast_compute_edge_links(mesh).num_open_edges);
+
+	auto r = fast_collapse_edges(mesh, 10);
+	EXPECT_GT(r.num_edges_collapsed, 0);
+
+	std::vector<bool> is_live(mesh.verts.domain_end(), false);
+	for(auto v : mesh.verts) is_live[v.key] = true;
+
+	EXPECT_TRUE(is_live[shared]);
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) EXPECT_TRUE(is_live[pv.key]) << "poly " << p.key;
+	}
+
+	EXPECT_TRUE( has_valid_edge_links(mesh) );
+	EXPECT_TRUE( has_all_edge_links(mesh) );
+}
@@ -1,5 +1,30 @@
 #pragma once
 
+#include <smesh/parallel.hpp>
+
+
+
+
+
+// set the number of threads for the scope (see smesh::set_num_threads), restore the previous
+// setting on exit, also when an ASSERT returns early
+class Scoped_Num_Threads {
+public:
+	explicit Scoped_Num_Threads(int num_threads) : previous(smesh::internal::num_threads_setting()) {
+		smesh::set_num_threads(num_threads);
+	}
+
+	~Scoped_Num_Threads() { smesh::set_num_threads(previous); }
+
+	void set(int num_threads) { smesh::set_num_threads(num_threads); }
+
+	Scoped_Num_Threads(const Scoped_Num_Threads&) = delete;
+	Scoped_Num_Threads& operator=(const Scoped_Num_Threads&) = delete;
+
+private:
+	const int previous;
+};
+
 
 
 
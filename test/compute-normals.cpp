@@ -2,6 +2,7 @@
 
 #include <smesh/smesh.hpp>
 #include <smesh/compute-normals.hpp>
+#include <smesh/edge-links.hpp>
 //#include <smesh/io.hpp>
 
 #include <gtest/gtest.h>
@@ -109,3 +110,26 @@ TEST(Compute_vert_normals, cube_external) {
 
 
 
+TEST(Compute_vert_normal, cube_ring) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Flags<EDGE_LINKS>::Smesh
+	>();
+
+	fast_compute_edge_links(mesh);
+
+	auto s = 1.0 / sqrt(3);
+
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			auto normal = compute_vert_normal(pv);
+
+			for(int i=0; i<3; ++i) {
+				EXPECT_DOUBLE_EQ(pv.pos[i] < 0 ? -s : s, normal[i]);
+			}
+		}
+	}
+}
+
+
+
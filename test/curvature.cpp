@@ -0,0 +1,134 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/curvature.hpp>
+#include <smesh/subdivision.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+struct Vert_Props_curvature {
+	Vert_Curvature<double> curvature;
+};
+
+
+using Mesh = Smesh<double>;
+using Mesh_Curvature = Smesh_Builder<double>::Vert_Props< Vert_Props_curvature >::Smesh;
+
+
+
+
+namespace {
+	template<class MESH>
+	MESH get_icosahedron_mesh() {
+		MESH mesh;
+
+		const double t = (1 + sqrt(5)) / 2;
+		const double xyz[12][3] = {
+			{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+			{0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+			{t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1} };
+		for(const auto& p : xyz) mesh.verts.add(p[0], p[1], p[2]);
+
+		const int polys[20][3] = {
+			{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+			{1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+			{3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+			{4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1} };
+		for(const auto& p : polys) mesh.polys.add(p[0], p[1], p[2]);
+
+		return mesh;
+	}
+
+	// open cylinder of radius 1 along z
+	Mesh get_cylinder_mesh(int num_segments, int num_rings) {
+		Mesh mesh;
+
+		const double h = 2 * M_PI / num_segments;
+		for(int i=0; i<num_rings; ++i) {
+			for(int j=0; j<num_segments; ++j) {
+				const double phi = 2 * M_PI * j / num_segments;
+				mesh.verts.add(cos(phi), sin(phi), i * h);
+			}
+		}
+
+		auto get_vert = [&](int ring, int segment) { return ring * num_segments + segment % num_segments; };
+
+		for(int i=0; i+1<num_rings; ++i) {
+			for(int j=0; j<num_segments; ++j) {
+				mesh.polys.add(get_vert(i, j), get_vert(i, j+1), get_vert(i+1, j+1));
+				mesh.polys.add(get_vert(i, j), get_vert(i+1, j+1), get_vert(i+1, j));
+			}
+		}
+
+		return mesh;
+	}
+}
+
+
+
+
+TEST(Compute_vert_curvatures, sphere_props) {
+	auto mesh = get_icosahedron_mesh<Mesh_Curvature>();
+	fast_compute_edge_links(mesh);
+	subdivide(mesh, 3, Subdivision_Scheme::MIDPOINT);
+
+	const double radius = 2;
+	for(auto v : mesh.verts) v.pos = v.pos().normalized() * radius;
+
+	compute_vert_curvatures(mesh);
+
+	// Gauss-Bonnet: total angle defect of a closed genus 0 mesh is 4 pi
+	double angle_defect = 0;
+	double area = 0;
+	for(auto v : mesh.verts) {
+		const auto& c = v.props().curvature;
+		angle_defect += c.angle_defect;
+		area += c.area;
+
+		EXPECT_NEAR(1 / radius, c.mean, 0.05);
+		EXPECT_NEAR(1 / (radius * radius), c.gaussian, 0.05);
+		EXPECT_GE(c.k1, c.k2);
+		EXPECT_NEAR(0, c.dir1.dot(v.pos()), 1e-9);
+	}
+
+	EXPECT_NEAR(4 * M_PI, angle_defect, 1e-9);
+	EXPECT_NEAR(4 * M_PI * radius * radius, area, 0.5);
+}
+
+
+
+TEST(Compute_vert_curvatures, cylinder_external_array) {
+	auto mesh = get_cylinder_mesh(64, 20);
+	fast_compute_edge_links(mesh);
+
+	std::vector<Vert_Curvature<double>> curvatures(mesh.verts.domain_end());
+	compute_vert_curvatures(mesh, [&](int v) -> auto& { return curvatures[v]; });
+
+	for(auto v : mesh.verts) {
+		const auto& c = curvatures[v.key];
+		EXPECT_GT(c.area, 0);
+
+		const bool boundary = v.key < 64 || v.key >= 64 * 19;
+		if(boundary) {
+			EXPECT_NEAR(0, c.angle_defect, 1e-9);
+			continue;
+		}
+
+		EXPECT_NEAR(0, c.gaussian, 1e-9);
+		EXPECT_NEAR(0.5, c.mean, 0.05);
+		EXPECT_NEAR(1, c.k1, 0.1);
+		EXPECT_NEAR(0, c.k2, 0.1);
+
+		// max curvature around the cylinder, min curvature along the axis
+		EXPECT_LT(std::abs(c.dir1[2]), 0.1);
+		EXPECT_GT(std::abs(c.dir2[2]), 0.9);
+	}
+}
@@ -0,0 +1,150 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/derived-data-cache.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+TEST(Fingerprint, bunny) {
+	auto mesh_a = load_ply<Mesh>("bunny-holes.ply");
+	auto mesh_b = load_ply<Mesh>("bunny-holes.ply");
+
+	Scoped_Num_Threads threads(1);
+	auto fingerprint = compute_fingerprint(mesh_a);
+
+	threads.set(4);
+	EXPECT_EQ(compute_fingerprint(mesh_a), fingerprint);
+	EXPECT_EQ(compute_fingerprint(mesh_b), fingerprint);
+
+	mesh_b.verts[10].pos[0] += 1e-9;
+	EXPECT_NE(compute_fingerprint(mesh_b), fingerprint);
+	mesh_b.verts[10].pos[0] -= 1e-9;
+
+	std::swap(mesh_b.polys.raw(5).verts[0].key, mesh_b.polys.raw(5).verts[1].key);
+	EXPECT_NE(compute_fingerprint(mesh_b), fingerprint);
+}
+
+
+
+
+TEST(Derived_data_cache, bunny) {
+	auto cache_dir = std::filesystem::temp_directory_path() / "smesh-test-derived-data-cache";
+	std::filesystem::remove_all(cache_dir);
+
+	const auto what = Derived_Data::EDGE_LINKS | Derived_Data::VERT_POLY_LINKS | Derived_Data::VERT_NORMALS;
+
+	auto mesh_a = load_ply<Mesh>("bunny-holes.ply");
+	std::vector<Mesh::Pos> normals_a(mesh_a.verts.domain_end());
+	auto ra = compute_derived_data(mesh_a, cache_dir, what, [&](int v) -> auto& { return normals_a[v]; });
+	EXPECT_FALSE(ra.from_cache);
+	EXPECT_TRUE( is_solid(mesh_a, ALLOW_HOLES) );
+
+	auto mesh_b = load_ply<Mesh>("bunny-holes.ply");
+	std::vector<Mesh::Pos> normals_b(mesh_b.verts.domain_end());
+	auto rb = compute_derived_data(mesh_b, cache_dir, what, [&](int v) -> auto& { return normals_b[v]; });
+	EXPECT_TRUE(rb.from_cache);
+	EXPECT_EQ(rb.fingerprint, ra.fingerprint);
+	EXPECT_TRUE( is_solid(mesh_b, ALLOW_HOLES) );
+	EXPECT_EQ(normals_b, normals_a);
+
+	for(auto p : mesh_a.polys) {
+		for(auto pe : p.edges) {
+			auto pe_b = pe.handle(mesh_b);
+			ASSERT_EQ(pe.has_link, pe_b.has_link);
+			if(pe.has_link) {
+				EXPECT_EQ(pe.link().handle, pe_b.link().handle);
+			}
+		}
+	}
+
+	// subset of cached data
+	auto mesh_c = load_ply<Mesh>("bunny-holes.ply");
+	EXPECT_TRUE( compute_derived_data(mesh_c, cache_dir, Derived_Data::VERT_POLY_LINKS).from_cache );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh_c) );
+
+	std::filesystem::remove_all(cache_dir);
+}
+
+
+
+TEST(Derived_data_cache, bunny_truncated_or_corrupt) {
+	auto cache_dir = std::filesystem::temp_directory_path() / "smesh-test-derived-data-cache-truncated";
+	std::filesystem::remove_all(cache_dir);
+
+	const auto what = Derived_Data::EDGE_LINKS | Derived_Data::VERT_POLY_LINKS;
+
+	auto mesh_a = load_ply<Mesh>("bunny-holes.ply");
+	auto ra = compute_derived_data(mesh_a, cache_dir, what);
+	EXPECT_FALSE(ra.from_cache);
+
+	const auto path = smesh::internal::get_derived_data_path(cache_dir, ra.fingerprint);
+	ASSERT_TRUE( std::filesystem::exists(path) );
+	const auto file_size = std::filesystem::file_size(path);
+
+	// no temporary files left behind
+	EXPECT_EQ(1, std::distance(std::filesystem::directory_iterator(cache_dir), std::filesystem::directory_iterator()));
+
+	// cut in the middle of a section: recomputed (and the cache rewritten)
+	std::filesystem::resize_file(path, file_size / 2);
+
+	auto mesh_b = load_ply<Mesh>("bunny-holes.ply");
+	EXPECT_FALSE( compute_derived_data(mesh_b, cache_dir, what).from_cache );
+	EXPECT_TRUE( is_solid(mesh_b, ALLOW_HOLES) );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh_b) );
+	EXPECT_EQ(file_size, std::filesystem::file_size(path));
+
+	// wrong size of the first section (right after the header)
+	{
+		std::fstream s(path, std::ios::binary | std::ios::in | std::ios::out);
+		s.seekp(sizeof(smesh::internal::Derived_Data_Header));
+		const uint64_t size = uint64_t(1) << 40;
+		s.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	}
+
+	auto mesh_c = load_ply<Mesh>("bunny-holes.ply");
+	EXPECT_FALSE( compute_derived_data(mesh_c, cache_dir, what).from_cache );
+	EXPECT_TRUE( is_solid(mesh_c, ALLOW_HOLES) );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh_c) );
+
+	auto mesh_d = load_ply<Mesh>("bunny-holes.ply");
+	EXPECT_TRUE( compute_derived_data(mesh_d, cache_dir, what).from_cache );
+	EXPECT_TRUE( is_solid(mesh_d, ALLOW_HOLES) );
+
+	// in-range, but one-way edge link of the first edge
+	{
+		std::fstream s(path, std::ios::binary | std::ios::in | std::ios::out);
+		const auto record = std::streamoff(sizeof(smesh::internal::Derived_Data_Header) + sizeof(uint64_t));
+		int32_t link[2];
+		s.seekg(record);
+		s.read(reinterpret_cast<char*>(link), sizeof(link));
+		if(link[0] == -1) link[0] = link[1] = 1;
+		else link[1] = (link[1] + 1) % Mesh::POLY_SIZE;
+		s.seekp(record);
+		s.write(reinterpret_cast<const char*>(link), sizeof(link));
+	}
+
+	auto mesh_e = load_ply<Mesh>("bunny-holes.ply");
+	EXPECT_FALSE( compute_derived_data(mesh_e, cache_dir, what).from_cache );
+	EXPECT_TRUE( is_solid(mesh_e, ALLOW_HOLES) );
+	EXPECT_TRUE( has_valid_edge_links(mesh_e) );
+
+	std::filesystem::remove_all(cache_dir);
+}
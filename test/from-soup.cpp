@@ -0,0 +1,110 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/from-soup.hpp>
+#include <smesh/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh_Builder<double>::Add_Flags<EDGE_LINKS | VERT_POLY_LINKS>::Smesh;
+
+
+
+
+namespace {
+	template<class MESH>
+	std::vector<Eigen::Vector3f> get_soup(const MESH& mesh) {
+		std::vector<Eigen::Vector3f> r;
+		for(auto p : mesh.polys) {
+			for(auto pv : p.verts) r.push_back( pv.vert.pos().template cast<float>() );
+		}
+		return r;
+	}
+}
+
+
+
+
+TEST(From_Soup, cube) {
+	auto soup = get_soup( get_cube_mesh<Mesh>() );
+	ASSERT_EQ(36, (int)soup.size());
+
+	// degenerate after deduplication
+	soup.insert(soup.end(), {soup[0], soup[1], soup[0]});
+
+	auto mesh = from_soup<Mesh>(soup);
+
+	EXPECT_EQ(8, mesh.verts.domain_end());
+	EXPECT_EQ(12, mesh.polys.domain_end());
+
+	EXPECT_TRUE( has_valid_edge_links(mesh) );
+	EXPECT_TRUE( has_all_edge_links(mesh) );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh) );
+	EXPECT_TRUE( check_solid(mesh).is_solid );
+
+	// keys follow position order
+	EXPECT_EQ(Mesh::Pos(-1,-1,-1), mesh.verts[0].pos());
+	EXPECT_EQ(Mesh::Pos( 1, 1, 1), mesh.verts[7].pos());
+
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			EXPECT_EQ(soup[p.key*3 + pv.idx_in_poly].cast<double>(), pv.vert.pos());
+		}
+	}
+}
+
+
+
+
+TEST(From_Soup, parallel) {
+	// closed grid torus, 2 * 200^2 polys
+	const int n = 200;
+	auto get_pos = [n](int x, int y) {
+		x %= n; y %= n;
+		const float a = 2 * float(M_PI) * x / n;
+		const float b = 2 * float(M_PI) * y / n;
+		return Eigen::Vector3f( (2 + std::cos(b)) * std::cos(a), (2 + std::cos(b)) * std::sin(a), std::sin(b) );
+	};
+
+	using Triangle = std::array<Eigen::Vector3f, 3>;
+	std::vector<Triangle> triangles;
+	for(int y=0; y<n; ++y) {
+		for(int x=0; x<n; ++x) {
+			triangles.push_back({{get_pos(x,y), get_pos(x+1,y), get_pos(x+1,y+1)}});
+			triangles.push_back({{get_pos(x,y), get_pos(x+1,y+1), get_pos(x,y+1)}});
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+
+	std::vector<Eigen::Vector3f> soup;
+	for(const auto& t : triangles) soup.insert(soup.end(), t.begin(), t.end());
+
+	auto expected = from_soup<Mesh>(soup);
+
+	Scoped_Num_Threads threads(4);
+	auto mesh = from_soup<Mesh>(soup);
+
+	EXPECT_EQ(n*n, mesh.verts.domain_end());
+	EXPECT_EQ(expected.verts.domain_end(), mesh.verts.domain_end());
+	EXPECT_EQ(expected.polys.domain_end(), mesh.polys.domain_end());
+	EXPECT_TRUE( has_valid_edge_links(mesh) );
+	EXPECT_TRUE( has_all_edge_links(mesh) );
+
+	for(auto v : mesh.verts) {
+		EXPECT_EQ(expected.verts[v.key].pos(), v.pos());
+	}
+}
@@ -0,0 +1,137 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/geodesics.hpp>
+#include <smesh/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// planar n x n triangular lattice (equilateral triangles)
+	Mesh get_lattice(int n) {
+		Mesh mesh;
+
+		for(int y=0; y<n; ++y) {
+			for(int x=0; x<n; ++x) mesh.verts.add(x + 0.5 * (y % 2), y * sqrt(0.75), 0);
+		}
+
+		for(int y=0; y+1<n; ++y) {
+			for(int x=0; x+1<n; ++x) {
+				const int a = y*n + x;
+				const int b = a + 1;
+				const int c = a + n;
+				const int d = c + 1;
+				if(y % 2 == 0) {
+					mesh.polys.add(a, b, c);
+					mesh.polys.add(b, d, c);
+				}
+				else {
+					mesh.polys.add(a, d, c);
+					mesh.polys.add(a, b, d);
+				}
+			}
+		}
+
+		return mesh;
+	}
+
+	// mean relative error vs. euclidean distance, for verts farther than 10
+	double get_far_error(const Mesh& mesh, int source, const std::vector<double>& dists) {
+		double sum = 0;
+		int num = 0;
+		for(auto v : mesh.verts) {
+			const double expected = (v.pos() - mesh.verts[source].pos()).norm();
+			if(expected < 10) continue;
+			sum += std::abs(dists[v.key] - expected) / expected;
+			++num;
+		}
+		return sum / num;
+	}
+}
+
+
+
+
+TEST(Geodesics, lattice_methods) {
+	const int n = 41;
+	auto mesh = get_lattice(n);
+	const int source = (n/2) * n + n/2;
+
+	auto dijkstra = compute_geodesic_distances(mesh, std::vector<int>{source}, Geodesic_Method::DIJKSTRA);
+	auto fast_marching = compute_geodesic_distances(mesh, std::vector<int>{source});
+	auto heat = compute_geodesic_distances(mesh, std::vector<int>{source}, Geodesic_Method::HEAT);
+
+	EXPECT_EQ(0, dijkstra[source]);
+	EXPECT_EQ(0, fast_marching[source]);
+	EXPECT_EQ(0, heat[source]);
+
+	// paths along edges are never shorter than straight lines
+	for(auto v : mesh.verts) {
+		EXPECT_GE(dijkstra[v.key], (v.pos() - mesh.verts[source].pos()).norm() - 1e-9);
+	}
+
+	EXPECT_LT(get_far_error(mesh, source, fast_marching), 0.03);
+	EXPECT_LT(get_far_error(mesh, source, heat), 0.05);
+	EXPECT_LT(get_far_error(mesh, source, fast_marching), get_far_error(mesh, source, dijkstra));
+}
+
+
+
+TEST(Geodesics, max_distance) {
+	const int n = 41;
+	auto mesh = get_lattice(n);
+	const int source = (n/2) * n + n/2;
+
+	auto dists = compute_geodesic_distances(mesh, std::vector<int>{source}, Geodesic_Method::FAST_MARCHING, 5.0);
+
+	int num_reached = 0;
+	for(auto v : mesh.verts) {
+		const double euclidean = (v.pos() - mesh.verts[source].pos()).norm();
+		if(std::isfinite(dists[v.key])) {
+			EXPECT_LE(dists[v.key], 5);
+			++num_reached;
+		}
+		if(euclidean < 4) EXPECT_TRUE(std::isfinite(dists[v.key]));
+	}
+	EXPECT_LT(num_reached, n * n / 4);
+}
+
+
+
+TEST(Geodesics, multi_source_and_batch) {
+	const int n = 30;
+	auto mesh = get_lattice(n);
+	mesh.verts.add(100, 100, 100);
+	mesh.verts[n*n].erase();
+
+	const std::vector<std::vector<int>> source_sets = {{0}, {n*n - 1}, {0, n*n - 1}};
+
+	Scoped_Num_Threads threads(4);
+	auto batch = compute_geodesic_distances_batch(mesh, source_sets, Geodesic_Method::DIJKSTRA);
+
+	ASSERT_EQ(3, (int)batch.size());
+
+	for(int i=0; i<3; ++i) {
+		EXPECT_EQ(compute_geodesic_distances(mesh, source_sets[i], Geodesic_Method::DIJKSTRA), batch[i]);
+		EXPECT_TRUE(std::isinf(batch[i][n*n]));
+	}
+
+	// multi-source: distance to the nearest source
+	for(auto v : mesh.verts) {
+		EXPECT_DOUBLE_EQ(std::min(batch[0][v.key], batch[1][v.key]), batch[2][v.key]);
+	}
+}
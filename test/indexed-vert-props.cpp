@@ -0,0 +1,224 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/collapse-edges.hpp>
+#include <smesh/indexed-vert-props.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace smesh;
+
+
+
+
+struct Indexed_Vert_Props_texcoords {
+	Eigen::Vector2f texcoords = {0,0};
+
+	Indexed_Vert_Props_texcoords operator*(double x) const {
+		return {(texcoords * x).eval()};
+	}
+
+	Indexed_Vert_Props_texcoords operator+(const Indexed_Vert_Props_texcoords& o) const {
+		return {texcoords + o.texcoords};
+	}
+};
+
+using Mesh = Smesh_Builder<double>::Indexed_Vert_Props< Indexed_Vert_Props_texcoords >::Smesh;
+
+using Journal_Mesh = Smesh_Builder<double>::Add_Flags< JOURNAL >
+	::Indexed_Vert_Props< Indexed_Vert_Props_texcoords >::Smesh;
+
+
+
+
+
+namespace {
+
+	//
+	// 3x3 verts grid (2x2 quads) in xy plane, with texcoords = (x,y) in the left column of quads
+	// and (x+10,y) in the right one - so there's a uv seam along x = 1
+	//
+	std::string write_grid_ply() {
+		std::string file_name = "indexed-vert-props-grid.ply";
+		std::ofstream f(file_name, std::ios::binary);
+
+		f << "ply\n" << "format binary_little_endian 1.0\n";
+		f << "element vertex 9\n" << "property float x\n" << "property float y\n" << "property float z\n";
+		f << "element face 8\n" << "property list uchar int vertex_indices\n" << "property list uchar float texcoord\n";
+		f << "end_header\n";
+
+		for(int y=0; y<3; ++y) {
+			for(int x=0; x<3; ++x) {
+				float pos[3] = {float(x), float(y), 0};
+				f.write(reinterpret_cast<const char*>(pos), sizeof(pos));
+			}
+		}
+
+		for(int qy=0; qy<2; ++qy) {
+			for(int qx=0; qx<2; ++qx) {
+				int a = qy*3 + qx;
+				int quad[2][3] = {{a, a+1, a+4}, {a, a+4, a+3}};
+				for(auto& tri : quad) {
+					uint8_t n = 3;
+					f.write(reinterpret_cast<const char*>(&n), 1);
+					f.write(reinterpret_cast<const char*>(tri), sizeof(tri));
+
+					uint8_t nt = 6;
+					f.write(reinterpret_cast<const char*>(&nt), 1);
+					for(int v : tri) {
+						float uv[2] = {float(v % 3 + (qx ? 10 : 0)), float(v / 3)};
+						f.write(reinterpret_cast<const char*>(uv), sizeof(uv));
+					}
+				}
+			}
+		}
+
+		return file_name;
+	}
+
+
+
+	template<class MESH>
+	MESH load_grid() {
+		auto file_name = write_grid_ply();
+		auto mesh = load_ply<MESH>(file_name);
+		std::remove(file_name.c_str());
+
+		fast_compute_edge_links(mesh);
+		compute_vert_poly_links(mesh);
+		return mesh;
+	}
+
+
+
+	template<class MESH>
+	auto find_edge(MESH& mesh, int a, int b) {
+		for(auto p : mesh.polys) {
+			for(auto pe : p.edges) {
+				if(pe.verts[0].key == a && pe.verts[1].key == b) return pe.handle;
+			}
+		}
+		ADD_FAILURE() << "edge not found";
+		return typename MESH::H_Poly_Edge{};
+	}
+
+
+
+	// -1: left column of quads, 1: right column
+	template<class POLY>
+	int get_side(const POLY& p) {
+		for(auto pv : p.verts) {
+			if(pv.vert.pos()[0] == 0) return -1;
+			if(pv.vert.pos()[0] == 2) return 1;
+		}
+		return 0;
+	}
+
+}
+
+
+
+
+
+TEST(Indexed_vert_props, load_ply) {
+	auto mesh = load_grid<Mesh>();
+
+	// 3 verts on each border, 3 seam verts with 2 entries each
+	EXPECT_EQ(12, (int)mesh.indexed_vert_props.size());
+
+	for(auto p : mesh.polys) {
+		int side = get_side(p);
+		for(auto pv : p.verts) {
+			Eigen::Vector2f expected(pv.vert.pos()[0] + (side == 1 ? 10 : 0), pv.vert.pos()[1]);
+			EXPECT_EQ(expected, pv.indexed_props().texcoords);
+		}
+	}
+
+	save_ply(mesh, "indexed-vert-props-saved.ply");
+	std::remove("indexed-vert-props-saved.ply");
+}
+
+
+
+
+TEST(Indexed_vert_props, collapse) {
+	auto mesh = load_grid<Mesh>();
+
+	// border edge 3->0, left side only
+	auto e = find_edge(mesh, 3, 0);
+	EXPECT_TRUE( collapse_edge(e(mesh), 0.5) );
+
+	EXPECT_EQ(13, (int)mesh.indexed_vert_props.size());
+	for(auto pv : mesh.verts[3].poly_links) {
+		EXPECT_EQ(Eigen::Vector2f(0, 0.5), pv.indexed_props().texcoords);
+	}
+
+	// seam edge 4->1: blended separately on both sides
+	e = find_edge(mesh, 4, 1);
+	EXPECT_TRUE( collapse_edge(e(mesh), 0.5) );
+
+	EXPECT_EQ(15, (int)mesh.indexed_vert_props.size());
+
+	int num_left = 0;
+	int num_right = 0;
+	for(auto pv : mesh.verts[4].poly_links) {
+		int side = get_side(pv.poly);
+		EXPECT_NE(0, side);
+		float u = side == 1 ? 11 : 1;
+		EXPECT_EQ(Eigen::Vector2f(u, 0.5), pv.indexed_props().texcoords);
+		++(side == 1 ? num_right : num_left);
+	}
+	EXPECT_GT(num_left, 0);
+	EXPECT_GT(num_right, 0);
+
+	// blended entries replaced the old ones
+	auto r = compact_indexed_vert_props(mesh);
+	EXPECT_EQ(6, r.num_entries_removed);
+	EXPECT_EQ(9, (int)mesh.indexed_vert_props.size());
+
+	for(auto pv : mesh.verts[4].poly_links) {
+		float u = get_side(pv.poly) == 1 ? 11 : 1;
+		EXPECT_EQ(Eigen::Vector2f(u, 0.5), pv.indexed_props().texcoords);
+	}
+}
+
+
+
+
+TEST(Indexed_vert_props, undo) {
+	auto mesh = load_grid<Journal_Mesh>();
+
+	auto get_texcoords = [&mesh]() {
+		std::vector<std::pair<float,float>> r;
+		for(auto p : mesh.polys) {
+			for(auto pv : p.verts) r.push_back({pv.indexed_props().texcoords[0], pv.indexed_props().texcoords[1]});
+		}
+		std::sort(r.begin(), r.end()); // undo re-adds polys with new keys
+		return r;
+	};
+
+	auto before = get_texcoords();
+
+	mesh.journal.begin();
+	auto e = find_edge(mesh, 4, 1);
+	EXPECT_TRUE( collapse_edge(e(mesh), 0.5) );
+	mesh.journal.commit();
+
+	auto after = get_texcoords();
+	EXPECT_NE(before.size(), after.size());
+
+	mesh.journal.undo();
+	EXPECT_EQ(before, get_texcoords());
+
+	mesh.journal.redo();
+	EXPECT_EQ(after, get_texcoords());
+}
@@ -0,0 +1,109 @@
+#include <smesh/smesh.hpp>
+#include <smesh/instrumentation.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/cap-holes.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+using namespace smesh;
+
+
+
+
+TEST(Instrumentation, timers_and_counters) {
+
+	reset_stats();
+
+	{
+		Scoped_Timer timer("test");
+		smesh::internal::count(Counter::PASSES, 2);
+	}
+
+	std::thread([]{
+		Scoped_Timer timer("test");
+		smesh::internal::count(Counter::PASSES, 3);
+	}).join();
+
+	auto stats = collect_stats();
+
+	EXPECT_EQ(5u, stats[Counter::PASSES]);
+	EXPECT_EQ(2, stats.timers["test"].count);
+	EXPECT_EQ(2u, stats.events.size());
+
+	std::ostringstream json;
+	write_stats_json(json, stats);
+	EXPECT_NE(std::string::npos, json.str().find("\"passes\": 5"));
+
+	std::ostringstream trace;
+	write_chrome_trace(trace, stats);
+	EXPECT_NE(std::string::npos, trace.str().find("\"name\": \"test\""));
+
+	reset_stats();
+	EXPECT_EQ(0u, collect_stats()[Counter::PASSES]);
+}
+
+
+
+
+// threads that exit hand their stats over to new threads: the registry doesn't grow per thread
+TEST(Instrumentation, short_lived_threads) {
+
+	reset_stats();
+
+	// this thread, and one slot for the worker
+	smesh::internal::get_thread_stats();
+	std::thread([]{ smesh::internal::get_thread_stats(); }).join();
+	const auto num_slots = smesh::internal::get_stats_registry().threads.size();
+
+	for(int i=0; i<100; ++i) {
+		std::thread([]{
+			Scoped_Timer timer("test");
+			smesh::internal::count(Counter::PASSES, 1);
+		}).join();
+	}
+
+	EXPECT_EQ(num_slots, smesh::internal::get_stats_registry().threads.size());
+
+	auto stats = collect_stats();
+	EXPECT_EQ(100u, stats[Counter::PASSES]);
+	EXPECT_EQ(100, stats.timers["test"].count);
+	EXPECT_EQ(100u, stats.events.size());
+
+	reset_stats();
+}
+
+
+
+
+#ifdef SMESH_INSTRUMENTATION
+
+TEST(Instrumentation, cap_holes) {
+
+	auto mesh = load_ply<Smesh<double>>("sphere-holes.ply");
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	reset_stats();
+
+	auto r = cap_holes(mesh);
+
+	auto stats = collect_stats();
+
+	EXPECT_EQ(r.num_polys_created, (int)stats[Counter::POLYS_CREATED]);
+	EXPECT_EQ(1, stats.timers["cap_holes"].count);
+	EXPECT_GT(stats[Counter::EDGE_LINKS_CREATED], 0u);
+}
+
+#endif
+
+
+
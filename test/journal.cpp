@@ -0,0 +1,207 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+#include <smesh/collapse-edges.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh_Journal = Smesh_Builder<double>::Add_Flags<JOURNAL>::Smesh;
+using Mesh_Journal_Edge_Links = Smesh_Builder<double>::Add_Flags<JOURNAL>::Rem_Flags<VERT_POLY_LINKS>::Smesh;
+
+
+
+// polys as position triples (starting with the smallest), sorted - independent of keys
+template<class MESH>
+auto get_triangles(const MESH& mesh) {
+	std::vector<std::array<double,9>> r;
+	for(auto p : mesh.polys) {
+		int first = 0;
+		for(int i=1; i<3; ++i) {
+			if(std::lexicographical_compare(p.verts[i].pos.data(), p.verts[i].pos.data()+3,
+					p.verts[first].pos.data(), p.verts[first].pos.data()+3)) first = i;
+		}
+
+		std::array<double,9> t;
+		for(int i=0; i<3; ++i) {
+			for(int j=0; j<3; ++j) t[i*3+j] = p.verts[(first+i)%3].pos[j];
+		}
+		r.push_back(t);
+	}
+	std::sort(r.begin(), r.end());
+	return r;
+}
+
+
+
+
+template<class MESH>
+void link_open_edges(MESH& mesh) {
+	for(auto p : mesh.polys) {
+		for(auto pe : p.edges) {
+			if(pe().has_link) continue;
+			for(auto o : mesh.polys) {
+				for(auto oe : o.edges) {
+					if(!oe().has_link && oe.verts[0].key == pe.verts[1].key && oe.verts[1].key == pe.verts[0].key) {
+						pe.link(oe);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+
+TEST(Journal, cube_add_erase) {
+	auto mesh = get_cube_mesh<Mesh_Journal>();
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	auto original = get_triangles(mesh);
+
+	mesh.journal.begin();
+	mesh.polys[0].erase();
+	mesh.polys[1].erase();
+	auto v = mesh.verts.add(-2, 0, 0);
+	for(auto p : {mesh.polys.add(0, 1, v.key), mesh.polys.add(1, 3, v.key), mesh.polys.add(3, 2, v.key), mesh.polys.add(2, 0, v.key)}) {
+		for(auto pv : p.verts) pv.vert.poly_links.add(pv);
+	}
+	link_open_edges(mesh);
+	mesh.journal.commit();
+
+	EXPECT_TRUE( is_solid(mesh) );
+	auto edited = get_triangles(mesh);
+	EXPECT_NE(edited, original);
+
+	EXPECT_TRUE( mesh.journal.undo() );
+	EXPECT_FALSE( mesh.journal.can_undo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), original);
+
+	EXPECT_TRUE( mesh.journal.redo() );
+	EXPECT_FALSE( mesh.journal.can_redo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), edited);
+
+	EXPECT_TRUE( mesh.journal.undo() );
+	EXPECT_EQ(get_triangles(mesh), original);
+}
+
+
+
+
+template<class MESH>
+void test_journal_collapse() {
+	auto mesh = load_ply<MESH>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	if constexpr(MESH::Has_Vert_Poly_Links) compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+
+	auto original = get_triangles(mesh);
+
+	// rollback
+	mesh.journal.begin();
+	fast_collapse_edges(mesh, 0.005);
+	mesh.journal.rollback();
+
+	EXPECT_FALSE( mesh.journal.can_undo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), original);
+
+	// 2 transactions
+	mesh.journal.begin();
+	fast_collapse_edges(mesh, 0.005);
+	mesh.journal.commit();
+	auto step_1 = get_triangles(mesh);
+
+	mesh.journal.begin();
+	fast_collapse_edges(mesh, 0.01);
+	clean_flat_surfaces_on_edges(mesh);
+	mesh.journal.commit();
+	auto step_2 = get_triangles(mesh);
+
+	EXPECT_LT(step_2.size(), step_1.size());
+	EXPECT_LT(step_1.size(), original.size());
+
+	EXPECT_TRUE( mesh.journal.undo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), step_1);
+
+	EXPECT_TRUE( mesh.journal.undo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), original);
+
+	EXPECT_TRUE( mesh.journal.redo() );
+	EXPECT_TRUE( mesh.journal.redo() );
+	EXPECT_TRUE( is_solid(mesh) );
+	EXPECT_EQ(get_triangles(mesh), step_2);
+}
+
+TEST(Journal, bunny_collapse) {
+	test_journal_collapse<Mesh_Journal>();
+}
+
+TEST(Journal, bunny_collapse_edge_links_only) {
+	test_journal_collapse<Mesh_Journal_Edge_Links>();
+}
+
+
+
+TEST(Journal, cube_assignment_clears_history) {
+	auto mesh = get_cube_mesh<Mesh_Journal>();
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	mesh.journal.begin();
+	mesh.verts.add(-2, 0, 0);
+	mesh.journal.commit();
+	ASSERT_TRUE(mesh.journal.can_undo());
+
+	// copies start with empty history
+	auto copy = mesh;
+	EXPECT_FALSE(copy.journal.can_undo());
+	EXPECT_TRUE(mesh.journal.can_undo());
+
+	// history of the replaced elements is dropped
+	mesh = get_cube_mesh<Mesh_Journal>();
+	EXPECT_FALSE(mesh.journal.can_undo());
+	EXPECT_FALSE(mesh.journal.undo());
+	EXPECT_EQ(8, mesh.verts.domain_end());
+
+	copy.journal.begin();
+	copy.verts.add(-3, 0, 0);
+	copy.journal.commit();
+
+	auto moved = std::move(copy);
+	EXPECT_FALSE(copy.journal.can_undo());
+	EXPECT_FALSE(moved.journal.can_undo());
+
+	// recording works after assignment
+	mesh = std::move(moved);
+	EXPECT_FALSE(mesh.journal.can_undo());
+
+	auto count_verts = [&]() { int r = 0; for(auto v : mesh.verts) { (void)v; ++r; } return r; };
+	const int num_verts = count_verts();
+
+	mesh.journal.begin();
+	mesh.verts.add(-4, 0, 0);
+	mesh.journal.commit();
+	EXPECT_EQ(num_verts + 1, count_verts());
+
+	ASSERT_TRUE(mesh.journal.undo());
+	EXPECT_EQ(num_verts, count_verts());
+}
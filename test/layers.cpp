@@ -0,0 +1,115 @@
+#include <smesh/smesh.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+TEST(Layers, verts) {
+	auto mesh = get_cube_mesh<Mesh>();
+
+	auto& weights = mesh.verts.layers.add<int>("weights", 7);
+	EXPECT_TRUE( mesh.verts.layers.has("weights") );
+	EXPECT_EQ(mesh.verts.domain_end(), weights.size());
+
+	for(auto v : mesh.verts) {
+		EXPECT_EQ(7, weights[v.key]);
+		weights[v.key] = v.key;
+	}
+
+	// grows with add
+	auto v = mesh.verts.add(0, 0, 0);
+	EXPECT_EQ(mesh.verts.domain_end(), weights.size());
+	EXPECT_EQ(7, weights[v.key]);
+
+	EXPECT_EQ(&weights, &mesh.verts.layers.get<int>("weights"));
+	EXPECT_EQ(nullptr, mesh.verts.layers.find<int>("missing"));
+
+	// copied with mesh
+	Mesh copy = mesh;
+	EXPECT_EQ(3, copy.verts.layers.get<int>("weights")[3]);
+	EXPECT_NE(&weights, &copy.verts.layers.get<int>("weights"));
+
+	mesh.verts.layers.remove("weights");
+	EXPECT_FALSE( mesh.verts.layers.has("weights") );
+	EXPECT_TRUE( copy.verts.layers.has("weights") );
+}
+
+
+
+
+TEST(Layers, polys_and_corners) {
+	auto mesh = get_cube_mesh<Mesh>();
+
+	auto& areas = mesh.polys.layers.add<double>("areas");
+	auto& corners = mesh.polys.corner_layers.add<int>("corners", -1);
+
+	EXPECT_EQ(mesh.polys.domain_end(), areas.size());
+	EXPECT_EQ(mesh.polys.domain_end() * Mesh::POLY_SIZE, corners.size());
+
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			corners[p.key * Mesh::POLY_SIZE + pv.idx_in_poly] = pv.key;
+		}
+	}
+
+	mesh.polys.add(0, 1, 2);
+	EXPECT_EQ(mesh.polys.domain_end(), areas.size());
+	EXPECT_EQ(mesh.polys.domain_end() * Mesh::POLY_SIZE, corners.size());
+	EXPECT_EQ(-1, corners[corners.size() - 1]);
+
+	// drop first poly, reverse the rest
+	const int n = mesh.polys.domain_end();
+	std::vector<int> old_to_new(n);
+	old_to_new[0] = -1;
+	for(int i=1; i<n; ++i) old_to_new[i] = n - 1 - i;
+
+	mesh.polys.corner_layers.remap(old_to_new.data(), n, n-1);
+	EXPECT_EQ((n-1) * Mesh::POLY_SIZE, corners.size());
+
+	for(int i=1; i<n; ++i) {
+		for(int j=0; j<Mesh::POLY_SIZE; ++j) {
+			int expected = i == n-1 ? -1 : mesh.polys[i].verts[j].key;
+			EXPECT_EQ(expected, corners[old_to_new[i] * Mesh::POLY_SIZE + j]);
+		}
+	}
+}
+
+
+
+
+TEST(Layers, pool) {
+	auto mesh = get_cube_mesh<Mesh>();
+
+	const int* data = nullptr;
+	{
+		auto scratch = mesh.verts.layers.add_scoped("scratch", 1.0f);
+		EXPECT_TRUE( mesh.verts.layers.has("scratch") );
+		EXPECT_EQ(1.0f, scratch[0]);
+		(void)scratch;
+	}
+	EXPECT_FALSE( mesh.verts.layers.has("scratch") );
+
+	{
+		auto& a = mesh.verts.layers.add<int>("a", 1);
+		data = a.begin();
+		mesh.verts.layers.remove("a");
+	}
+
+	// buffer of the same type is reused
+	auto& b = mesh.verts.layers.add<int>("b", 2);
+	EXPECT_EQ(data, b.begin());
+	for(auto x : b) EXPECT_EQ(2, x);
+
+	mesh.verts.layers.clear_pool();
+	EXPECT_EQ(1, mesh.verts.layers.get_num_layers());
+}
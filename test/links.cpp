@@ -7,6 +7,8 @@
 
 #include <gtest/gtest.h>
 
+#include <set>
+
 #include "common.hpp"
 
 using namespace smesh;
@@ -71,3 +73,157 @@ TEST(Links, compute_links_cube) {
 
 
 
+TEST(Ring, cube) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Flags< EDGE_LINKS | VERT_POLY_LINKS >::Smesh
+	>();
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			auto ring = pv.ring();
+			EXPECT_FALSE( ring.is_boundary() );
+
+			int num = 0;
+			for(auto rpv : ring) {
+				EXPECT_EQ( pv.key, rpv.key );
+				++num;
+			}
+
+			EXPECT_EQ( pv.vert.poly_links.size(), num );
+		}
+	}
+}
+
+
+
+
+TEST(Ring, cube_hole) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Flags< EDGE_LINKS | POLYS_ERASABLE >::Smesh
+	>();
+
+	fast_compute_edge_links(mesh);
+
+	std::set<int> hole_verts;
+	for(auto pv : mesh.polys[0].verts) hole_verts.insert(pv.key);
+
+	mesh.polys[0].erase();
+
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			auto ring = pv.ring();
+
+			int num = 0;
+			for(auto rpv : ring) {
+				EXPECT_EQ( pv.key, rpv.key );
+				++num;
+			}
+
+			int expected = 0;
+			for(auto pp : mesh.polys) {
+				for(auto ppv : pp.verts) {
+					if(ppv.key == pv.key) ++expected;
+				}
+			}
+
+			EXPECT_EQ( expected, num );
+
+			EXPECT_EQ( hole_verts.count(pv.key) > 0, ring.is_boundary() );
+		}
+	}
+}
+
+
+
+
+
+TEST(Edges, cube) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Flags< EDGE_LINKS >::Smesh
+	>();
+
+	int num_half_edges = 0;
+	for(auto e : mesh.edges) {
+		EXPECT_TRUE( e.owns_edge );
+		++num_half_edges;
+	}
+
+	EXPECT_EQ(36, num_half_edges);
+
+	fast_compute_edge_links(mesh);
+
+	int num_edges = 0;
+	for(auto e : mesh.edges) {
+		EXPECT_TRUE( e.has_link );
+		EXPECT_TRUE( e.owns_edge );
+		EXPECT_FALSE( e.link().owns_edge );
+		++num_edges;
+	}
+
+	EXPECT_EQ(18, num_edges);
+}
+
+
+
+
+struct Edge_Props_cost {
+	double cost = 0;
+};
+
+TEST(Edges, cube_props) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Flags< EDGE_LINKS >::Edge_Props< Edge_Props_cost >::Smesh
+	>();
+
+	fast_compute_edge_links(mesh);
+
+	for(auto e : mesh.edges) {
+		e.props().cost = e.segment.trace().norm();
+	}
+
+	for(auto p : mesh.polys) {
+		for(auto pe : p.edges) {
+			EXPECT_DOUBLE_EQ( pe.segment.trace().norm(), pe.props().cost );
+		}
+	}
+
+	// unlinking keeps props on both sides
+	auto e = mesh.polys[0].edges[0];
+	auto other = e.link();
+	e.unlink();
+
+	EXPECT_DOUBLE_EQ( e.segment.trace().norm(), e().props().cost );
+	EXPECT_DOUBLE_EQ( e.segment.trace().norm(), other().props().cost );
+}
+
+
+
+// without edge links, each half-edge has its own props
+TEST(Edges, cube_props_no_edge_links) {
+
+	auto mesh = get_cube_mesh<
+		Smesh_Builder<double>::Rem_Flags< EDGE_LINKS >::Edge_Props< Edge_Props_cost >::Smesh
+	>();
+
+	for(auto p : mesh.polys) {
+		for(auto pe : p.edges) {
+			EXPECT_TRUE( pe.owns_edge );
+			pe.props().cost = p.key * 10 + pe.handle.edge;
+		}
+	}
+
+	for(auto p : mesh.polys) {
+		for(auto pe : p.edges) EXPECT_EQ( p.key * 10 + pe.handle.edge, pe.props().cost );
+	}
+}
+
+
+
+
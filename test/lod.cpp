@@ -0,0 +1,87 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+#include <smesh/lod.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+using Quantized_Mesh = Smesh_Builder<float>::Add_Flags<QUANTIZED_POS>::Smesh;
+
+
+
+
+template<class MESH>
+void test_lod_chain() {
+
+	auto mesh = load_ply<MESH>("bunny-holes.ply");
+	EXPECT_FALSE( mesh.verts.empty() );
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	cap_holes(mesh);
+
+	std::vector<typename MESH::Scalar> targets = {0.002, 0.005, 0.01, 0.02};
+
+	auto lods = build_lod_chain(mesh, targets);
+	ASSERT_EQ(lods.size(), targets.size());
+
+	int prev_num_polys = mesh.polys.domain_end();
+
+	for(auto& lod : lods) {
+		EXPECT_TRUE( is_solid(lod) );
+
+		int num_polys = lod.polys.domain_end();
+		EXPECT_LE(num_polys, prev_num_polys);
+		prev_num_polys = num_polys;
+	}
+
+	EXPECT_LT(lods.back().polys.domain_end(), lods.front().polys.domain_end());
+
+	// same collapse sequence, as index buffers
+	auto buffers = build_lod_index_buffers(mesh, targets);
+	ASSERT_EQ(buffers.indices.size(), targets.size());
+	EXPECT_EQ((int)buffers.positions.size(), mesh.verts.domain_end());
+
+	for(int i=0; i<(int)targets.size(); ++i) {
+		EXPECT_EQ((int)buffers.indices[i].size(), 3 * lods[i].polys.domain_end());
+
+		for(auto idx : buffers.indices[i]) {
+			EXPECT_GE(idx, 0);
+			EXPECT_LT(idx, (int)buffers.positions.size());
+		}
+	}
+
+	// compact copies keep the position codec (QUANTIZED_POS grid), so positions are unchanged
+	for(auto v : mesh.verts) EXPECT_EQ(buffers.positions[v.key], v.pos());
+
+	for(auto& lod : lods) {
+		if constexpr(MESH::Has_Quantized_Pos) {
+			EXPECT_EQ(lod.verts.pos_codec.get_min(), mesh.verts.pos_codec.get_min());
+			EXPECT_EQ(lod.verts.pos_codec.get_max(), mesh.verts.pos_codec.get_max());
+		}
+	}
+}
+
+
+
+TEST(Lod, bunny_chain) {
+	test_lod_chain<Mesh>();
+}
+
+TEST(Lod, bunny_chain_quantized) {
+	test_lod_chain<Quantized_Mesh>();
+}
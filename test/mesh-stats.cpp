@@ -0,0 +1,118 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/mesh-stats.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// cubes of half-size `scale[i]` centered at `centers[i]`
+	template<class MESH>
+	MESH get_cubes(const std::vector<Eigen::Vector3d>& centers, const std::vector<double>& scale) {
+		MESH mesh;
+		for(int i=0; i<(int)centers.size(); ++i) {
+			const auto cube = get_cube_mesh<MESH>();
+			const int offset = mesh.verts.domain_end();
+			for(auto v : cube.verts) {
+				mesh.verts.add( (centers[i] + v.pos().template cast<double>() * scale[i]).template cast<typename MESH::Scalar>() );
+			}
+			for(auto p : cube.polys) {
+				mesh.polys.add(p.verts[0].key + offset, p.verts[1].key + offset, p.verts[2].key + offset);
+			}
+		}
+		return mesh;
+	}
+}
+
+
+
+
+TEST(Mesh_Stats, cube) {
+	auto mesh = get_cube_mesh<Mesh>();
+	auto stats = compute_mesh_stats(mesh);
+
+	EXPECT_EQ(12, stats.num_polys);
+	EXPECT_EQ(Eigen::Vector3d(-1,-1,-1), stats.min);
+	EXPECT_EQ(Eigen::Vector3d( 1, 1, 1), stats.max);
+	EXPECT_DOUBLE_EQ(24, stats.area);
+	EXPECT_DOUBLE_EQ(8, stats.volume);
+	EXPECT_LT(stats.centroid.norm(), 1e-12);
+	EXPECT_LT(stats.surface_centroid.norm(), 1e-12);
+}
+
+
+
+TEST(Mesh_Stats, float_far_from_origin) {
+	const Eigen::Vector3d center(1e4, -2e4, 3e4);
+	auto mesh = get_cubes<Smesh<float>>({center}, {1});
+	auto stats = compute_mesh_stats(mesh);
+
+	EXPECT_NEAR(24, stats.area, 1e-4);
+	EXPECT_NEAR(8, stats.volume, 1e-4);
+	EXPECT_LT((stats.centroid.cast<double>() - center).norm(), 1e-2);
+}
+
+
+
+TEST(Mesh_Stats, components) {
+	auto mesh = get_cubes<Mesh>({ {0,0,0}, {10,0,0} }, {1, 2});
+	fast_compute_edge_links(mesh);
+
+	auto components = compute_poly_components(mesh);
+	ASSERT_EQ(2, components.num_components);
+
+	auto stats = compute_mesh_stats(mesh, [&](int p) { return components.poly_component[p]; },
+		components.num_components);
+	ASSERT_EQ(2, (int)stats.size());
+
+	EXPECT_EQ(12, stats[0].num_polys);
+	EXPECT_DOUBLE_EQ(8, stats[0].volume);
+	EXPECT_LT(stats[0].centroid.norm(), 1e-12);
+
+	EXPECT_EQ(12, stats[1].num_polys);
+	EXPECT_DOUBLE_EQ(96, stats[1].area);
+	EXPECT_DOUBLE_EQ(64, stats[1].volume);
+	EXPECT_LT((stats[1].centroid - Eigen::Vector3d(10,0,0)).norm(), 1e-12);
+	EXPECT_EQ(Eigen::Vector3d(8,-2,-2), stats[1].min);
+
+	// whole mesh: volume-weighted centroid
+	auto total = compute_mesh_stats(mesh);
+	EXPECT_DOUBLE_EQ(72, total.volume);
+	EXPECT_NEAR(10 * 64.0 / 72, total.centroid[0], 1e-12);
+}
+
+
+
+TEST(Mesh_Stats, bunny_ply_threads) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+
+	Scoped_Num_Threads threads(1);
+	auto a = compute_mesh_stats(mesh);
+
+	threads.set(4);
+	auto b = compute_mesh_stats(mesh);
+
+	EXPECT_GT(a.area, 0);
+
+	// same result for any number of threads
+	EXPECT_EQ(a.area, b.area);
+	EXPECT_EQ(a.volume, b.volume);
+	EXPECT_EQ(a.centroid, b.centroid);
+	EXPECT_EQ(a.min, b.min);
+	EXPECT_EQ(a.max, b.max);
+}
@@ -0,0 +1,146 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/mesh-utils.hpp>
+#include <smesh/positions.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// cube with isolated verts 8, 10 and erased vert 9
+	Mesh get_cube_with_isolated_verts() {
+		auto mesh = get_cube_mesh<Mesh>();
+		mesh.verts.add(5, 0, 0);
+		mesh.verts.add(6, 0, 0);
+		mesh.verts.add(7, 0, 0);
+		mesh.verts[9].erase();
+		fast_compute_edge_links(mesh);
+		compute_vert_poly_links(mesh);
+		return mesh;
+	}
+}
+
+
+
+
+TEST(Isolated_Vertices, cube) {
+	auto mesh = get_cube_with_isolated_verts();
+
+	const std::vector<uint8_t> expected = {0,0,0,0, 0,0,0,0, 1,0,1};
+	EXPECT_EQ(expected, compute_isolated_vertices(mesh, true));
+	EXPECT_EQ(expected, compute_isolated_vertices(mesh, false));
+	EXPECT_TRUE( has_isolated_vertices(mesh) );
+
+	EXPECT_FALSE( has_isolated_vertices(get_cube_mesh<Mesh>(), false) );
+}
+
+
+
+TEST(Isolated_Vertices, remove) {
+	auto mesh = get_cube_with_isolated_verts();
+	EXPECT_EQ(2, remove_isolated_vertices(mesh));
+	EXPECT_FALSE( has_isolated_vertices(mesh) );
+	EXPECT_EQ(11, mesh.verts.domain_end());
+
+	auto compacted = get_cube_with_isolated_verts();
+	EXPECT_EQ(2, remove_isolated_vertices(compacted, true));
+	EXPECT_EQ(8, compacted.verts.domain_end());
+	EXPECT_EQ(12, compacted.polys.domain_end());
+	EXPECT_TRUE( has_valid_edge_links(compacted) );
+	EXPECT_TRUE( has_valid_vert_poly_links(compacted) );
+	EXPECT_TRUE( is_solid(compacted) );
+}
+
+
+
+TEST(Isolated_Vertices, remove_compact_keeps_layers_and_codec) {
+	using Quantized_Mesh = Smesh_Builder<double>::Add_Flags<QUANTIZED_POS>::Smesh;
+	using Pos = Quantized_Mesh::Pos;
+
+	// isolated vert 0, then an open cube (poly 3 erased), so compaction shifts all keys
+	Quantized_Mesh mesh;
+	set_pos_bounds(mesh, Pos(-1,-1,-1), Pos(7,1,1));
+	mesh.verts.add(5, 0, 0);
+
+	const auto cube = get_cube_mesh<Mesh>();
+	for(auto v : cube.verts) mesh.verts.add(v.pos());
+	for(auto p : cube.polys) mesh.polys.add(p.verts[0].key + 1, p.verts[1].key + 1, p.verts[2].key + 1);
+	mesh.polys[3].erase();
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	std::vector<Pos> positions;
+	for(auto v : mesh.verts) positions.push_back(v.pos());
+
+	auto& xs = mesh.verts.layers.add<double>("x");
+	for(auto v : mesh.verts) xs[v.key] = v.pos()[0];
+
+	auto& keys = mesh.polys.layers.add<int>("key");
+	for(auto p : mesh.polys) keys[p.key] = p.key;
+
+	auto& corners = mesh.polys.corner_layers.add<int>("vert");
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) corners[p.key * Quantized_Mesh::POLY_SIZE + pv.idx_in_poly] = pv.key;
+	}
+
+	EXPECT_EQ(1, remove_isolated_vertices(mesh, true));
+	EXPECT_EQ(8, mesh.verts.domain_end());
+	EXPECT_EQ(11, mesh.polys.domain_end());
+	EXPECT_TRUE( has_valid_edge_links(mesh) );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh) );
+
+	EXPECT_EQ(Pos(-1,-1,-1), mesh.verts.pos_codec.get_min());
+	for(auto v : mesh.verts) EXPECT_EQ(positions[v.key + 1], v.pos());
+
+	const auto& new_xs = mesh.verts.layers.get<double>("x");
+	ASSERT_EQ(8, new_xs.size());
+	for(auto v : mesh.verts) EXPECT_EQ(v.pos()[0], new_xs[v.key]);
+
+	const auto& new_keys = mesh.polys.layers.get<int>("key");
+	const auto& new_corners = mesh.polys.corner_layers.get<int>("vert");
+	ASSERT_EQ(11, new_keys.size());
+	ASSERT_EQ(11 * Quantized_Mesh::POLY_SIZE, new_corners.size());
+	for(auto p : mesh.polys) {
+		EXPECT_EQ(p.key < 3 ? p.key : p.key + 1, new_keys[p.key]);
+		for(auto pv : p.verts) EXPECT_EQ(pv.key + 1, new_corners[p.key * Quantized_Mesh::POLY_SIZE + pv.idx_in_poly]);
+	}
+}
+
+
+
+TEST(Isolated_Vertices, threads) {
+	Mesh mesh;
+	for(int i=0; i<100000; ++i) mesh.verts.add(i, 0, 0);
+	for(int i=0; i+2<100000; i+=3) {
+		if(i % 7 != 0) mesh.polys.add(i, i+1, i+2);
+	}
+
+	Scoped_Num_Threads threads(1);
+	auto a = compute_isolated_vertices(mesh, false);
+
+	threads.set(4);
+	auto b = compute_isolated_vertices(mesh, false);
+
+	EXPECT_EQ(a, b);
+	for(int i=0; i<100000; ++i) {
+		const int first = i - i % 3;
+		const bool used = first + 2 < 100000 && first % 7 != 0;
+		EXPECT_EQ(!used, a[i]) << i;
+	}
+}
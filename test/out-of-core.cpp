@@ -0,0 +1,199 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/collapse-edges.hpp>
+#include <smesh/cap-holes.hpp>
+#include <smesh/parallel.hpp>
+#include <smesh/out-of-core.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// closed lat-long sphere
+	Mesh get_sphere_mesh(int num_rings, int num_segments) {
+		Mesh mesh;
+
+		const int south = mesh.verts.add(0, 0, -1);
+		for(int i=1; i<num_rings; ++i) {
+			const double theta = M_PI * i / num_rings;
+			for(int j=0; j<num_segments; ++j) {
+				const double phi = 2 * M_PI * j / num_segments;
+				mesh.verts.add(sin(theta) * cos(phi), sin(theta) * sin(phi), -cos(theta));
+			}
+		}
+		const int north = mesh.verts.add(0, 0, 1);
+
+		auto get_vert = [&](int ring, int segment) { return 1 + ring * num_segments + segment % num_segments; };
+
+		for(int j=0; j<num_segments; ++j) {
+			mesh.polys.add(south, get_vert(0, j+1), get_vert(0, j));
+			mesh.polys.add(north, get_vert(num_rings-2, j), get_vert(num_rings-2, j+1));
+		}
+
+		for(int i=0; i+1<num_rings-1; ++i) {
+			for(int j=0; j<num_segments; ++j) {
+				mesh.polys.add(get_vert(i, j), get_vert(i, j+1), get_vert(i+1, j+1));
+				mesh.polys.add(get_vert(i, j), get_vert(i+1, j+1), get_vert(i+1, j));
+			}
+		}
+
+		return mesh;
+	}
+
+	// small budget: many chunks
+	Out_Of_Core_Options get_options() {
+		Out_Of_Core_Options options;
+		options.memory_budget = 1 << 20;
+		return options;
+	}
+}
+
+
+
+
+TEST(Out_Of_Core, sphere_identity) {
+	const auto input = std::filesystem::temp_directory_path() / "smesh-out-of-core-sphere.ply";
+	const auto output = std::filesystem::temp_directory_path() / "smesh-out-of-core-sphere-out.ply";
+
+	auto sphere = get_sphere_mesh(100, 200);
+	EXPECT_EQ(0, fast_compute_edge_links(sphere).num_open_edges);
+	save_ply(sphere, input.string());
+
+	Scoped_Num_Threads threads(4);
+
+	auto r = process_ply_out_of_core<Mesh>(input, output, [](Mesh& chunk, const auto& locked) {
+		EXPECT_TRUE( is_solid(chunk, Check_Solid_Flags::ALLOW_HOLES) );
+
+		const auto& layer = chunk.verts.layers.template get<uint8_t>("locked");
+		for(auto v : chunk.verts) EXPECT_EQ(layer[v.key], locked[v.key]);
+	}, get_options());
+
+	EXPECT_GT(r.num_chunks, 1);
+	EXPECT_GT(r.num_locked_verts, 0);
+	EXPECT_EQ(sphere.verts.domain_end(), r.num_verts);
+	EXPECT_EQ(sphere.polys.domain_end(), r.num_polys);
+
+	// chunks are stitched back
+	auto mesh = load_ply<Mesh>(output.string());
+	EXPECT_EQ(r.num_verts, mesh.verts.domain_end());
+	EXPECT_EQ(r.num_polys, mesh.polys.domain_end());
+
+	EXPECT_EQ(0, fast_compute_edge_links(mesh).num_open_edges);
+	compute_vert_poly_links(mesh);
+	EXPECT_TRUE( is_solid(mesh) );
+
+	std::filesystem::remove(input);
+	std::filesystem::remove(output);
+}
+
+
+
+
+TEST(Out_Of_Core, bunny_collapse_and_cap) {
+	const auto output = std::filesystem::temp_directory_path() / "smesh-out-of-core-bunny-out.ply";
+
+	auto input = load_ply<Mesh>("bunny-holes.ply");
+	const int input_num_open_edges = fast_compute_edge_links(input).num_open_edges;
+	EXPECT_GT(input_num_open_edges, 0);
+
+	auto r = process_ply_out_of_core<Mesh>("bunny-holes.ply", output, [](Mesh& chunk, const auto& locked) {
+		auto is_free = [&](const auto& e) { return !locked[e.verts[0].key] && !locked[e.verts[1].key]; };
+
+		std::vector<int32_t> weights(chunk.verts.domain_end(), 1);
+		fast_collapse_edges(chunk, 0.002, [&weights](auto i) -> auto& { return weights[i]; }, is_free);
+
+		cap_holes(chunk, is_free);
+	}, get_options());
+
+	EXPECT_GT(r.num_chunks, 1);
+	EXPECT_GT(r.num_locked_verts, 0);
+	EXPECT_LT(r.num_polys, input.polys.domain_end());
+
+	auto mesh = load_ply<Mesh>(output.string());
+	EXPECT_EQ(r.num_polys, mesh.polys.domain_end());
+
+	// locked verts kept chunk boundaries intact: no new holes
+	EXPECT_LE(fast_compute_edge_links(mesh).num_open_edges, input_num_open_edges);
+	compute_vert_poly_links(mesh);
+	EXPECT_TRUE( is_solid(mesh, Check_Solid_Flags::ALLOW_HOLES) );
+
+	std::filesystem::remove(output);
+}
+
+
+
+
+// double input stays double: offset positions would lose their detail as floats
+TEST(Out_Of_Core, sphere_double_positions) {
+	const auto input = std::filesystem::temp_directory_path() / "smesh-out-of-core-sphere-double.ply";
+	const auto output = std::filesystem::temp_directory_path() / "smesh-out-of-core-sphere-double-out.ply";
+
+	auto sphere = get_sphere_mesh(100, 200);
+
+	std::vector<std::array<double,3>> positions;
+	for(auto v : sphere.verts) positions.push_back({1000 + 1e-3 * v.pos()[0], 1e-3 * v.pos()[1], 1e-3 * v.pos()[2]});
+
+	{
+		std::ofstream s(input, std::ios::binary);
+		s << "ply\n" << "format binary_little_endian 1.0\n"
+			<< "element vertex " << positions.size() << "\n"
+			<< "property double x\n" << "property double y\n" << "property double z\n"
+			<< "element face " << sphere.polys.domain_end() << "\n"
+			<< "property list uchar int vertex_indices\n" << "end_header\n";
+		for(const auto& pos : positions) s.write(reinterpret_cast<const char*>(pos.data()), sizeof(pos));
+		for(auto p : sphere.polys) {
+			const uint8_t n = 3;
+			const int32_t t[3] = {p.verts[0].key, p.verts[1].key, p.verts[2].key};
+			s.write(reinterpret_cast<const char*>(&n), 1);
+			s.write(reinterpret_cast<const char*>(t), sizeof(t));
+		}
+	}
+
+	auto r = process_ply_out_of_core<Mesh>(input, output, [](Mesh&, const auto&) {}, get_options());
+	EXPECT_GT(r.num_chunks, 1);
+	EXPECT_EQ((int)positions.size(), r.num_verts);
+
+	std::ifstream s(output, std::ios::binary);
+	const auto layout = smesh::internal::read_ply_layout(s);
+	ASSERT_EQ(8, layout.pos_size);
+	ASSERT_EQ(r.num_verts, layout.num_verts);
+
+	std::vector<char> record(layout.vert_size);
+	std::vector<std::array<double,3>> output_positions(r.num_verts);
+	for(auto& pos : output_positions) {
+		s.read(record.data(), record.size());
+		for(int j=0; j<3; ++j) std::memcpy(&pos[j], &record[layout.pos_offset[j]], 8);
+	}
+	ASSERT_TRUE(s);
+
+	std::sort(positions.begin(), positions.end());
+	std::sort(output_positions.begin(), output_positions.end());
+	EXPECT_EQ(positions, output_positions);
+
+	std::filesystem::remove(input);
+	std::filesystem::remove(output);
+}
@@ -0,0 +1,163 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+#include <smesh/collapse-edges.hpp>
+#include <smesh/positions.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+using Quantized_Mesh = Smesh_Builder<float>::Add_Flags<QUANTIZED_POS>::Smesh;
+using Half_Mesh = Smesh_Builder<float>::Add_Flags<HALF_POS>::Smesh;
+
+
+
+
+
+TEST(Positions, half) {
+	using smesh::internal::float_to_half;
+	using smesh::internal::half_to_float;
+
+	EXPECT_EQ(0x0000, float_to_half(0.0f));
+	EXPECT_EQ(0x8000, float_to_half(-0.0f));
+	EXPECT_EQ(0x3c00, float_to_half(1.0f));
+	EXPECT_EQ(0xc000, float_to_half(-2.0f));
+	EXPECT_EQ(0x7bff, float_to_half(65504.0f));
+	EXPECT_EQ(0x7c00, float_to_half(70000.0f));
+	EXPECT_EQ(0x0001, float_to_half(std::ldexp(1.0f, -24)));
+	EXPECT_EQ(0x0000, float_to_half(1e-8f));
+	EXPECT_EQ(0x3c00, float_to_half(1.0f + std::ldexp(1.0f, -11))); // tie, to even
+	EXPECT_EQ(0x3c01, float_to_half(1.0f + std::ldexp(1.0f, -10)));
+
+	EXPECT_TRUE( std::isnan(half_to_float(float_to_half(std::numeric_limits<float>::quiet_NaN()))) );
+
+	// all finite halfs round trip
+	for(int h=0; h<0x10000; ++h) {
+		if((h & 0x7c00) == 0x7c00) continue;
+		ASSERT_EQ(h, float_to_half(half_to_float(uint16_t(h)))) << h;
+	}
+}
+
+
+
+
+template<class MESH>
+void test_bunny(double max_error) {
+	auto ref = load_ply<Mesh>("bunny-holes.ply");
+	auto mesh = load_ply<MESH>("bunny-holes.ply");
+	ASSERT_EQ(ref.verts.domain_end(), mesh.verts.domain_end());
+
+	double error = 0;
+	for(auto v : ref.verts) {
+		error = std::max(error, (mesh.verts[v.key].pos().template cast<double>() - v.pos()).cwiseAbs().maxCoeff());
+	}
+	EXPECT_LE(error, max_error);
+
+	auto positions = decode_positions<float>(mesh);
+	for(auto v : mesh.verts) {
+		EXPECT_EQ(v.pos(), positions[v.key]);
+	}
+
+	// poly-vert positions
+	for(auto p : mesh.polys) {
+		for(auto pv : p.verts) {
+			EXPECT_EQ(pv.vert.pos(), pv.pos());
+		}
+	}
+
+	// algorithms work on decoded positions
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+	EXPECT_TRUE( is_solid(mesh) );
+
+	int num_polys = 0;
+	for(auto p : mesh.polys) { (void)p; ++num_polys; }
+
+	fast_collapse_edges(mesh, 0.005);
+	EXPECT_TRUE( is_solid(mesh) );
+
+	int new_num_polys = 0;
+	for(auto p : mesh.polys) { (void)p; ++new_num_polys; }
+	EXPECT_LT(new_num_polys, num_polys);
+}
+
+
+
+TEST(Positions, quantized_bunny) {
+	// bunny is ~0.15 across: grid step ~2.5e-6
+	test_bunny<Quantized_Mesh>(2e-6);
+}
+
+TEST(Positions, half_bunny) {
+	// coordinates are below 0.25: half ulp is at most 2^-13
+	test_bunny<Half_Mesh>(std::ldexp(1.0, -13));
+}
+
+
+
+
+TEST(Positions, quantized_assign) {
+	Quantized_Mesh mesh;
+	set_pos_bounds(mesh, {-1,-1,-1}, {1,1,1});
+
+	int ka = mesh.verts.add(0.5, 0, -0.5).key;
+	int kb = mesh.verts.add(1.0, 0, 0).key;
+
+	auto a = mesh.verts[ka];
+	auto b = mesh.verts[kb];
+
+	EXPECT_NEAR(0.5, a.pos()[0], 1e-4);
+	EXPECT_NEAR(-0.5, a.pos[2], 1e-4);
+	EXPECT_NEAR(1.0, b.pos()[0], 1e-6);
+
+	a.pos = Quantized_Mesh::Pos(0.25, 0.25, 0.25);
+	EXPECT_NEAR(0.25, a.pos()[1], 1e-4);
+
+	a.pos += Quantized_Mesh::Pos(0.25, 0, 0);
+	EXPECT_NEAR(0.5, a.pos()[0], 1e-4);
+
+	b.pos = a.pos;
+	EXPECT_EQ(a.pos(), b.pos());
+
+	EXPECT_NEAR(0, (a.pos - b.pos).norm(), 1e-9);
+
+	// re-encode with finer grid
+	set_pos_bounds(mesh, {0,0,0}, {0.5,0.5,0.5});
+	EXPECT_NEAR(0.5, a.pos()[0], 1e-4);
+	EXPECT_NEAR(0.25, a.pos()[2], 1e-4);
+}
+
+
+
+// outside the bounds: a debug check, clamped in release builds
+TEST(Positions, quantized_out_of_bounds) {
+	Quantized_Mesh mesh;
+	set_pos_bounds(mesh, {-1,-1,-1}, {1,1,1});
+
+	int k = mesh.verts.add(0, 0, 0).key;
+	auto v = mesh.verts[k];
+
+	EXPECT_DEBUG_DEATH(v.pos = Quantized_Mesh::Pos(2, 0, 0), "outside of bounds");
+#ifdef NDEBUG
+	EXPECT_NEAR(1.0, v.pos()[0], 1e-6);
+#endif
+
+	// no bounds set
+	Quantized_Mesh fresh;
+	EXPECT_DEBUG_DEATH(fresh.verts.add(0.5, 0, 0), "set_pos_bounds");
+}
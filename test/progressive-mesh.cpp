@@ -0,0 +1,252 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+#include <smesh/progressive-mesh.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+using Mesh_Edge_Links = Smesh_Builder<double>::Rem_Flags<VERT_POLY_LINKS>::Smesh;
+using Quantized_Mesh = Smesh_Builder<float>::Add_Flags<QUANTIZED_POS>::Smesh;
+
+
+
+
+template<class MESH>
+void test_progressive_mesh_roundtrip() {
+
+	auto mesh = load_ply<MESH>("bunny-holes.ply");
+	EXPECT_FALSE( mesh.verts.empty() );
+
+	fast_compute_edge_links(mesh);
+	if constexpr(MESH::Has_Vert_Poly_Links) compute_vert_poly_links(mesh);
+
+	cap_holes(mesh);
+	ASSERT_TRUE( is_solid(mesh) );
+
+	auto pm = encode_progressive_mesh(mesh, 0.01);
+	EXPECT_GT(pm.splits.size(), 0u);
+	EXPECT_LT(pm.base_polys.size(), (size_t)mesh.polys.domain_end());
+
+	std::stringstream stream;
+	write_progressive_mesh(stream, pm);
+
+	MESH decoded;
+	Progressive_Mesh_Decoder<MESH> decoder(decoded);
+	decoder.read_base(stream);
+
+	EXPECT_EQ(decoded.polys.domain_end(), (int)pm.base_polys.size());
+	EXPECT_TRUE( is_solid(decoded) );
+
+	decoder.read_splits(stream, decoder.get_num_splits() / 2);
+	EXPECT_FALSE( decoder.done() );
+	EXPECT_TRUE( is_solid(decoded) );
+
+	while(decoder.read_splits(stream, 1000));
+	EXPECT_TRUE( decoder.done() );
+	EXPECT_TRUE( is_solid(decoded) );
+
+	// all verts and polys are back, at original positions
+	EXPECT_EQ(decoded.verts.domain_end(), mesh.verts.domain_end());
+	EXPECT_EQ(decoded.polys.domain_end(), mesh.polys.domain_end());
+
+	auto get_sorted_positions = [](const MESH& m) {
+		std::vector<std::array<double,3>> r;
+		for(auto v : m.verts) r.push_back({v.pos[0], v.pos[1], v.pos[2]});
+		std::sort(r.begin(), r.end());
+		return r;
+	};
+
+	if constexpr(MESH::Has_Quantized_Pos) {
+		// same grid: bounds are written to the stream (up to rounding of the recomputed step)
+		EXPECT_EQ(decoded.verts.pos_codec.get_min(), mesh.verts.pos_codec.get_min());
+		EXPECT_NEAR((decoded.verts.pos_codec.get_max() - mesh.verts.pos_codec.get_max()).norm(), 0, 1e-6);
+
+		auto decoded_positions = get_sorted_positions(decoded);
+		auto positions = get_sorted_positions(mesh);
+		ASSERT_EQ(decoded_positions.size(), positions.size());
+		for(int i=0; i<(int)positions.size(); ++i) {
+			for(int j=0; j<3; ++j) EXPECT_NEAR(decoded_positions[i][j], positions[i][j], 1e-6);
+		}
+	}
+	else {
+		EXPECT_EQ(get_sorted_positions(decoded), get_sorted_positions(mesh));
+	}
+}
+
+
+
+TEST(Progressive_mesh, bunny_roundtrip) {
+	test_progressive_mesh_roundtrip<Mesh>();
+}
+
+TEST(Progressive_mesh, bunny_roundtrip_edge_links_only) {
+	test_progressive_mesh_roundtrip<Mesh_Edge_Links>();
+}
+
+TEST(Progressive_mesh, bunny_roundtrip_quantized) {
+	test_progressive_mesh_roundtrip<Quantized_Mesh>();
+}
+
+
+
+TEST(Progressive_mesh, bunny_partial_stream) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+
+	auto pm = encode_progressive_mesh(mesh, 0.01);
+	ASSERT_GT(pm.splits.size(), 10u);
+
+	std::stringstream full;
+	write_progressive_mesh(full, pm);
+	const std::string bytes = full.str();
+
+	const size_t splits_begin = 4 + 6 * sizeof(uint32_t) + 6 * sizeof(double) +
+		pm.base_positions.size() * 3 * sizeof(double) + pm.base_polys.size() * sizeof(pm.base_polys[0]);
+
+	// cut in the middle of a split record: it's left in the stream until the rest arrives
+	const size_t cut = splits_begin + (bytes.size() - splits_begin) / 2 + 3;
+
+	std::stringstream stream;
+	stream.write(bytes.data(), cut);
+
+	Mesh decoded;
+	Progressive_Mesh_Decoder<Mesh> decoder(decoded);
+	decoder.read_base(stream);
+
+	const int num_applied = decoder.read_splits(stream);
+	EXPECT_GT(num_applied, 0);
+	EXPECT_LT(num_applied, decoder.get_num_splits());
+	EXPECT_FALSE( decoder.failed() );
+	EXPECT_TRUE( is_solid(decoded) );
+
+	EXPECT_EQ(0, decoder.read_splits(stream));
+	EXPECT_FALSE( decoder.failed() );
+
+	stream.write(bytes.data() + cut, bytes.size() - cut);
+	EXPECT_EQ(decoder.get_num_splits() - num_applied, decoder.read_splits(stream));
+	EXPECT_TRUE( decoder.done() );
+	EXPECT_TRUE( is_solid(decoded) );
+	EXPECT_EQ(decoded.polys.domain_end(), mesh.polys.domain_end());
+}
+
+
+
+TEST(Progressive_mesh, bunny_partial_base) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+
+	auto pm = encode_progressive_mesh(mesh, 0.01);
+
+	std::stringstream full;
+	write_progressive_mesh(full, pm);
+	const std::string bytes = full.str();
+
+	// cut in the middle of the base polys: nothing is added until the whole base arrives
+	const size_t polys_begin = 4 + 6 * sizeof(uint32_t) + 6 * sizeof(double) + pm.base_positions.size() * 3 * sizeof(double);
+	const size_t cut = polys_begin + pm.base_polys.size() * sizeof(pm.base_polys[0]) / 2 + 3;
+
+	std::stringstream stream;
+	stream.write(bytes.data(), cut);
+
+	Mesh decoded;
+	Progressive_Mesh_Decoder<Mesh> decoder(decoded);
+	EXPECT_FALSE( decoder.read_base(stream) );
+	EXPECT_FALSE( decoder.failed() );
+	EXPECT_TRUE( decoded.verts.empty() );
+	EXPECT_EQ(0, decoder.read_splits(stream));
+
+	stream.write(bytes.data() + cut, bytes.size() - cut);
+	ASSERT_TRUE( decoder.read_base(stream) );
+	EXPECT_EQ(decoded.polys.domain_end(), (int)pm.base_polys.size());
+
+	while(decoder.read_splits(stream, 1000));
+	EXPECT_TRUE( decoder.done() );
+	EXPECT_TRUE( is_solid(decoded) );
+	EXPECT_EQ(decoded.polys.domain_end(), mesh.polys.domain_end());
+}
+
+
+
+TEST(Progressive_mesh, bunny_corrupt_base) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+
+	auto pm = encode_progressive_mesh(mesh, 0.01);
+	ASSERT_GT(pm.base_polys.size(), 1u);
+
+	auto decode = [](const Progressive_Mesh<Mesh>& corrupt) {
+		std::stringstream stream;
+		write_progressive_mesh(stream, corrupt);
+
+		Mesh decoded;
+		Progressive_Mesh_Decoder<Mesh> decoder(decoded);
+		EXPECT_FALSE( decoder.read_base(stream) );
+		EXPECT_TRUE( decoder.failed() );
+		EXPECT_TRUE( decoded.verts.empty() );
+		EXPECT_EQ(0, decoder.read_splits(stream));
+	};
+
+	// vert that doesn't exist
+	auto bad_vert = pm;
+	bad_vert.base_polys[1].verts[0] = (int32_t)pm.base_positions.size();
+	decode(bad_vert);
+
+	// link past the last poly
+	auto bad_link = pm;
+	bad_link.base_polys[1].links[0] = (int32_t)pm.base_polys.size() * Mesh::POLY_SIZE;
+	decode(bad_link);
+
+	// one-way link
+	auto one_way = pm;
+	for(auto& l : one_way.base_polys[1].links) l = -1;
+	decode(one_way);
+}
+
+
+
+TEST(Progressive_mesh, bunny_corrupt_split) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	cap_holes(mesh);
+
+	auto pm = encode_progressive_mesh(mesh, 0.01);
+	ASSERT_GT(pm.splits.size(), 1u);
+
+	// first split record refers to a vert that doesn't exist
+	pm.splits[0].vert = (int32_t)pm.base_positions.size() + 1000;
+
+	std::stringstream stream;
+	write_progressive_mesh(stream, pm);
+
+	Mesh decoded;
+	Progressive_Mesh_Decoder<Mesh> decoder(decoded);
+	decoder.read_base(stream);
+
+	EXPECT_EQ(0, decoder.read_splits(stream));
+	EXPECT_TRUE( decoder.failed() );
+	EXPECT_FALSE( decoder.done() );
+	EXPECT_EQ(0, decoder.read_splits(stream));
+	EXPECT_TRUE( is_solid(decoded) );
+}
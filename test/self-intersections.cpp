@@ -0,0 +1,111 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/self-intersections.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// two cubes, the second one moved by `offset`
+	Mesh get_two_cubes(const Eigen::Vector3d& offset) {
+		Mesh mesh = get_cube_mesh<Mesh>();
+		const auto cube = get_cube_mesh<Mesh>();
+		for(auto v : cube.verts) mesh.verts.add( Eigen::Vector3d(v.pos() + offset) );
+		for(auto p : cube.polys) mesh.polys.add(p.verts[0].key + 8, p.verts[1].key + 8, p.verts[2].key + 8);
+		return mesh;
+	}
+}
+
+
+
+
+TEST(Self_Intersections, cube) {
+	auto mesh = get_cube_mesh<Mesh>();
+	auto r = find_self_intersections(mesh);
+	EXPECT_TRUE(r.poly_pairs.empty());
+}
+
+
+
+TEST(Self_Intersections, two_cubes) {
+	auto apart = get_two_cubes({3, 0, 0});
+	EXPECT_TRUE( find_self_intersections(apart).poly_pairs.empty() );
+
+	auto overlapping = get_two_cubes({1, 0.5, 0.25});
+	auto r = find_self_intersections(overlapping);
+	ASSERT_FALSE(r.poly_pairs.empty());
+
+	// only polys of different cubes
+	for(auto [a, b] : r.poly_pairs) {
+		EXPECT_LT(a, b);
+		EXPECT_LT(a, 12);
+		EXPECT_GE(b, 12);
+	}
+}
+
+
+
+TEST(Self_Intersections, soup_vs_brute_force) {
+	Mesh mesh;
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> center(0, 4);
+	std::uniform_real_distribution<double> offset(-0.3, 0.3);
+
+	for(int i=0; i<300; ++i) {
+		const Eigen::Vector3d c(center(rng), center(rng), center(rng));
+		for(int j=0; j<3; ++j) mesh.verts.add( Eigen::Vector3d(c + Eigen::Vector3d(offset(rng), offset(rng), offset(rng))) );
+		mesh.polys.add(3*i, 3*i + 1, 3*i + 2);
+	}
+
+	// share some verts, to cover neighbors
+	for(int i=0; i<50; ++i) mesh.polys.add(3*i, 3*i + 4, 3*i + 8);
+
+	const auto positions = decode_positions<double>(mesh);
+
+	std::vector<std::pair<int,int>> expected;
+	for(auto a : mesh.polys) {
+		for(auto b : mesh.polys) {
+			if(a.key >= b.key) continue;
+			const int va[3] = {(int)a.verts[0].key, (int)a.verts[1].key, (int)a.verts[2].key};
+			const int vb[3] = {(int)b.verts[0].key, (int)b.verts[1].key, (int)b.verts[2].key};
+			if(internal::polys_intersect(positions, va, vb)) expected.emplace_back(a.key, b.key);
+		}
+	}
+	ASSERT_FALSE(expected.empty());
+
+	EXPECT_EQ(expected, find_self_intersections(mesh).poly_pairs);
+}
+
+
+
+TEST(Self_Intersections, bunny_ply_threads) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+
+	Scoped_Num_Threads threads(1);
+	auto a = find_self_intersections(mesh);
+
+	threads.set(4);
+	auto b = find_self_intersections(mesh);
+
+	EXPECT_EQ(a.poly_pairs, b.poly_pairs);
+	EXPECT_EQ(a.num_tested, b.num_tested);
+	EXPECT_GT(a.num_tested, 0);
+}
@@ -0,0 +1,171 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/smoothing.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+namespace {
+	// planar n x n triangular lattice (acute triangles), interior verts jittered in the plane
+	Mesh get_jittered_grid(int n) {
+		Mesh mesh;
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<double> jitter(-0.1, 0.1);
+
+		for(int y=0; y<n; ++y) {
+			for(int x=0; x<n; ++x) {
+				const bool border = x == 0 || y == 0 || x == n-1 || y == n-1;
+				mesh.verts.add(x + 0.5 * (y % 2) + (border ? 0 : jitter(rng)),
+					y * sqrt(0.75) + (border ? 0 : jitter(rng)), 0);
+			}
+		}
+
+		for(int y=0; y+1<n; ++y) {
+			for(int x=0; x+1<n; ++x) {
+				const int a = y*n + x;
+				const int b = a + 1;
+				const int c = a + n;
+				const int d = c + 1;
+				if(y % 2 == 0) {
+					mesh.polys.add(a, b, c);
+					mesh.polys.add(b, d, c);
+				}
+				else {
+					mesh.polys.add(a, d, c);
+					mesh.polys.add(a, b, d);
+				}
+			}
+		}
+
+		return mesh;
+	}
+
+	template<class MESH>
+	auto get_extent(const MESH& mesh) {
+		typename MESH::Pos min = mesh.verts[0].pos();
+		typename MESH::Pos max = min;
+		for(auto v : mesh.verts) {
+			min = min.cwiseMin(v.pos());
+			max = max.cwiseMax(v.pos());
+		}
+		return (max - min).norm();
+	}
+}
+
+
+
+
+TEST(Smoothing, grid_boundary_pinned) {
+	auto mesh = get_jittered_grid(20);
+	fast_compute_edge_links(mesh);
+
+	auto original = mesh;
+
+	auto op = compute_smoothing_operator(mesh);
+	EXPECT_EQ(4 * 19, op.num_pinned);
+
+	smooth(mesh, op, 10);
+
+	for(auto v : mesh.verts) {
+		if(op.pinned[v.key]) EXPECT_EQ(original.verts[v.key].pos(), v.pos());
+		EXPECT_EQ(0, v.pos()[2]);
+	}
+}
+
+
+
+TEST(Smoothing, grid_cotangent_linear_precision) {
+	auto mesh = get_jittered_grid(20);
+	fast_compute_edge_links(mesh);
+
+	auto original = mesh;
+
+	// cotangent Laplacian of a planar mesh is zero: verts don't move
+	smooth(mesh, 10, 0.5, Smoothing_Weights::COTANGENT);
+	for(auto v : mesh.verts) EXPECT_LT((original.verts[v.key].pos() - v.pos()).norm(), 1e-9);
+
+	// uniform weights relax the jitter
+	smooth(mesh, 10, 0.5, Smoothing_Weights::UNIFORM);
+	double max_offset = 0;
+	for(auto v : mesh.verts) max_offset = std::max(max_offset, (original.verts[v.key].pos() - v.pos()).norm());
+	EXPECT_GT(max_offset, 0.01);
+}
+
+
+
+TEST(Smoothing, cube_taubin_shrinks_less) {
+	auto laplacian = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(laplacian);
+	auto taubin = laplacian;
+
+	const double extent = get_extent(laplacian);
+
+	smooth(laplacian, 10);
+	taubin_smooth(taubin, 10);
+
+	EXPECT_LT(get_extent(laplacian), extent * 0.5);
+	EXPECT_GT(get_extent(taubin), get_extent(laplacian));
+}
+
+
+
+TEST(Smoothing, cube_journal_undo) {
+	using Mesh_Journal = Smesh_Builder<double>::Add_Flags<JOURNAL>::Smesh;
+
+	auto mesh = get_cube_mesh<Mesh_Journal>();
+	fast_compute_edge_links(mesh);
+
+	std::vector<Mesh_Journal::Pos> original;
+	for(auto v : mesh.verts) original.push_back(v.pos());
+
+	mesh.journal.begin();
+	smooth(mesh, 3);
+	mesh.journal.commit();
+
+	EXPECT_NE(original[0], mesh.verts[0].pos());
+
+	ASSERT_TRUE(mesh.journal.undo());
+	for(auto v : mesh.verts) EXPECT_EQ(original[v.key], v.pos());
+
+	ASSERT_TRUE(mesh.journal.redo());
+	EXPECT_NE(original[0], mesh.verts[0].pos());
+}
+
+
+
+TEST(Smoothing, bunny_ply_threads) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	fast_compute_edge_links(mesh);
+
+	auto other = mesh;
+
+	Scoped_Num_Threads threads(1);
+	auto op = compute_smoothing_operator(mesh, Smoothing_Weights::COTANGENT);
+	EXPECT_GT(op.num_pinned, 0);
+	taubin_smooth(mesh, 5);
+
+	threads.set(4);
+	taubin_smooth(other, 5);
+
+	for(auto v : mesh.verts) EXPECT_EQ(v.pos(), other.verts[v.key].pos());
+}
@@ -0,0 +1,96 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+#include <smesh/solid.hpp>
+#include <smesh/subdivision.hpp>
+#include <smesh/parallel.hpp>
+
+#include <smesh/io.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+
+
+
+TEST(Subdivide, cube_loop) {
+	auto mesh = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+	ASSERT_TRUE( is_solid(mesh) );
+
+	subdivide(mesh, 1);
+
+	// 8 verts + 18 edges
+	EXPECT_EQ(26, mesh.verts.domain_end());
+	EXPECT_EQ(48, mesh.polys.domain_end());
+	EXPECT_TRUE( has_valid_edge_links(mesh) );
+	EXPECT_TRUE( has_all_edge_links(mesh) );
+	EXPECT_TRUE( has_valid_vert_poly_links(mesh) );
+	EXPECT_TRUE( is_solid(mesh) );
+
+	subdivide(mesh, 2);
+	EXPECT_EQ(48 * 16, mesh.polys.domain_end());
+	EXPECT_TRUE( is_solid(mesh) );
+
+	// Loop stays in the convex hull, and corners move inside
+	for(auto v : mesh.verts) {
+		EXPECT_LE(v.pos().cwiseAbs().maxCoeff(), 1 + 1e-12);
+	}
+	EXPECT_LT(mesh.verts[0].pos().cwiseAbs().maxCoeff(), 0.9);
+}
+
+
+
+TEST(Subdivide, cube_midpoint) {
+	auto mesh = get_cube_mesh<Mesh>();
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	auto original = mesh;
+
+	subdivide(mesh, 2, Subdivision_Scheme::MIDPOINT);
+	EXPECT_EQ(12 * 16, mesh.polys.domain_end());
+	EXPECT_TRUE( is_solid(mesh) );
+
+	// old verts first, not moved
+	for(auto v : original.verts) EXPECT_EQ(v.pos(), mesh.verts[v.key].pos());
+
+	// all verts stay on the cube surface
+	for(auto v : mesh.verts) {
+		EXPECT_DOUBLE_EQ(1, v.pos().cwiseAbs().maxCoeff());
+	}
+}
+
+
+
+TEST(Subdivide, bunny_ply_open_edges) {
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+	const int num_open_edges = fast_compute_edge_links(mesh).num_open_edges;
+	compute_vert_poly_links(mesh);
+	ASSERT_TRUE( is_solid(mesh, Check_Solid_Flags::ALLOW_HOLES) );
+
+	auto other = mesh;
+
+	Scoped_Num_Threads threads(1);
+	subdivide(mesh, 1);
+
+	threads.set(4);
+	subdivide(other, 1);
+
+	EXPECT_TRUE( is_solid(mesh, Check_Solid_Flags::ALLOW_HOLES) );
+	EXPECT_EQ(num_open_edges * 2, validate_mesh(mesh).num_open_edges);
+
+	// same result for any number of threads
+	ASSERT_EQ(mesh.verts.domain_end(), other.verts.domain_end());
+	for(auto v : mesh.verts) EXPECT_EQ(v.pos(), other.verts[v.key].pos());
+}
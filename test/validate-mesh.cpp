@@ -0,0 +1,183 @@
+#include <smesh/smesh.hpp>
+
+#include <smesh/edge-links.hpp>
+#include <smesh/vert-poly-links.hpp>
+
+#include <smesh/solid.hpp>
+
+#include <smesh/cap-holes.hpp>
+
+#include <smesh/io.hpp>
+
+#include <smesh/parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+
+using namespace smesh;
+
+
+
+
+using Mesh = Smesh<double>;
+
+using Issue_Type = Validate_Mesh_Result::Issue_Type;
+
+
+
+
+
+namespace {
+	Mesh get_solid_cube() {
+		auto mesh = get_cube_mesh<Mesh>();
+		fast_compute_edge_links(mesh);
+		compute_vert_poly_links(mesh);
+		return mesh;
+	}
+}
+
+
+
+
+
+TEST(Validate_mesh, bunny_holes_ply) {
+
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	auto r = validate_mesh(mesh);
+	EXPECT_FALSE(r.is_solid);
+	EXPECT_GT(r.num_open_edges, 0);
+	EXPECT_EQ(0, r.num_invalid_edge_links);
+	EXPECT_EQ(0, r.num_missing_vert_poly_links);
+	EXPECT_EQ(100, (int)r.issues.size());
+
+	EXPECT_TRUE( validate_mesh(mesh, ALLOW_HOLES).is_solid );
+
+	EXPECT_EQ(Check_Solid_Result::Failure::INVALID_EDGE_LINKS, check_solid(mesh).failure);
+
+	cap_holes(mesh);
+
+	r = validate_mesh(mesh);
+	EXPECT_TRUE(r.is_solid);
+	EXPECT_TRUE(r.issues.empty());
+	EXPECT_TRUE( is_solid(mesh) );
+}
+
+
+
+
+TEST(Validate_mesh, open_edge) {
+
+	auto mesh = get_solid_cube();
+	EXPECT_TRUE( validate_mesh(mesh).is_solid );
+
+	mesh.polys[3].edges[1].unlink();
+
+	auto r = validate_mesh(mesh);
+	EXPECT_FALSE(r.is_solid);
+	EXPECT_EQ(2, r.num_open_edges);
+	ASSERT_EQ(2, (int)r.issues.size());
+	EXPECT_EQ(Issue_Type::OPEN_EDGE, r.issues[0].type);
+
+	bool found = false;
+	for(auto& issue : r.issues) {
+		if(issue.handle == g_H_Poly_Vert{3, 1}) found = true;
+	}
+	EXPECT_TRUE(found);
+
+	EXPECT_TRUE( validate_mesh(mesh, ALLOW_HOLES).is_solid );
+}
+
+
+
+
+TEST(Validate_mesh, invalid_edge_link) {
+
+	auto mesh = get_solid_cube();
+
+	// one-way link
+	mesh.polys.raw(5).verts[0].edge_link = {7, 2};
+
+	auto r = validate_mesh(mesh);
+	EXPECT_FALSE(r.is_solid);
+	EXPECT_GE(r.num_invalid_edge_links, 1);
+	EXPECT_EQ(Check_Solid_Result::Failure::INVALID_EDGE_LINKS, check_solid(mesh).failure);
+}
+
+
+
+
+TEST(Validate_mesh, degenerate_poly) {
+
+	auto mesh = get_solid_cube();
+
+	auto p = mesh.polys.add(0, 0, 1);
+	for(auto pv : p.verts) pv.vert.poly_links.add(pv);
+
+	auto r = validate_mesh(mesh, ALLOW_HOLES);
+	EXPECT_FALSE(r.is_solid);
+	EXPECT_EQ(1, r.num_degenerate_polys);
+	ASSERT_EQ(1, (int)r.issues.size());
+	EXPECT_EQ(Issue_Type::DEGENERATE_POLY, r.issues[0].type);
+	EXPECT_EQ(p.key, r.issues[0].handle.poly);
+
+	EXPECT_EQ(Check_Solid_Result::Failure::DEGENERATE_POLYS, check_solid(mesh).failure);
+}
+
+
+
+
+TEST(Validate_mesh, vert_poly_links) {
+
+	auto mesh = get_solid_cube();
+
+	// missing
+	g_H_Poly_Vert h{4, 2};
+	mesh.verts.raw( mesh.polys.raw(4).verts[2].key ).poly_links.erase(h);
+
+	// pointing to other vertex
+	mesh.verts.raw(0).poly_links.insert({4, 2});
+
+	auto r = validate_mesh(mesh);
+	EXPECT_FALSE(r.is_solid);
+	EXPECT_EQ(1, r.num_missing_vert_poly_links);
+	EXPECT_EQ(1, r.num_invalid_vert_poly_links);
+	ASSERT_EQ(2, (int)r.issues.size());
+
+	for(auto& issue : r.issues) {
+		EXPECT_EQ(h, issue.handle);
+		if(issue.type == Issue_Type::INVALID_VERT_POLY_LINK) {
+			EXPECT_EQ(0, issue.vert);
+		}
+	}
+
+	EXPECT_EQ(Check_Solid_Result::Failure::INVALID_VERT_POLY_LINKS, check_solid(mesh).failure);
+}
+
+
+
+
+TEST(Validate_mesh, threads) {
+
+	auto mesh = load_ply<Mesh>("bunny-holes.ply");
+
+	fast_compute_edge_links(mesh);
+	compute_vert_poly_links(mesh);
+
+	Scoped_Num_Threads threads(1);
+	auto r1 = validate_mesh(mesh, Check_Solid_Flags::NONE, 1000000);
+
+	threads.set(4);
+	auto r4 = validate_mesh(mesh, Check_Solid_Flags::NONE, 1000000);
+
+	EXPECT_EQ(r1.num_open_edges, r4.num_open_edges);
+	EXPECT_EQ(r1.num_open_edges, (int)r1.issues.size());
+	ASSERT_EQ(r1.issues.size(), r4.issues.size());
+	for(int i=0; i<(int)r1.issues.size(); ++i) {
+		EXPECT_EQ(r1.issues[i].handle, r4.issues[i].handle);
+	}
+}